@@ -0,0 +1,104 @@
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+/* The parts of the Teensy core the cube code uses, for building it on a PC with the
+ * native environment of platformio.ini. Pins and timers do nothing, time comes from the
+ * clock of the PC and Serial writes to stdout unless it is opened on a terminal, see
+ * usb_serial_class. kinetis.h says how the interrupts of the display are run. */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <math.h>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define PI 3.1415926535897932384626433832795
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define DEC 10
+#define HEX 16
+#define F_CPU 120000000
+#define F_BUS 60000000
+#define A10 34
+
+unsigned long micros();
+unsigned long millis();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWriteFast(uint8_t pin, uint8_t value);
+int analogRead(uint8_t pin);
+inline void analogReadResolution(unsigned int) {}
+inline void analogReadAveraging(unsigned int) {}
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+template<typename T>
+T constrain(T value, T low, T high) { return value < low ? low : (value > high ? high : value); }
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t b) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size);
+  size_t write(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+  virtual int availableForWrite() { return 0; }
+  size_t print(const char* s) { return write(s); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int n, int base = DEC) { return print((long)n, base); }
+  size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+  size_t print(long n, int base = DEC);
+  size_t print(unsigned long n, int base = DEC);
+  size_t print(double n, int digits = 2);
+  size_t println() { return write('\n'); }
+  template<typename T>
+  size_t println(T value) { size_t n = print(value); return n + println(); }
+  template<typename T>
+  size_t println(T value, int format) { size_t n = print(value, format); return n + println(); }
+  int printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  void setTimeout(unsigned long ms) { m_timeout = ms; }
+  // waits up to the timeout for every byte, like the Arduino Stream
+  size_t readBytes(char* buffer, size_t length);
+  size_t readBytes(uint8_t* buffer, size_t length) { return readBytes((char*)buffer, length); }
+protected:
+  unsigned long m_timeout = 1000;
+};
+
+/* Serial of the PC. It writes to stdout and has nothing to read, until open connects it
+ * to a terminal such as one side of a pseudo terminal, then it reads and writes that. */
+class usb_serial_class : public Stream {
+public:
+  void begin(long) {}
+  // read and write the file descriptor of a terminal, -1 goes back to stdout
+  void open(int fd);
+  int available();
+  int read();
+  int peek();
+  size_t write(uint8_t b) { return write(&b, 1); }
+  size_t write(const uint8_t* buffer, size_t size);
+  using Print::write;
+  int availableForWrite();
+  void send_now() {}
+  void flush() {}
+  operator bool() { return true; }
+private:
+  int m_fd = -1;
+  int m_peeked = -1;
+};
+extern usb_serial_class Serial;
+
+#include "kinetis.h"
+#include "core_pins.h"
+#endif
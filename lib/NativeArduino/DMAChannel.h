@@ -0,0 +1,24 @@
+#ifndef NATIVE_DMACHANNEL_H
+#define NATIVE_DMACHANNEL_H
+#include <stdint.h>
+// A DMA channel that never moves anything, the PC has no DMA
+class DMAChannel {
+public:
+  struct TCD_t { volatile const void* SADDR; volatile void* DADDR; };
+  TCD_t tcd = { nullptr, nullptr };
+  TCD_t* TCD = &tcd;
+  void source(volatile const uint16_t& p) { tcd.SADDR = &p; }
+  void sourceBuffer(volatile const uint8_t* p, unsigned int) { tcd.SADDR = p; }
+  void sourceBuffer(volatile const uint16_t* p, unsigned int) { tcd.SADDR = p; }
+  void destination(volatile uint8_t& p) { tcd.DADDR = &p; }
+  void destinationBuffer(volatile uint16_t* p, unsigned int) { tcd.DADDR = p; }
+  void triggerAtHardwareEvent(uint8_t) {}
+  void disableOnCompletion() {}
+  void interruptAtCompletion() {}
+  void interruptAtHalf() {}
+  void attachInterrupt(void (*)(void)) {}
+  void clearInterrupt() {}
+  void enable() {}
+  void disable() {}
+};
+#endif
@@ -0,0 +1,13 @@
+#ifndef NATIVE_EEPROM_H
+#define NATIVE_EEPROM_H
+#include <stdint.h>
+// the 4096 bytes of EEPROM of the Teensy 3.5, kept in memory and erased as 0xFF
+class EEPROMClass {
+public:
+  uint8_t read(int index);
+  void write(int index, uint8_t value);
+  void update(int index, uint8_t value) { write(index, value); }
+  int length() { return 4096; }
+};
+extern EEPROMClass EEPROM;
+#endif
@@ -0,0 +1,295 @@
+#include <chrono>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include "Arduino.h"
+#include "DMAChannel.h"
+#include "EEPROM.h"
+#include "SD.h"
+#include "SPI.h"
+/*----------------------------------------------------------------------------------------------
+ * REGISTERS AND PINS
+ *--------------------------------------------------------------------------------------------*/
+#define NATIVE_REGISTER(name) volatile uint32_t name;
+NATIVE_REGISTER(FTM1_SC) NATIVE_REGISTER(FTM1_CNTIN) NATIVE_REGISTER(FTM1_CNT)
+NATIVE_REGISTER(FTM1_MOD) NATIVE_REGISTER(FTM1_C0SC) NATIVE_REGISTER(FTM1_C1SC)
+NATIVE_REGISTER(FTM1_C0V) NATIVE_REGISTER(FTM1_C1V)
+NATIVE_REGISTER(SIM_SCGC3) NATIVE_REGISTER(SIM_SCGC4) NATIVE_REGISTER(SIM_SCGC6)
+NATIVE_REGISTER(CMT_MSC) NATIVE_REGISTER(CMT_PPS) NATIVE_REGISTER(CMT_CGH1)
+NATIVE_REGISTER(CMT_CGL1) NATIVE_REGISTER(CMT_CMD1) NATIVE_REGISTER(CMT_CMD2)
+NATIVE_REGISTER(CMT_CMD3) NATIVE_REGISTER(CMT_CMD4) NATIVE_REGISTER(CMT_OC)
+NATIVE_REGISTER(SPI0_SR) NATIVE_REGISTER(SPI0_RSER) NATIVE_REGISTER(SPI0_PUSHR)
+NATIVE_REGISTER(SPI1_SR) NATIVE_REGISTER(SPI1_RSER) NATIVE_REGISTER(SPI1_PUSHR)
+NATIVE_REGISTER(SPI2_SR) NATIVE_REGISTER(SPI2_RSER) NATIVE_REGISTER(SPI2_PUSHR)
+NATIVE_REGISTER(ARM_DEMCR) NATIVE_REGISTER(ARM_DWT_CTRL)
+NATIVE_REGISTER(ADC0_SC1A) NATIVE_REGISTER(ADC0_SC2) NATIVE_REGISTER(ADC0_SC3)
+NATIVE_REGISTER(ADC0_CFG1) NATIVE_REGISTER(ADC0_CFG2) NATIVE_REGISTER(ADC0_RA)
+NATIVE_REGISTER(PDB0_SC) NATIVE_REGISTER(PDB0_MOD) NATIVE_REGISTER(PDB0_IDLY)
+NATIVE_REGISTER(PDB0_CH0C1)
+NATIVE_REGISTER(CORE_PIN3_CONFIG) NATIVE_REGISTER(CORE_PIN4_CONFIG)
+NATIVE_REGISTER(CORE_PIN5_CONFIG)
+
+SPIClass SPI, SPI1, SPI2;
+
+void pinMode(uint8_t, uint8_t) {}
+void digitalWriteFast(uint8_t, uint8_t) {}
+// the middle of the ADC range, silence for the audio input
+int analogRead(uint8_t) { return 512; }
+/*----------------------------------------------------------------------------------------------
+ * TIME
+ *--------------------------------------------------------------------------------------------*/
+namespace {
+typedef std::chrono::steady_clock NativeClock;
+const NativeClock::time_point boot = NativeClock::now();
+uint64_t nanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(NativeClock::now() - boot).count();
+}
+}
+
+unsigned long micros() { return (uint32_t)(nanos()/1000); }
+unsigned long millis() { return (uint32_t)(nanos()/1000000); }
+uint32_t nativeCycles() { return (uint32_t)(nanos()*(F_CPU/1000000)/1000); }
+void delay(uint32_t ms) { usleep(ms*1000); }
+void delayMicroseconds(uint32_t) {}
+
+long random(long max) { return max <= 0 ? 0 : ::random() % max; }
+long random(long min, long max) { return max <= min ? min : min + ::random() % (max - min); }
+void randomSeed(unsigned long seed) { srandom(seed); }
+/*----------------------------------------------------------------------------------------------
+ * INTERRUPTS
+ *--------------------------------------------------------------------------------------------*/
+namespace {
+bool softwarePending = false;
+}
+
+void nativePend(int irq) {
+  if(irq == IRQ_SOFTWARE)
+    softwarePending = true;
+}
+
+void nativeDisplay() {
+  ftm1_isr();
+  if(softwarePending) {
+    softwarePending = false;
+    software_isr();
+  }
+}
+/*----------------------------------------------------------------------------------------------
+ * PRINT AND SERIAL
+ *--------------------------------------------------------------------------------------------*/
+size_t Print::write(const uint8_t* buffer, size_t size) {
+  size_t n = 0;
+  while(n < size && write(buffer[n]))
+    n++;
+  return n;
+}
+
+size_t Print::print(long n, int base) {
+  if(base == DEC)
+    return printf("%ld", n);
+  return print((unsigned long)n, base);
+}
+
+size_t Print::print(unsigned long n, int base) {
+  return printf(base == HEX ? "%lX" : "%lu", n);
+}
+
+size_t Print::print(double n, int digits) {
+  return printf("%.*f", digits, n);
+}
+
+int Print::printf(const char* format, ...) {
+  char buffer[512];
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  if(n < 0)
+    return n;
+  return write((const uint8_t*)buffer, (size_t)n < sizeof(buffer) ? n : sizeof(buffer) - 1);
+}
+
+size_t Stream::readBytes(char* buffer, size_t length) {
+  size_t n = 0;
+  const unsigned long start = millis();
+  while(n < length && millis() - start < m_timeout) {
+    int c = read();
+    if(c >= 0)
+      buffer[n++] = c;
+  }
+  return n;
+}
+
+usb_serial_class Serial;
+
+void usb_serial_class::open(int fd) {
+  m_fd = fd;
+  m_peeked = -1;
+}
+
+int usb_serial_class::available() {
+  int n = 0;
+  if(m_fd < 0 || ioctl(m_fd, FIONREAD, &n) < 0)
+    n = 0;
+  return n + (m_peeked >= 0);
+}
+
+int usb_serial_class::read() {
+  if(m_peeked >= 0) {
+    int c = m_peeked;
+    m_peeked = -1;
+    return c;
+  }
+  uint8_t c;
+  if(available() <= 0 || ::read(m_fd, &c, 1) != 1)
+    return -1;
+  return c;
+}
+
+int usb_serial_class::peek() {
+  if(m_peeked < 0)
+    m_peeked = read();
+  return m_peeked;
+}
+
+size_t usb_serial_class::write(const uint8_t* buffer, size_t size) {
+  const int fd = m_fd < 0 ? STDOUT_FILENO : m_fd;
+  if(m_fd < 0)
+    fflush(stdout);
+  size_t n = 0;
+  while(n < size) {
+    ssize_t written = ::write(fd, buffer + n, size - n);
+    if(written > 0) {
+      n += written;
+    } else {
+      // a terminal that is full, wait until it takes more
+      pollfd p = { fd, POLLOUT, 0 };
+      if(poll(&p, 1, 1000) <= 0)
+        break;
+    }
+  }
+  return n;
+}
+
+// a packet of the USB serial of the Teensy, the PC side takes it without waiting
+int usb_serial_class::availableForWrite() {
+  if(m_fd < 0)
+    return 64;
+  pollfd p = { m_fd, POLLOUT, 0 };
+  return poll(&p, 1, 0) > 0 ? 64 : 0;
+}
+/*----------------------------------------------------------------------------------------------
+ * SD CARD
+ *--------------------------------------------------------------------------------------------*/
+SDClass SD;
+
+const char* SDClass::path(const char* name) {
+  while(*name == '/')
+    name++;
+  snprintf(m_path, sizeof(m_path), "%s/%s", m_root, name);
+  return m_path;
+}
+
+void SDClass::setRoot(const char* directory) {
+  snprintf(m_root, sizeof(m_root), "%s", directory);
+}
+
+File SDClass::open(const char* name, uint8_t mode) {
+  FILE* file;
+  if(mode == FILE_READ) {
+    file = fopen(path(name), "rb");
+  } else {
+    file = fopen(path(name), "r+b");
+    if(!file)
+      file = fopen(path(name), "w+b");
+    if(file)
+      fseek(file, 0, SEEK_END);
+  }
+  return file ? File(file) : File();
+}
+
+bool SDClass::exists(const char* name) {
+  return access(path(name), F_OK) == 0;
+}
+
+bool SDClass::remove(const char* name) {
+  return ::remove(path(name)) == 0;
+}
+
+int File::available() {
+  return m_file ? size() - position() : 0;
+}
+
+int File::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int File::peek() {
+  int c = read();
+  if(c >= 0)
+    fseek(m_file.get(), -1, SEEK_CUR);
+  return c;
+}
+
+int File::read(void* buffer, size_t length) {
+  if(!m_file)
+    return -1;
+  // a read after a write needs a seek in between, the Teensy doesn't
+  fseek(m_file.get(), 0, SEEK_CUR);
+  return fread(buffer, 1, length, m_file.get());
+}
+
+size_t File::write(const uint8_t* buffer, size_t size) {
+  if(!m_file)
+    return 0;
+  fseek(m_file.get(), 0, SEEK_CUR);
+  return fwrite(buffer, 1, size, m_file.get());
+}
+
+bool File::seek(uint32_t position) {
+  return m_file && position <= size() && fseek(m_file.get(), position, SEEK_SET) == 0;
+}
+
+uint32_t File::position() {
+  return m_file ? ftell(m_file.get()) : 0;
+}
+
+uint32_t File::size() {
+  if(!m_file)
+    return 0;
+  const long position = ftell(m_file.get());
+  fseek(m_file.get(), 0, SEEK_END);
+  const long end = ftell(m_file.get());
+  fseek(m_file.get(), position, SEEK_SET);
+  return end;
+}
+
+void File::flush() {
+  if(m_file)
+    fflush(m_file.get());
+}
+/*----------------------------------------------------------------------------------------------
+ * EEPROM
+ *--------------------------------------------------------------------------------------------*/
+EEPROMClass EEPROM;
+
+namespace {
+uint8_t eeprom[4096];
+bool erased = false;
+}
+
+uint8_t EEPROMClass::read(int index) {
+  if(!erased) {
+    memset(eeprom, 0xFF, sizeof(eeprom));
+    erased = true;
+  }
+  return index >= 0 && index < length() ? eeprom[index] : 0xFF;
+}
+
+void EEPROMClass::write(int index, uint8_t value) {
+  read(0);
+  if(index >= 0 && index < length())
+    eeprom[index] = value;
+}
@@ -0,0 +1,47 @@
+#ifndef NATIVE_SD_H
+#define NATIVE_SD_H
+#include <memory>
+#include "Arduino.h"
+/* The SD card of the PC is a directory, the current one unless setRoot picks another.
+ * Files are opened like on the Teensy: FILE_WRITE reads and writes, starting at the end
+ * of the file, and copies of a File share the open file. */
+#define BUILTIN_SDCARD 254
+#define FILE_READ 0
+#define FILE_WRITE 1
+
+class File : public Stream {
+public:
+  File() {}
+  File(FILE* file) : m_file(file, fclose) {}
+  int available();
+  int read();
+  int peek();
+  int read(void* buffer, size_t length);
+  size_t write(uint8_t b) { return write(&b, 1); }
+  size_t write(const uint8_t* buffer, size_t size);
+  using Print::write;
+  bool seek(uint32_t position);
+  uint32_t position();
+  uint32_t size();
+  void flush();
+  void close() { m_file.reset(); }
+  operator bool() const { return (bool)m_file; }
+private:
+  std::shared_ptr<FILE> m_file;
+};
+
+class SDClass {
+public:
+  bool begin(uint8_t) { return true; }
+  File open(const char* name, uint8_t mode = FILE_READ);
+  bool exists(const char* name);
+  bool remove(const char* name);
+  // directory that stands in for the card, native builds only
+  void setRoot(const char* directory);
+private:
+  const char* path(const char* name);
+  char m_root[256] = ".";
+  char m_path[512];
+};
+extern SDClass SD;
+#endif
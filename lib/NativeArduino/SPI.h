@@ -0,0 +1,20 @@
+#ifndef NATIVE_SPI_H
+#define NATIVE_SPI_H
+#include <stdint.h>
+#define MSBFIRST 1
+#define SPI_MODE0 0x00
+class SPISettings {
+public:
+  SPISettings() {}
+  SPISettings(uint32_t, uint8_t, uint8_t) {}
+};
+class SPIClass {
+public:
+  void begin() {}
+  void beginTransaction(SPISettings) {}
+  void endTransaction() {}
+};
+extern SPIClass SPI;
+extern SPIClass SPI1;
+extern SPIClass SPI2;
+#endif
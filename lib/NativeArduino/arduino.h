@@ -0,0 +1,2 @@
+// Color.h includes the core in lower case, that only works on a case insensitive disk
+#include "Arduino.h"
@@ -0,0 +1,11 @@
+#ifndef NATIVE_CORE_PINS_H
+#define NATIVE_CORE_PINS_H
+#include <stdint.h>
+// pin control registers of the display timers, see OctadecaTLC5940.h
+extern volatile uint32_t CORE_PIN3_CONFIG;
+extern volatile uint32_t CORE_PIN4_CONFIG;
+extern volatile uint32_t CORE_PIN5_CONFIG;
+#define PORT_PCR_MUX(n) (((n) & 7) << 8)
+#define PORT_PCR_DSE 0x40
+#define PORT_PCR_SRE 0x04
+#endif
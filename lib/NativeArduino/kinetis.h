@@ -0,0 +1,80 @@
+#ifndef NATIVE_KINETIS_H
+#define NATIVE_KINETIS_H
+#include <stdint.h>
+/* Registers of the K64 the cube code writes. They are plain variables on the PC, except
+ * for the cycle counter, it counts at F_CPU from the clock of the PC. Cycle counts of a
+ * native build are the time the PC took, not what the Teensy would take. */
+#define NATIVE_REGISTER(name) extern volatile uint32_t name;
+NATIVE_REGISTER(FTM1_SC) NATIVE_REGISTER(FTM1_CNTIN) NATIVE_REGISTER(FTM1_CNT)
+NATIVE_REGISTER(FTM1_MOD) NATIVE_REGISTER(FTM1_C0SC) NATIVE_REGISTER(FTM1_C1SC)
+NATIVE_REGISTER(FTM1_C0V) NATIVE_REGISTER(FTM1_C1V)
+NATIVE_REGISTER(SIM_SCGC3) NATIVE_REGISTER(SIM_SCGC4) NATIVE_REGISTER(SIM_SCGC6)
+NATIVE_REGISTER(CMT_MSC) NATIVE_REGISTER(CMT_PPS) NATIVE_REGISTER(CMT_CGH1)
+NATIVE_REGISTER(CMT_CGL1) NATIVE_REGISTER(CMT_CMD1) NATIVE_REGISTER(CMT_CMD2)
+NATIVE_REGISTER(CMT_CMD3) NATIVE_REGISTER(CMT_CMD4) NATIVE_REGISTER(CMT_OC)
+NATIVE_REGISTER(SPI0_SR) NATIVE_REGISTER(SPI0_RSER) NATIVE_REGISTER(SPI0_PUSHR)
+NATIVE_REGISTER(SPI1_SR) NATIVE_REGISTER(SPI1_RSER) NATIVE_REGISTER(SPI1_PUSHR)
+NATIVE_REGISTER(SPI2_SR) NATIVE_REGISTER(SPI2_RSER) NATIVE_REGISTER(SPI2_PUSHR)
+NATIVE_REGISTER(ARM_DEMCR) NATIVE_REGISTER(ARM_DWT_CTRL)
+NATIVE_REGISTER(ADC0_SC1A) NATIVE_REGISTER(ADC0_SC2) NATIVE_REGISTER(ADC0_SC3)
+NATIVE_REGISTER(ADC0_CFG1) NATIVE_REGISTER(ADC0_CFG2) NATIVE_REGISTER(ADC0_RA)
+NATIVE_REGISTER(PDB0_SC) NATIVE_REGISTER(PDB0_MOD) NATIVE_REGISTER(PDB0_IDLY)
+NATIVE_REGISTER(PDB0_CH0C1)
+#undef NATIVE_REGISTER
+uint32_t nativeCycles();
+#define ARM_DWT_CYCCNT (nativeCycles())
+
+#define SIM_SCGC4_CMT 0x00000004
+#define SIM_SCGC6_PDB 0x00400000
+#define SIM_SCGC6_ADC0 0x08000000
+#define FTM_SC_TOF 0x80
+#define FTM_SC_TOIE 0x40
+#define FTM_SC_CPWMS 0x20
+#define FTM_SC_CLKS(n) (((n) & 3) << 3)
+#define FTM_SC_PS(n) ((n) & 7)
+#define FTM_CSC_MSB 0x20
+#define FTM_CSC_ELSA 0x04
+#define SPI_RSER_TFFF_RE 0x02000000
+#define SPI_RSER_TFFF_DIRS 0x01000000
+#define ARM_DEMCR_TRCENA (1 << 24)
+#define ARM_DWT_CTRL_CYCCNTENA (1 << 0)
+#define ADC_SC1_ADCH(n) ((n) & 0x1F)
+#define ADC_SC2_ADTRG 0x40
+#define ADC_SC2_DMAEN 0x04
+#define ADC_SC3_AVGE 0x04
+#define ADC_SC3_AVGS(n) ((n) & 3)
+#define ADC_CFG1_ADIV(n) (((n) & 3) << 5)
+#define ADC_CFG1_ADLSMP 0x10
+#define ADC_CFG1_MODE(n) (((n) & 3) << 2)
+#define ADC_CFG1_ADICLK(n) ((n) & 3)
+#define PDB_SC_LDOK 0x01
+#define PDB_SC_CONT 0x02
+#define PDB_SC_MULT(n) (((n) & 3) << 2)
+#define PDB_SC_PDBEN 0x80
+#define PDB_SC_TRGSEL(n) (((n) & 15) << 8)
+#define PDB_SC_PRESCALER(n) (((n) & 7) << 12)
+#define PDB_SC_SWTRIG 0x10000
+#define PDB_CH0C1_EN 0x01
+#define PDB_CH0C1_TOS 0x0100
+#define DMAMUX_SOURCE_SPI0_TX 15
+#define DMAMUX_SOURCE_SPI1 16
+#define DMAMUX_SOURCE_SPI2 17
+#define DMAMUX_SOURCE_ADC0 40
+
+/* Interrupts never come by themselves on the PC. NVIC_SET_PENDING marks one and
+ * nativeDisplay runs what the display interrupts do for one layer: the FTM1 interrupt
+ * latches it and the software interrupt it pends prepares the next. Set nativeDisplay as
+ * idle function of the cube and update returns once the display took the frame. */
+#define IRQ_FTM1 63
+#define IRQ_SOFTWARE 94
+void ftm1_isr(void);
+void software_isr(void);
+void nativePend(int irq);
+void nativeDisplay();
+#define NVIC_SET_PENDING(n) nativePend(n)
+#define NVIC_ENABLE_IRQ(n)
+#define NVIC_DISABLE_IRQ(n)
+#define NVIC_SET_PRIORITY(n, priority)
+#define __disable_irq()
+#define __enable_irq()
+#endif
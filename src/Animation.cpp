@@ -1,56 +1,94 @@
 #include "Animation.h"
 #include "Cube.h"
 #include "Color.h"
-#include "Font.h"
 #include "Util.h"
 
 extern Cube cube;
 extern ColorWheel colorwheel;
 extern NoiseGenerator generator;
+#ifdef AUDIO_INPUT
+extern Spectrum spectrum;
+#endif
 /*---------------------------------------------------------------------------------------
  * ANIMATION INTERFACE
  *-------------------------------------------------------------------------------------*/
 Animation::~Animation() { }
-void Animation::animate(int width_, int height_, int depth_) {
-  width = width_;
-  height = height_;
-  depth = depth_;
-
-  m_currentTime = micros();
-  if(m_startTime==0) {
-	m_startTime = m_currentTime;
-	m_lastTime = m_currentTime;
+constexpr int Animation::width;
+constexpr int Animation::height;
+constexpr int Animation::depth;
+
+void Animation::animate() {
+  const uint32_t now = Clock::now();
+  if(!m_running) {
+	m_running = true;
+	m_lastTime = now;
 	init();
   }
-  m_deltaTime = m_currentTime-m_lastTime;
-  m_runTime = m_currentTime-m_startTime;
-  draw(m_deltaTime/1000000.0f);
-  m_lastTime = m_currentTime;
+  // the difference is right when the clock wraps between two frames
+  const uint32_t dt = now-m_lastTime;
+  m_lastTime = now;
+  draw(dt/1000000.0f);
 }
 void Animation::restart() {
-  m_startTime=0;
+  m_running = false;
 }
 bool Animation::running() {
-  return m_startTime!=0;
+  return m_running;
 }
 /*---------------------------------------------------------------------------------------
- * SINUS
+ * VOXEL SHADER
  *-------------------------------------------------------------------------------------*/
-void Sinus::init() { }
-void Sinus::draw(float dt) {
-  phase += PI*dt;
-  colorwheel.turn(-dt/10.0f);
+template<typename Shader>
+void VoxelShader<Shader>::draw(float dt) {
+  Shader& shader = static_cast<Shader&>(*this);
+  shader.begin(dt);
+
+  typename Shader::Layer layers[height];
+  for(int y=0;y<height;y++)
+    layers[y] = shader.layer(y);
+  typename Shader::Column columns[width][depth];
+  for(int x=0;x<width;x++)
+  for(int z=0;z<depth;z++)
+    columns[x][z] = shader.column(x, z);
 
-  for(int x=0;x < width;x++) {
-    X = cube.map(x, 0, width-1, -2, 2);
-    for(int z=0;z < depth;z++) {
-      Z = cube.map(z, 0, depth-1,-2,2);
-      Y = sinf(phase + sqrtf(X*X + Z*Z));
-      Y = round(cube.map(Y, -1, 1, 0, height-1));
-      cube.setVoxel(x,(int)Y,z, colorwheel.color(Y*0.01f));
+  Frame& canvas = cube.getRenderingCube();
+  for(int x=0;x<width;x++)
+  for(int y=0;y<height;y++) {
+    const Linear linear = shader.row(x, y, layers[y]);
+    Voxel* row = canvas[x][y];
+    float value = linear.start;
+    for(int z=0;z<depth;z++) {
+      shader.shade(row[z], value, y, layers[y], columns[x][z]);
+      value += linear.step;
     }
   }
 
+  shader.end();
+}
+// the hooks are defined in this file, so the loops are only compiled here
+template class VoxelShader<Sinus>;
+template class VoxelShader<Rainbow>;
+template class VoxelShader<Spin>;
+/*---------------------------------------------------------------------------------------
+ * SINUS
+ *-------------------------------------------------------------------------------------*/
+void Sinus::init() { }
+void Sinus::begin(float dt) {
+  phase += PI*dt;
+  colorwheel.turn(-dt/10.0f);
+}
+// the height of the wave in a column
+Sinus::Column Sinus::column(int x, int z) {
+  X = cube.map(x, 0, width-1, -2, 2);
+  Z = cube.map(z, 0, depth-1,-2,2);
+  Y = sinf(phase + sqrtf(X*X + Z*Z));
+  Y = round(cube.map(Y, -1, 1, 0, height-1));
+  return Column{(int)Y, colorwheel.color(Y*0.01f)};
+}
+void Sinus::shade(Voxel& voxel, float, int y, const Layer&, const Column& column) {
+  if(y == column.height) voxel = column.color;
+}
+void Sinus::end() {
   if(phase/(4*PI) >= 1) {
 	phase-=4*PI;
 	restart();
@@ -102,14 +140,14 @@ void Twinkel::init() {
   timer1 = generator.nextRandom(0.01f, 0.05f);
   timer2 = generator.nextRandom(1.00f, 4.00f);
   seconds= generator.nextRandom(0.50f, 4.00f);
-  if(loops==0) loops = random(4,10);
+  if(loops==0) loops = generator.nextInt(4,10);
 }
 void Twinkel::draw(float dt) {
   cube.fade(seconds, dt);
   if(timer1.ticks()) {
     Color color;
     color.random();
-	cube.setVoxel(random(width),random(height),random(depth), color);
+	cube.setVoxel(generator.nextInt(width),generator.nextInt(height),generator.nextInt(depth), color);
   }
   if(timer2.ticks()) {
 	if(--loops==0) restart();
@@ -122,19 +160,19 @@ void Twinkel::draw(float dt) {
 void Rain::init() {
   timer1 = generator.nextRandom(0.025f, 0.050f);
   timer2 = generator.nextRandom(1.000f, 4.000f);
-  if(loops==0) loops = random(3,8);
+  if(loops==0) loops = generator.nextInt(3,8);
 }
 void Rain::draw(float dt) {
   (void)dt;
   if(timer1.ticks()) {
 	cube.down();
-    for(int d=random(0,3);d>0;d--) {
+    for(int d=generator.nextInt(0,3);d>0;d--) {
 	  Color color;
-      int x=random(width);
-      int z=random(height);
-      color.R=random(0x600);
-      color.G=random(0x600);
-      color.B=random(0xB00, 0x1000);
+      int x=generator.nextInt(width);
+      int z=generator.nextInt(height);
+      color.R=generator.nextInt(0x600);
+      color.G=generator.nextInt(0x600);
+      color.B=generator.nextInt(0xB00, 0x1000);
       cube.setVoxel(x,height-1,z,color);
     }
   }
@@ -150,15 +188,17 @@ void Rain::draw(float dt) {
  * RAINBOW
  *-------------------------------------------------------------------------------------*/
 void Rainbow::init() {}
-void Rainbow::draw(float dt) {
+void Rainbow::begin(float dt) {
   phase += PI/5*dt;
   colorwheel.turn(sinf(phase)/3*dt);
-
-  for(int x=0;x<width;x++)
-  for(int y=0;y<height;y++)
-  for(int z=0;z<depth;z++)
-    cube.setVoxel(x,y,z, colorwheel.color(0.02f*x+0.01f*y+0.005f*z));
-
+}
+Rainbow::Linear Rainbow::row(int x, int y, const Layer&) {
+  return Linear{0.02f*x+0.01f*y, 0.005f};
+}
+void Rainbow::shade(Voxel& voxel, float linear, int, const Layer&, const Column&) {
+  voxel = colorwheel.color(linear);
+}
+void Rainbow::end() {
   if(phase/(2*PI) >= 1) {
 	phase-=2*PI;
 	restart();
@@ -168,18 +208,23 @@ void Rainbow::draw(float dt) {
  * SPIN
  *-------------------------------------------------------------------------------------*/
 void Spin::init() { }
-void Spin::draw(float dt) {
+void Spin::begin(float dt) {
   phase += 1.25*PI*dt;
   colorwheel.turn(dt/2);
-
-  for(int x=0;x<width;x++)
-  for(int y=0;y<height;y++)
-  for(int z=0;z<depth;z++) {
-    X = (x-((width-1)/2))*sinf(phase+cube.map((float)y,0,height,0,distort));
-    Z = (z-((height-1)/2))*cosf(phase+cube.map((float)y,0,height,0,distort));
-    if(abs(X-Z) < .8) cube.setVoxel(x,y,z, colorwheel.color(0.02f*y));
-  }
-
+}
+// every layer turns by its own angle
+Spin::Layer Spin::layer(int y) {
+  const float angle = phase+cube.map((float)y,0,height,0,distort);
+  return Layer{sinf(angle), cosf(angle), colorwheel.color(0.02f*y)};
+}
+// X-Z along the row, X = (x-4)*sine and Z = (z-4)*cosine
+Spin::Linear Spin::row(int x, int, const Layer& layer) {
+  return Linear{(x-((width-1)/2))*layer.sine + ((height-1)/2)*layer.cosine, -layer.cosine};
+}
+void Spin::shade(Voxel& voxel, float linear, int, const Layer& layer, const Column&) {
+  if(abs(linear) < .8) voxel = layer.color;
+}
+void Spin::end() {
   distort+=0.01*PI*direction;
   if(distort > 0.75*PI || distort < 0.25*PI)
     direction*=-1;
@@ -225,9 +270,9 @@ void Sphere::draw(float dt) {
 void Starfield::init() {
   if(runOnce) {
     for(int i=0;i<numStars;i++) {
-      stars[i].x = random(0, width);;
-      stars[i].y = random(0, height);
-	  stars[i].z = random(0, depth);
+      stars[i].x = generator.nextInt(0, width);;
+      stars[i].y = generator.nextInt(0, height);
+	  stars[i].z = generator.nextInt(0, depth);
     }
     runOnce = false;
   }
@@ -244,12 +289,12 @@ void Starfield::draw(float dt) {
     if (s<1) s = 1;
     stars[i].z += sinf(phase)*dt*s*20;
     if(stars[i].z >= depth) {
-      stars[i].x = random(0, width);
-      stars[i].y = random(0, height);
+      stars[i].x = generator.nextInt(0, width);
+      stars[i].y = generator.nextInt(0, height);
       stars[i].z = 0;
     } else if(stars[i].z <= 0) {
-      stars[i].x = random(0,width);
-      stars[i].y = random(0,height);
+      stars[i].x = generator.nextInt(0,width);
+      stars[i].y = generator.nextInt(0,height);
       stars[i].z = depth-1;
     }
     cube.setVoxel(stars[i].x,stars[i].y,stars[i].z, colorwheel.color(0));
@@ -298,17 +343,38 @@ void Mixer::init() {
 void Mixer::draw(float dt) {
   (void)dt;
   if(!timer.expired()) {
-	a->animate(width, height, depth);
-    b->animate(width, height, depth);
+	a->animate();
+    b->animate();
   }
   else if(!a->running() && !b->running()) {
     restart();
   }
   else {
-	if(a->running()) a->animate(width, height, depth);
-	if(b->running()) b->animate(width, height, depth);
+	if(a->running()) a->animate();
+	if(b->running()) b->animate();
   }
 }
+/*---------------------------------------------------------------------------------------
+ * SPINNER
+ *-------------------------------------------------------------------------------------*/
+Spinner::Spinner(Animation* a_) {
+  a = a_;
+}
+void Spinner::init() {
+  angle = 0;
+  // normally divided components give an axis pointing in any direction equally likely
+  axis = Vector3(generator.nextGaussian(0,1), generator.nextGaussian(0,1),
+    generator.nextGaussian(0,1));
+}
+void Spinner::draw(float dt) {
+  angle += 90*dt;
+  a->animate();
+  // tumble the finished frame of the other animation around the axis
+  Quaternion q = Quaternion(angle, axis);
+  q.convertAxisAngle();
+  cube.transform(q);
+  if(!a->running()) restart();
+}
 /*---------------------------------------------------------------------------------------
  * ARROWS
  *-------------------------------------------------------------------------------------*/
@@ -364,8 +430,10 @@ void Arrows::draw(float dt) {
  *-------------------------------------------------------------------------------------*/
 constexpr uint8_t OutsideScroller::rotation[32];
 OutsideScroller::OutsideScroller(const char* text_) {
-  text = (char*)text_;
-  numChars	= strlen(text);
+  setText(text_);
+}
+void OutsideScroller::setText(const char* text_) {
+  strip.setText(text_);
   init();
 }
 void OutsideScroller::init() {
@@ -377,28 +445,22 @@ void OutsideScroller::draw(float dt) {
   colorwheel.turn(dt/20);
 
   for(int b=startPos;b<32;b++) {
-    unsigned int chrOffset = (b+bitPos-startPos)/8;
-    unsigned int bitOffset = (b+bitPos-startPos)%8;
-    if(chrOffset >= numChars) continue;
-    uint8_t chr = text[chrOffset];
-
-    for(int y=7;y>=0;y--) {
-      uint8_t bitset = charset[chr][7-y];
-      if(bitset & (1<<bitOffset)) {
-        int x = rotation[(b)%32];
-        int z = rotation[(24+b)%32];
-        if(chr==0x1F)
-          cube.setVoxel(x,y,z,Color::RED);
-        else
-          cube.setVoxel(x,y,z,colorwheel.color(z*0.01f));
-      }
-    }
+    int col = b+bitPos-startPos;
+    if(col >= strip.columns()) continue;
+    uint8_t bits = strip.column(col);
+    if(!bits) continue;
+
+    int x = rotation[(b)%32];
+    int z = rotation[(24+b)%32];
+    Color c = strip.character(col)==0x1F ? Color::RED : colorwheel.color(z*0.01f);
+    for(int y=0;bits;y++,bits>>=1)
+      if(bits & 1) cube.setVoxel(x,y,z,c);
   }
 
   if(timer.ticks()) {
      startPos > 0 ? startPos-- : bitPos++;
   }
-  if(bitPos/8 >= numChars) {
+  if(bitPos >= strip.columns()) {
     restart();
   }
 }
@@ -406,8 +468,10 @@ void OutsideScroller::draw(float dt) {
  * SCROLLER
  *-------------------------------------------------------------------------------------*/
 InsideScroller::InsideScroller(const char* text_) {
-  text = (char*)text_;
-  numChars = strlen(text);
+  setText(text_);
+}
+void InsideScroller::setText(const char* text_) {
+  strip.setText(text_);
   init();
 }
 void InsideScroller::init() {
@@ -417,19 +481,20 @@ void InsideScroller::init() {
 }
 void InsideScroller::draw(float dt) {
   colorwheel.turn(dt/20);
+  if(strip.characters()==0) {
+	restart();
+	return;
+  }
 
+  Color c = colorwheel.color(zPos*0.02f);
   for(int x=1;x<=8;x++) {
-    uint8_t chr = text[charPos%numChars];
-    for(int y=7;y>=0;y--) {
-      uint8_t bitset = charset[chr][7-y];
-      if(bitset & (1<<(x-1))) {
-        cube.setVoxel(x,y,zPos,colorwheel.color(zPos*0.02f));
-      }
-    }
+    uint8_t bits = strip.column((charPos%strip.characters())*8 + x-1);
+    for(int y=0;bits;y++,bits>>=1)
+      if(bits & 1) cube.setVoxel(x,y,zPos,c);
   }
   if(timer.ticks())
      zPos > 0 ? zPos-- : (zPos = 8, charPos++);
-  if(charPos >= numChars) {
+  if(charPos >= strip.characters()) {
 	restart();
   }
 }
@@ -458,7 +523,7 @@ void Tree::draw(float dt) {
   colorwheel.turn(dt);
 
   if(timer1.ticks()) {
-    int i = random(0,numLeafs);
+    int i = generator.nextInt(0,numLeafs);
       tree[i].cb = ColorBlender(Color::GREEN, colorwheel.color(0),
         generator.nextRandom(0.20f, 1.0f));
   }
@@ -479,7 +544,7 @@ void Tree::draw(float dt) {
 void Voxicles::init() {
   timer1 = 30.0f;
   qAngle/=qDivider;
-  qDivider = random(1,8);
+  qDivider = generator.nextInt(1,8);
   qAngle*=qDivider;
   sAngle=0;
   step=0;
@@ -540,3 +605,195 @@ void Voxicles::draw(float dt) {
     if(--step==0) restart();
   }
 }
+/*---------------------------------------------------------------------------------------
+ * PLASMA
+ *-------------------------------------------------------------------------------------*/
+void Plasma::init() {
+  noise.seed(generator.next());
+  phase = 0;
+  timer = 20.0f;
+}
+void Plasma::draw(float dt) {
+  phase += dt;
+  colorwheel.turn(dt/20);
+
+  // sample the noise field 0.18 lattice cells apart, moving 0.35 cells per second in time
+  const int32_t offset[3] = {0, 0, 0};
+  noise.fill(field, width, height, depth, 0.18f*65536, offset, phase*0.35f*65536);
+  int16_t* n = field;
+  for(int x=0;x<width;x++)
+  for(int y=0;y<height;y++)
+  for(int z=0;z<depth;z++) {
+    int32_t v = *n++;
+    if(v <= 0) continue;
+    Color c = colorwheel.color(v*(0.25f/32767));
+    c.R = (c.R*v) >> 15;
+    c.G = (c.G*v) >> 15;
+    c.B = (c.B*v) >> 15;
+    cube.setVoxel(x,y,z, c);
+  }
+
+  if(timer.expired()) restart();
+}
+/*---------------------------------------------------------------------------------------
+ * STREAMER
+ *-------------------------------------------------------------------------------------*/
+bool Streamer::available() {
+  return Serial.available() > 0;
+}
+void Streamer::init() {
+  timeout = 2.0f;
+}
+void Streamer::draw(float dt) {
+  (void)dt;
+  bool received = receiver.receive(Serial);
+  bool decoded = false;
+  // programs are kept for the Bytecode animation, they don't draw a frame
+  if(received && receiver.type() == FrameCodec::PROGRAM)
+    VoxelVM::store(receiver.payload(), receiver.length());
+  // frames are decoded straight into the rendering cube against the displayed cube
+  else if(received)
+    decoded = FrameCodec::decode(receiver.type(), receiver.payload(), receiver.length(),
+      cube.getDisplayedCube(), cube.getRenderingCube());
+  if(received)
+    timeout = 2.0f;
+  if(!decoded)
+	cube.copy();
+  // stop streaming when the PC hasn't sent a frame for a while
+  if(timeout.expired()) restart();
+}
+/*----------------------------------------------------------------------------------------------
+ * PLAYER CLASS
+ *----------------------------------------------------------------------------------------------
+ * Plays a sequence from the SD card at the frame rate it was recorded with. When the cube
+ * runs slower than the sequence, frames are decoded in place until it has caught up.
+ */
+Player::Player(const char* filename_) {
+  filename = filename_;
+}
+void Player::init() {
+  time = 0;
+  sequence.open(filename);
+}
+void Player::draw(float dt) {
+  // no card or no sequence, let the cube pick another animation
+  if(!sequence.isOpen()) {
+    cube.copy();
+    restart();
+    return;
+  }
+  time += dt;
+  int frame = 1 + (int)(time*sequence.fps());
+  if(frame > sequence.frames()) frame = sequence.frames();
+  bool decoded = false;
+  while(sequence.position() < frame) {
+    const Frame& previous = decoded ? cube.getRenderingCube() : cube.getDisplayedCube();
+    if(!sequence.next(previous, cube.getRenderingCube())) {
+      cube.copy();
+      sequence.close();
+      restart();
+      return;
+    }
+    decoded = true;
+  }
+  if(!decoded)
+    cube.copy();
+  // read the next frames while this one is displayed
+  sequence.prefetch();
+  if(time*sequence.fps() >= sequence.frames()) {
+    sequence.close();
+    restart();
+  }
+}
+/*---------------------------------------------------------------------------------------
+ * BYTECODE
+ *-------------------------------------------------------------------------------------*/
+Bytecode::Bytecode() : code(nullptr), length(0) { }
+Bytecode::Bytecode(const uint8_t* code_, int length_) : code(code_), length(length_) { }
+void Bytecode::init() {
+  time = 0;
+  timer = 20.0f;
+  if(code) {
+    vm.load(code, length);
+  } else {
+    uint8_t stored[VoxelVM::maxCode];
+    vm.load(stored, VoxelVM::restore(stored));
+  }
+}
+void Bytecode::draw(float dt) {
+  // nothing uploaded yet, let the cube pick another animation
+  if(!vm.loaded()) {
+    cube.copy();
+    restart();
+    return;
+  }
+  time += dt;
+  colorwheel.turn(-dt/10);
+  vm.run(cube.getRenderingCube(), colorwheel, time);
+
+  if(timer.expired()) restart();
+}
+namespace {
+// CPU cycles of a frame, averaged over a few frames at 60 frames per second
+uint32_t frameCycles(Animation& animation) {
+  const int frames = 30;
+  ARM_DEMCR |= ARM_DEMCR_TRCENA;
+  ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+  Clock::freeze(1000000);
+  animation.restart();
+  uint32_t cycles = 0;
+  for(int f=0;f<frames;f++) {
+    Clock::step(16667);
+    uint32_t start = ARM_DWT_CYCCNT;
+    animation.animate();
+    cycles += ARM_DWT_CYCCNT - start;
+  }
+  animation.restart();
+  Clock::run();
+  return cycles/frames;
+}
+}
+int Bytecode::check(Print& log) {
+  Rainbow rainbow;
+  Bytecode rainbowProgram(VoxelVM::rainbow, VoxelVM::rainbowLength);
+  Sinus sinus;
+  Bytecode sinusProgram(VoxelVM::sinus, VoxelVM::sinusLength);
+  // before the timing, the animations keep their phase when they restart
+  const int rainbowError = cube.compare(&rainbow, &rainbowProgram);
+  const int sinusError = cube.compare(&sinus, &sinusProgram);
+  log.printf("rainbow: %lu cycles native, %lu cycles bytecode, largest channel error %d\n",
+             (unsigned long)frameCycles(rainbow), (unsigned long)frameCycles(rainbowProgram),
+             rainbowError);
+  log.printf("sinus: %lu cycles native, %lu cycles bytecode, largest channel error %d\n",
+             (unsigned long)frameCycles(sinus), (unsigned long)frameCycles(sinusProgram),
+             sinusError);
+  return (rainbowError > maxCheckError) + (sinusError > maxCheckError);
+}
+#ifdef AUDIO_INPUT
+/*---------------------------------------------------------------------------------------
+ * SPECTRUM BARS
+ *-------------------------------------------------------------------------------------*/
+void SpectrumBars::init() {
+  spectrum.begin();
+  timer1 = 30.0f;
+  timer2 = 0.06f;
+  memset(history, 0, sizeof(history));
+}
+void SpectrumBars::draw(float dt) {
+  spectrum.update();
+  colorwheel.turn(dt/10);
+  if(timer2.ticks())
+    memmove(history[1], history[0], sizeof(history) - sizeof(history[0]));
+  for(int x=0;x<width;x++)
+    history[0][x] = spectrum.level(x);
+
+  for(int z=0;z<depth;z++)
+  for(int x=0;x<width;x++) {
+    int top = history[z][x]*height + 0.5f;
+    for(int y=0;y<top;y++)
+      cube.setVoxel(x,y,z, Color(colorwheel.color(0.04f*y), Color::BLACK, z, depth));
+  }
+
+  if(timer1.expired()) restart();
+}
+#endif
@@ -1,12 +1,19 @@
 #ifndef ANIMATION_H
 #define ANIMATION_H
 #include "Util.h"
+#include "Particles.h"
+#include "Noise.h"
+#include "FrameCodec.h"
+#include "Sequence.h"
+#include "Spectrum.h"
+#include "VoxelVM.h"
+#include "OctadecaTLC5940.h"
 
 class Animation {
 public:
   virtual ~Animation();
-  // run animation with respect to size
-  void animate(int width, int height, int depth);
+  // run one frame of the animation
+  void animate();
   // test if animation is still running
   bool running();
   // restarts animation next time animate is called
@@ -17,20 +24,15 @@ protected:
   // init method needs to be overridden
   virtual void init() = 0;
 private:
-  // time of first frame of this animation
-  unsigned long m_startTime = 0;
+  // false until the first frame after a restart
+  bool m_running = false;
   // time of last frame of this animation
-  unsigned long m_lastTime = 0;
-  // time of current frame of this animation
-  unsigned long m_currentTime = 0;
-  // delta time between this frame and previous
-  unsigned long m_deltaTime = 0;
-  // total run time of this animation
-  unsigned long m_runTime = 0;
+  uint32_t m_lastTime = 0;
 protected:
-  int width;
-  int height;
-  int depth;
+  // size of the cube, constant so loops over the cube have fixed bounds
+  static constexpr int width = X_LAYERS;
+  static constexpr int height = Y_LAYERS;
+  static constexpr int depth = Z_LAYERS;
 protected:
   // animation helper variables.
   float X, Y, Z;
@@ -38,9 +40,51 @@ protected:
   float phase = 0;
 };
 
-class Sinus : public Animation {
+/* Base of the animations that are a function of the voxel. The shader owns the loops over
+ * the cube and asks the animation for its terms at the level where they change, so they are
+ * computed once and not for every voxel:
+ *   begin(dt)              once per frame, before drawing
+ *   layer(y)               returns a Layer, the terms that only depend on y
+ *   column(x, z)           returns a Column, the terms that only depend on x and z
+ *   row(x, y, layer)       returns the Linear term of a row along z
+ *   shade(voxel, linear, y, layer, column)  sets a voxel or leaves it dark
+ *   end()                  once per frame, after drawing
+ * An animation declares the hooks and the Layer and Column types it needs, the others do
+ * nothing. The linear term is carried along a row by adding its step, so a row costs no
+ * multiplies for it. The animation is the template argument, so the hooks are inlined
+ * into the loops. */
+template<typename Shader>
+class VoxelShader : public Animation {
+protected:
+  // a term that changes by the same step from voxel to voxel along a row
+  struct Linear {
+    float start;
+    float step;
+  };
+  struct Layer {};
+  struct Column {};
+protected:
+  void begin(float) {}
+  void end() {}
+  Layer layer(int) { return Layer(); }
+  Column column(int, int) { return Column(); }
+  template<typename L>
+  Linear row(int, int, const L&) { return Linear{0, 0}; }
 private:
-  void draw(float);
+  void draw(float dt);
+};
+
+class Sinus : public VoxelShader<Sinus> {
+  friend class VoxelShader<Sinus>;
+private:
+  struct Column {
+    int height;
+    Color color;
+  };
+  void begin(float dt);
+  void end();
+  Column column(int x, int z);
+  void shade(Voxel& voxel, float linear, int y, const Layer& layer, const Column& column);
   void init();
 };
 
@@ -72,15 +116,29 @@ private:
   int loops;
 };
 
-class Rainbow : public Animation {
+class Rainbow : public VoxelShader<Rainbow> {
+  friend class VoxelShader<Rainbow>;
 private:
-  void draw(float);
+  void begin(float dt);
+  void end();
+  Linear row(int x, int y, const Layer& layer);
+  void shade(Voxel& voxel, float linear, int y, const Layer& layer, const Column& column);
   void init();
 };
 
-class Spin : public Animation {
+class Spin : public VoxelShader<Spin> {
+  friend class VoxelShader<Spin>;
 private:
-  void draw(float);
+  struct Layer {
+    float sine;
+    float cosine;
+    Color color;
+  };
+  void begin(float dt);
+  void end();
+  Layer layer(int y);
+  Linear row(int x, int y, const Layer& layer);
+  void shade(Voxel& voxel, float linear, int y, const Layer& layer, const Column& column);
   void init();
 private:
   int direction = 1;
@@ -127,6 +185,18 @@ private:
   Timer timer;
 };
 
+class Spinner : public Animation {
+private:
+  void draw(float);
+  void init();
+public:
+  Spinner(Animation* a);
+private:
+  Animation* a;
+  Vector3 axis;
+  float angle;
+};
+
 class Arrows : public Animation {
 private:
   void draw(float);
@@ -150,12 +220,13 @@ private:
 class OutsideScroller : public Animation {
 public:
   OutsideScroller(const char*);
+  // replace the message, scrolling starts over
+  void setText(const char*);
 private:
   void draw(float);
   void init();
 private:
-  char* text;
-  unsigned int numChars;
+  TextStrip strip;
   uint16_t bitPos;
   uint16_t startPos;
   Timer timer;
@@ -166,12 +237,13 @@ private:
 class InsideScroller : public Animation {
 public:
   InsideScroller(const char*);
+  // replace the message, scrolling starts over
+  void setText(const char*);
 private:
   void draw(float);
   void init();
 private:
-  char* text;
-  int numChars;
+  TextStrip strip;
   int16_t charPos;
   uint16_t zPos;
   Timer timer;
@@ -204,16 +276,97 @@ private:
 };
 
 class Fireworks : public Animation {
+public:
+  Fireworks(int shells = 1);
 private:
   void draw(float);
   void init();
 private:
-  Vector3 source, target, delta, velocity;
-  int numDebris;
-  Object missile;
-  Object debris[40];
+  struct Shell {
+    Object missile;
+    Vector3 target;
+    float delay;
+    bool exploded;
+  };
+  void launch(Shell& shell);
+  void explode(Shell& shell, const Vector3& position);
+private:
+  static const int maxShells = 3;
+  int numShells;
+  Shell shells[maxShells];
+  ParticlePool<40*maxShells> debris;
 };
 
+class Plasma : public Animation {
+private:
+  void draw(float);
+  void init();
+private:
+  Timer timer;
+  SimplexNoise noise;
+  int16_t field[X_LAYERS*Y_LAYERS*Z_LAYERS];
+};
+
+class Streamer : public Animation {
+public:
+  // true when a PC started sending frames over USB serial
+  static bool available();
+private:
+  void draw(float);
+  void init();
+private:
+  Timer timeout;
+  FrameReceiver receiver;
+};
+
+class Player : public Animation {
+public:
+  Player(const char* filename);
+private:
+  void draw(float);
+  void init();
+private:
+  const char* filename;
+  SequenceFile sequence;
+  float time = 0;
+};
+
+class Bytecode : public Animation {
+public:
+  // runs the program that was uploaded last
+  Bytecode();
+  // runs the given program
+  Bytecode(const uint8_t* code, int length);
+  /* Compares the programs of VoxelVM with the Rainbow and Sinus animations they copy,
+   * reports the time per frame of both and their largest channel error. Returns the
+   * number of programs that are off by more than maxCheckError. */
+  static int check(Print& log);
+  // fixed point and the table sine of the VM against the floats of the animations
+  static const int maxCheckError = 64;
+private:
+  void draw(float);
+  void init();
+private:
+  const uint8_t* code;
+  int length;
+  float time = 0;
+  Timer timer;
+  VoxelVM vm;
+};
+
+#ifdef AUDIO_INPUT
+class SpectrumBars : public Animation {
+private:
+  void draw(float);
+  void init();
+private:
+  Timer timer1, timer2;
+  // levels of every band, the front row is the newest and older rows move back
+  float history[Z_LAYERS][Spectrum::numBands];
+  static_assert(Spectrum::numBands == X_LAYERS, "one band for every column along x");
+};
+#endif
+
 class Voxicles : public Animation {
 private:
   void draw(float);
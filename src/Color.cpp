@@ -1,4 +1,7 @@
 #include "Color.h"
+#include "Util.h"
+
+extern NoiseGenerator generator;
 
 const Color Color::BLACK    (0x000, 0x000, 0x000);
 const Color Color::WHITE    (0xFFF, 0xFFF, 0xFFF);
@@ -45,15 +48,38 @@ void Color::print() {
 }
 
 void Color::random() {
-  R=::random(4096);
-  G=::random(4096);
-  B=::random(4096);
+  R=generator.nextInt(4096);
+  G=generator.nextInt(4096);
+  B=generator.nextInt(4096);
 }
 
 bool Color::isBlack() {
   return (R|G|B)==0;
 }
 
+#ifdef FRAMEBUFFER_8BIT
+/* The curve is 4095*(3v^2 + 255v)/(4*255^2), the steps are 4 at the dim end and grow to 28
+ * at full brightness. Compressing picks the stored value at or below the color. Rounding to
+ * the nearest one would let Cube::fade stall: a dim voxel scaled by less than half a step
+ * went back to the value it came from and never reached black. The tables are built by the
+ * compiler, so they end up in flash. */
+namespace {
+constexpr uint16_t curve(int v) {
+  return (4095L*(3L*v*v + 255L*v) + 130050)/260100;
+}
+}
+constexpr Voxel::Tables::Tables() : expand(), compress() {
+  for(int v=0;v<256;v++)
+    expand[v] = curve(v);
+  int v = 0;
+  for(int c=0;c<4096;c++) {
+    while(v < 255 && curve(v+1) <= c) v++;
+    compress[c] = v;
+  }
+}
+constexpr const Voxel::Tables Voxel::m_tables;
+#endif
+
 ColorWheel::ColorWheel(int steps){
   m_steps = steps;
 }
@@ -90,6 +116,12 @@ void ColorWheel::turn(float percentage) {
   if(percentage>=1.0f) percentage = 0;
   m_wheelPosition=percentage;
 }
+float ColorWheel::position() const {
+  return m_wheelPosition;
+}
+void ColorWheel::setPosition(float position) {
+  m_wheelPosition = position;
+}
 ColorBlender::ColorBlender() {}
 ColorBlender::ColorBlender(float targetTime_) {
 	elapsedTime = 0;
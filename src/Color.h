@@ -32,6 +32,42 @@ public:
   bool isBlack();
 };
 
+#ifdef FRAMEBUFFER_8BIT
+/* A color as it is stored in a frame, with 8 bits per channel. This halves the memory of
+ * the frames and the bytes every bulk operation moves. Channels are stored on a curve that
+ * keeps more steps for dim colors, where the eye notices them, and converted to and from
+ * 12 bit Colors with lookup tables. Animations keep using Color, channels above 4095 are
+ * stored as 4095. */
+class Voxel {
+public:
+  uint8_t r;
+  uint8_t g;
+  uint8_t b;
+public:
+  Voxel() = default;
+  Voxel(const Color& c) {
+    r = compress(c.R);
+    g = compress(c.G);
+    b = compress(c.B);
+  }
+  operator Color() const {
+    return Color(m_tables.expand[r], m_tables.expand[g], m_tables.expand[b]);
+  }
+private:
+  static uint8_t compress(uint16_t channel) {
+    return m_tables.compress[channel > 4095 ? 4095 : channel];
+  }
+  struct Tables {
+    uint16_t expand[256];
+    uint8_t compress[4096];
+    constexpr Tables();
+  };
+  static const Tables m_tables;
+};
+#else
+typedef Color Voxel;
+#endif
+
 class ColorWheel {
 private:
   int16_t m_steps = 0;
@@ -42,6 +78,9 @@ private:
 public:
   ColorWheel(int steps);
   void turn(float percentage);
+  // position of the wheel, 0 is where it started
+  float position() const;
+  void setPosition(float position);
   Color color(float percentage);
   void add(Color);
 private:
@@ -1,11 +1,41 @@
+#include <new>
 #include "Cube.h"
+#include "Digest.h"
 #include "Quaternion.h"
+#include "Util.h"
 
-// Set dimensions of the Led Cube and initialize the OctadecaTLC5940 driver.
-Cube::Cube(int width, int height, int depth){
-	m_Width = width;
-	m_Height = height;
-	m_Depth = depth;
+extern NoiseGenerator generator;
+extern ColorWheel colorwheel;
+
+namespace {
+template<typename T>
+Animation* construct(void* memory) {
+  static_assert(sizeof(T) <= Cube::arenaSize, "animation doesn't fit the arena");
+  return new(memory) T();
+}
+template<typename... T>
+struct Playlist {
+  static constexpr int size = sizeof...(T);
+  static constexpr Animation* (*factories[sizeof...(T)])(void*) = { construct<T>... };
+};
+template<typename... T>
+constexpr Animation* (*Playlist<T...>::factories[sizeof...(T)])(void*);
+typedef Playlist<PLAYLIST> playlist;
+// the names of the playlist, PLAYLIST is expanded before it is turned into a string
+#define NAMES(...) #__VA_ARGS__
+#define EXPANDED_NAMES(...) NAMES(__VA_ARGS__)
+const char playlistNames[] = EXPANDED_NAMES(PLAYLIST);
+}
+
+#ifdef ARENA_REPORT
+// fails to compile on purpose, the error message shows the size of the arena
+template<size_t size> struct ArenaSize;
+ArenaSize<Cube::arenaSize> arenaSize;
+#endif
+
+// The size of the Led Cube comes from X_LAYERS, Y_LAYERS and Z_LAYERS of the driver.
+Cube::Cube(){
+	activate(construct<TechnasiumShow>);
 }
 /* The map function maps the distance (in) on a scale of inMin to inMax to the
    distance (out) on a scale of outMin to outMax */
@@ -14,18 +44,18 @@ float Cube::map(float in, float inMin, float inMax, float outMin, float outMax)
 }
 // Move the cube down, clear the top layer
 void Cube::down() {
-  for(int x=0; x < m_Width;x++)
-  for(int z=0; z < m_Depth;z++) {
-    for(int y=1;y < m_Height;y++)
+  for(int x=0; x < X_LAYERS;x++)
+  for(int z=0; z < Z_LAYERS;z++) {
+    for(int y=1;y < Y_LAYERS;y++)
       setVoxel(x,y-1,z, getDisplayedVoxel(x,y,z));
-    setVoxel(x,m_Height-1,z, Color::BLACK);
+    setVoxel(x,Y_LAYERS-1,z, Color::BLACK);
   }
 }
 // Copy the displayed cube to the rendering cube
 void Cube::copy() {
-  for(int x=0;x < m_Width;x++)
-  for(int y=0;y < m_Height;y++)
-  for(int z=0;z < m_Depth;z++)
+  for(int x=0;x < X_LAYERS;x++)
+  for(int y=0;y < Y_LAYERS;y++)
+  for(int z=0;z < Z_LAYERS;z++)
     setVoxel(x,y,z, getDisplayedVoxel(x,y,z));
 }
 // Fades the entire cube to zero in the specified amount of steps (0.99 = 0)
@@ -34,9 +64,9 @@ void Cube::copy() {
 // value linear interpolation is impossible. This looks very impressive regardless :-)
 void Cube::fade(int steps) {
   double multiplier = pow(0.99/4096, 1.0/steps);
-  for(int x=0;x < m_Width;x++)
-  for(int y=0;y < m_Height;y++)
-  for(int z=0;z < m_Depth;z++) {
+  for(int x=0;x < X_LAYERS;x++)
+  for(int y=0;y < Y_LAYERS;y++)
+  for(int z=0;z < Z_LAYERS;z++) {
     Color rgb = getDisplayedVoxel(x,y,z);
     rgb.R *= multiplier;
     rgb.G *= multiplier;
@@ -69,7 +99,7 @@ void Cube::radiateVoxel(Vector3& vOrigin, Color c_, float distance) {
   for(int y=vOrigin.y-1;y<vOrigin.y+2;y++)
   for(int z=vOrigin.z-1;z<vOrigin.z+2;z++) {
 	Vector3 vLight = Vector3(x,y,z) ;
-	if(vLight.inside(m_Width,m_Height,m_Depth)) {
+	if(vLight.inside(X_LAYERS,Y_LAYERS,Z_LAYERS)) {
 	  Vector3 vDistance = vOrigin - vLight;
 	  float radius = distance*vDistance.magnitude();
 	  // inverse square rule super powered by inverse/(radius^5+1)
@@ -79,13 +109,401 @@ void Cube::radiateVoxel(Vector3& vOrigin, Color c_, float distance) {
 	}
   }
 }
+/* Rotates the rendering cube around its center by the unit quaternion q, scales it and
+ * moves it by offset voxels. Every voxel looks up where it came from, so there are no
+ * holes. The rotation is turned into a fixed point Q16.16 matrix once, after that walking
+ * along z only adds the last matrix column to the source position. */
+void Cube::transform(const Quaternion& q, float scale, const Vector3& offset, Filter filter) {
+  Frame& cube = getRenderingCube();
+  memcpy(m_scratch, cube, sizeof(Frame));
+  // The inverse of a rotation matrix is its transpose
+  float r[3][3];
+  q.toMatrix(r);
+  int32_t m[3][3];
+  for(int i=0;i<3;i++)
+  for(int j=0;j<3;j++)
+    m[i][j] = r[j][i]/scale*65536;
+  // Source position of voxel (0,0,0)
+  Vector3 c = Vector3((X_LAYERS-1)/2.0f, (Y_LAYERS-1)/2.0f, (Z_LAYERS-1)/2.0f);
+  Vector3 d = -c - offset;
+  int32_t origin[3];
+  for(int i=0;i<3;i++)
+    origin[i] = (m[i][0]*d.x + m[i][1]*d.y + m[i][2]*d.z) + (&c.x)[i]*65536;
+
+  for(int x=0;x<X_LAYERS;x++)
+  for(int y=0;y<Y_LAYERS;y++) {
+    int32_t sx = origin[0] + x*m[0][0] + y*m[0][1];
+    int32_t sy = origin[1] + x*m[1][0] + y*m[1][1];
+    int32_t sz = origin[2] + x*m[2][0] + y*m[2][1];
+    for(int z=0;z<Z_LAYERS;z++, sx+=m[0][2], sy+=m[1][2], sz+=m[2][2]) {
+      if(filter == NEAREST) {
+        int ix = (sx+32768) >> 16, iy = (sy+32768) >> 16, iz = (sz+32768) >> 16;
+        if(ix >= 0 && ix < X_LAYERS && iy >= 0 && iy < Y_LAYERS && iz >= 0 && iz < Z_LAYERS)
+          cube[x][y][z] = m_scratch[ix][iy][iz];
+        else
+          cube[x][y][z] = Color::BLACK;
+        continue;
+      }
+      // Blend the 8 surrounding voxels with 8 bit weights, outside the cube is black
+      int ix = sx >> 16, iy = sy >> 16, iz = sz >> 16;
+      int fx = (sx >> 8) & 0xFF, fy = (sy >> 8) & 0xFF, fz = (sz >> 8) & 0xFF;
+      if(ix < -1 || ix >= X_LAYERS || iy < -1 || iy >= Y_LAYERS || iz < -1 || iz >= Z_LAYERS) {
+        cube[x][y][z] = Color::BLACK;
+        continue;
+      }
+      int32_t rgb[3] = {0, 0, 0};
+      for(int i=0;i<2;i++)
+      for(int j=0;j<2;j++)
+      for(int k=0;k<2;k++) {
+        int vx = ix+i, vy = iy+j, vz = iz+k;
+        if(vx < 0 || vx >= X_LAYERS || vy < 0 || vy >= Y_LAYERS || vz < 0 || vz >= Z_LAYERS)
+          continue;
+        int32_t w = (i ? fx : 256-fx) * (j ? fy : 256-fy);
+        w = (w * (k ? fz : 256-fz)) >> 8;
+        Color s = m_scratch[vx][vy][vz];
+        rgb[0] += s.R*w;
+        rgb[1] += s.G*w;
+        rgb[2] += s.B*w;
+      }
+      cube[x][y][z] = Color(rgb[0] >> 16, rgb[1] >> 16, rgb[2] >> 16);
+    }
+  }
+}
 void Cube::animate() {
-  // render one animation frame using the cube dimensions
-  animation->animate(m_Width, m_Height, m_Depth);
+  // the animation and its timers all see the same time during a frame
+  Clock::tick();
+  // a PC sending frames takes over the display until it stops sending
+  if(m_factory != construct<Streamer> && Streamer::available()) {
+	m_transitioning = false;
+	setOverlay(nullptr, nullptr);
+	activate(construct<Streamer>);
+  }
+  // render one animation frame
+  animation->animate();
   // when an animation is finished it resets and has status not running
   if(!animation->running()) {
-	animation = animations[random(0,sizeof(animations)/sizeof(Animation*))];
+	// keep its last frame to blend it into the next animation
+	if(m_transition != CUT && m_factory != construct<Streamer>) {
+	  // a transition that is still running blends m_outgoing in, the interrupt must not
+	  // pack a layer from it while it is overwritten
+	  setOverlay(nullptr, nullptr);
+	  memcpy(m_outgoing, getRenderingCube(), sizeof(Frame));
+	  m_transitionStart = Clock::now();
+	  m_transitioning = true;
+	}
+	activate(playlist::factories[generator.nextInt(0,playlist::size)]);
+  } else if(m_transitioning) {
+	const uint32_t elapsed = Clock::now() - m_transitionStart;
+	if(elapsed >= m_transitionTime) {
+	  m_transitioning = false;
+	  setOverlay(nullptr, nullptr);
+	} else {
+	  setOverlay(&m_outgoing, blend((uint64_t)elapsed*256/m_transitionTime));
+	}
   }
   // wait for vertical blank and than switch rendering and displayed buffers
   update();
 }
+void Cube::setTransition(Transition transition, float seconds) {
+  m_transition = transition;
+  m_transitionTime = seconds > 0.001f ? lroundf(seconds*1000000.0f) : 1000;
+}
+/* Sets how much of the outgoing frame every voxel shows, progress goes from 0 to 256. The
+ * packer does the actual blending, so the incoming animation still sees its own frames.
+ * Wipes move an edge of 2 voxels through the cube and dissolve gives every voxel its own
+ * moment to switch, from a hash of its position. The interrupt may pack a layer with the
+ * weights of the next frame, that is never more than one frame off. */
+const uint8_t* Cube::blend(int progress) {
+  const int edge = 2;
+  const int size[3] = { X_LAYERS, Y_LAYERS, Z_LAYERS };
+  for(int x=0;x<X_LAYERS;x++)
+  for(int y=0;y<Y_LAYERS;y++)
+  for(int z=0;z<Z_LAYERS;z++) {
+    int w;
+    switch(m_transition) {
+    case WIPE_X:
+    case WIPE_Y:
+    case WIPE_Z: {
+      int axis = m_transition - WIPE_X;
+      int p = axis == 0 ? x : (axis == 1 ? y : z);
+      int front = progress*(size[axis] + edge);
+      w = ((p + edge)*256 - front)*255/(edge*256);
+      break;
+    }
+    case DISSOLVE: {
+      uint32_t moment = ((x*Y_LAYERS + y)*Z_LAYERS + z)*2654435761u >> 24;
+      w = (moment + 32 - progress*288/256)*8;
+      break;
+    }
+    default:
+      w = 255 - progress*255/256;
+      break;
+    }
+    m_weights[x][y][z] = w < 0 ? 0 : (w > 255 ? 255 : w);
+  }
+  return &m_weights[0][0][0];
+}
+void Cube::activate(Factory factory) {
+  if(animation)
+	animation->~Animation();
+  m_factory = factory;
+  animation = factory(m_arena);
+}
+/*----------------------------------------------------------------------------------------------
+ * REPLAYS
+ *----------------------------------------------------------------------------------------------
+ * A replay runs an animation at 60 frames per second on a frozen clock, starting with the
+ * same random numbers and color wheel position every time, so it draws the same frames
+ * whatever else ran before. Frames are still shown, fades need the displayed cube.
+ */
+void Cube::replay(Animation* animation) {
+  generator.seed(replaySeed);
+  colorwheel.setPosition(0);
+  Clock::freeze(1000000);
+  animation->restart();
+}
+/* The digest file holds a record per animation and frame format: a key like "Sinus 12bit",
+ * the number of frames and the hash of every frame. Builds with FRAMEBUFFER_8BIT draw other
+ * hashes, so they keep records of their own in the same file. A record that isn't there yet
+ * is appended, so a new animation or build is recorded the first time it runs, unless the
+ * file is only checked like the committed digests of test/test_golden. */
+namespace {
+#ifdef FRAMEBUFFER_8BIT
+const char frameFormat[] = "8bit";
+#else
+const char frameFormat[] = "12bit";
+#endif
+struct GoldenRecord {
+  char key[32];
+  uint32_t frames;
+};
+// finds the next name of a list like playlistNames and moves names past it, returns its length
+int nextName(const char*& names, const char*& name) {
+  while(*names == ',' || *names == ' ') names++;
+  name = names;
+  while(*names && *names != ',' && *names != ' ') names++;
+  return names - name;
+}
+// looks for the record with the same key and number of frames and compares its hashes,
+// first is the first frame that changed or -1. Returns false when there is no such record.
+bool findGolden(File& file, const GoldenRecord& record, const uint32_t* hashes, int& first) {
+  uint32_t position = 0;
+  GoldenRecord golden;
+  while(file.seek(position) && file.read(&golden, sizeof(golden)) == sizeof(golden)) {
+    position += sizeof(golden) + golden.frames*sizeof(uint32_t);
+    if(golden.frames != record.frames || strncmp(golden.key, record.key, sizeof(golden.key)))
+      continue;
+    first = -1;
+    for(uint32_t f=0;f<record.frames && first < 0;f++) {
+      uint32_t h = 0;
+      if(file.read(&h, sizeof(h)) != sizeof(h) || h != hashes[f])
+        first = f;
+    }
+    return true;
+  }
+  return false;
+}
+}
+int Cube::verify(Print& log, const char* filename, int frames, bool recordMissing) {
+  File file;
+  if(beginCard())
+    file = SD.open(filename, recordMissing ? FILE_WRITE : FILE_READ);
+  uint32_t* hashes = new uint32_t[frames];
+  int changed = 0;
+  const char* names = playlistNames;
+  for(int a=0;a<playlist::size;a++) {
+    GoldenRecord record = {};
+    const char* name;
+    const int length = nextName(names, name);
+    snprintf(record.key, sizeof(record.key), "%.*s %s", length, name, frameFormat);
+    record.frames = frames;
+    activate(playlist::factories[a]);
+    // start from a dark cube, so fades don't depend on the animation before
+    memset(&getRenderingCube(), 0, sizeof(Frame));
+    update();
+    replay(animation);
+    uint32_t digest = 2166136261u;
+    for(int f=0;f<frames;f++) {
+      Clock::step(replayStep);
+      animation->animate();
+      hashes[f] = FrameDigest::hash(getRenderingCube());
+      digest = (digest ^ hashes[f]) * 16777619u;
+      update();
+    }
+    animation->restart();
+    log.printf("%s digest %08lx", record.key, (unsigned long)digest);
+    int first = -1;
+    const bool found = file && findGolden(file, record, hashes, first);
+    if(!found && !recordMissing) {
+      log.println(" missing");
+      changed++;
+    } else if(!file) {
+      log.println();
+    } else if(!found) {
+      file.seek(file.size());
+      file.write((const uint8_t*)&record, sizeof(record));
+      file.write((const uint8_t*)hashes, frames*sizeof(uint32_t));
+      log.println(" recorded");
+    } else if(first < 0) {
+      log.println(" ok");
+    } else {
+      log.printf(" changed at frame %d\n", first);
+      changed++;
+    }
+  }
+  if(file)
+    file.close();
+  delete[] hashes;
+  Clock::run();
+  return changed;
+}
+// Both animations fade from the frame the candidate drew, so the error is what the candidate
+// adds in one frame instead of the difference building up. Each keeps its own random numbers
+// and color wheel, they share the clock.
+int Cube::compare(Animation* reference, Animation* candidate, int frames) {
+  Frame* expected = new Frame[1];
+  replay(reference);
+  NoiseGenerator referenceGenerator = generator;
+  float referenceWheel = colorwheel.position();
+  replay(candidate);
+  int error = 0;
+  for(int f=0;f<frames;f++) {
+    Clock::step(replayStep);
+    NoiseGenerator candidateGenerator = generator;
+    float candidateWheel = colorwheel.position();
+    generator = referenceGenerator;
+    colorwheel.setPosition(referenceWheel);
+    // both draw on an empty canvas, whatever was drawn before
+    memset(&getRenderingCube(), 0, sizeof(Frame));
+    reference->animate();
+    memcpy(expected, &getRenderingCube(), sizeof(Frame));
+    referenceGenerator = generator;
+    referenceWheel = colorwheel.position();
+    generator = candidateGenerator;
+    colorwheel.setPosition(candidateWheel);
+    memset(&getRenderingCube(), 0, sizeof(Frame));
+    candidate->animate();
+    int e = FrameDigest::maxError(*expected, getRenderingCube());
+    if(e > error) error = e;
+    update();
+  }
+  reference->restart();
+  candidate->restart();
+  delete[] expected;
+  Clock::run();
+  return error;
+}
+/* Every benchmark result is a line of JSON, so a script on the PC can compare runs, see
+ * tools/cubebench.py. Animations start as in a replay and draw on a cleared canvas without
+ * waiting for the display, so it runs before begin and every run does the same work. */
+namespace {
+void printResult(Print& log, const char* name, uint32_t cycles, uint32_t max,
+                 int length = -1) {
+  if(length < 0) length = strlen(name);
+  log.printf("{\"name\":\"%.*s\",\"cycles\":%lu,\"max\":%lu}\n", length, name,
+             (unsigned long)cycles, (unsigned long)max);
+}
+// calls a kernel n times, returns the cycles of one call
+template<typename Kernel>
+uint32_t kernelCycles(int n, Kernel kernel) {
+  const uint32_t start = ARM_DWT_CYCCNT;
+  for(int i=0;i<n;i++)
+    kernel(i);
+  return (ARM_DWT_CYCCNT - start)/n;
+}
+}
+void Cube::benchmark(Print& log, int frames) {
+  ARM_DEMCR |= ARM_DEMCR_TRCENA;
+  ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+  const Factory others[] = { construct<Fireworks>, construct<Tree> };
+  const int count = playlist::size + sizeof(others)/sizeof(others[0]);
+  const char* names = playlistNames;
+  for(int a=0;a<count;a++) {
+    const char* name = a == playlist::size ? "Fireworks" : "Tree";
+    const int length = a < playlist::size ? nextName(names, name) : strlen(name);
+    activate(a < playlist::size ? playlist::factories[a] : others[a - playlist::size]);
+    replay(animation);
+    uint32_t total = 0, max = 0;
+    for(int f=0;f<frames;f++) {
+      Clock::step(replayStep);
+      memset(&getRenderingCube(), 0, sizeof(Frame));
+      const uint32_t start = ARM_DWT_CYCCNT;
+      animation->animate();
+      const uint32_t cycles = ARM_DWT_CYCCNT - start;
+      total += cycles;
+      if(cycles > max) max = cycles;
+    }
+    animation->restart();
+    printResult(log, name, total/frames, max, length);
+  }
+  Clock::run();
+  memset(&getRenderingCube(), 0, sizeof(Frame));
+
+  // kernels, the results go into a volatile so the compiler keeps the work
+  const int n = 1000;
+  volatile uint32_t sink = 0;
+  uint32_t cycles = kernelCycles(n, [&](int i) { sink = colorwheel.color(i*0.001f).R; });
+  printResult(log, "ColorWheel::color", cycles, cycles);
+  ColorBlender blender(Color::RED, Color::BLUE, 1.0f);
+  cycles = kernelCycles(n, [&](int) { sink = blender.blend(0.0005f).B; });
+  printResult(log, "ColorBlender::blend", cycles, cycles);
+  cycles = kernelCycles(n, [&](int i) {
+    Vector3 v(i%X_LAYERS, (i/X_LAYERS)%Y_LAYERS, 4.5f);
+    radiateVoxel(v, Color::WHITE, 1.5f);
+  });
+  printResult(log, "Cube::radiateVoxel", cycles, cycles);
+  const Quaternion q(0.9238795f, Vector3(0, 0.3826834f, 0));
+  cycles = kernelCycles(n, [&](int i) {
+    Vector3 v(i, 1, 2);
+    q.rotate(v);
+    sink = v.x;
+  });
+  printResult(log, "Quaternion::rotate", cycles, cycles);
+  // per point of a batch, the matrix is built once for all of them
+  Vector3 points[100];
+  cycles = kernelCycles(10, [&](int i) {
+    for(int p=0;p<100;p++)
+      points[p] = Vector3(p, i, 2);
+    q.rotate(points, 100);
+    sink = points[i].x;
+  })/100;
+  printResult(log, "Quaternion::rotate batch", cycles, cycles);
+  // a whole cube of 4D noise, as Plasma draws it
+  SimplexNoise simplex;
+  int16_t field[X_LAYERS][Y_LAYERS][Z_LAYERS];
+  const int32_t origin[3] = { 0, 0, 0 };
+  cycles = kernelCycles(20, [&](int i) {
+    simplex.fill(&field[0][0][0], X_LAYERS, Y_LAYERS, Z_LAYERS, 16384, origin, i*6554);
+    sink = field[i%X_LAYERS][4][4];
+  });
+  printResult(log, "SimplexNoise::fill", cycles, cycles);
+  // whole cube passes, their loops have the cube size as constant bounds
+  cycles = kernelCycles(20, [&](int) { copy(); });
+  printResult(log, "Cube::copy", cycles, cycles);
+  cycles = kernelCycles(20, [&](int) { fade(12); });
+  printResult(log, "Cube::fade", cycles, cycles);
+  // a tumbling frame, as Spinner turns it
+  Quaternion turn(10, Vector3(1, 2, 3));
+  turn.convertAxisAngle();
+  cycles = kernelCycles(20, [&](int) { transform(turn, 1, Vector3(0, 0, 0), NEAREST); });
+  printResult(log, "Cube::transform nearest", cycles, cycles);
+  cycles = kernelCycles(20, [&](int) { transform(turn, 1, Vector3(0, 0, 0), TRILINEAR); });
+  printResult(log, "Cube::transform trilinear", cycles, cycles);
+  // a frame of every transition: its weights, then the packer blends the outgoing frame in
+  const char* transitions[] = { "Cube::blend crossfade", "Cube::blend wipe x",
+    "Cube::blend wipe y", "Cube::blend wipe z", "Cube::blend dissolve" };
+  const Transition transition = m_transition;
+  for(int t=CROSSFADE;t<=DISSOLVE;t++) {
+    m_transition = (Transition)t;
+    cycles = kernelCycles(20, [&](int i) { sink = blend(i*12)[i]; });
+    printResult(log, transitions[t - CROSSFADE], cycles, cycles);
+  }
+  m_transition = transition;
+  memset(&getRenderingCube(), 0, sizeof(Frame));
+  setOverlay(&m_outgoing, blend(128));
+  cycles = packCycles();
+  setOverlay(nullptr, nullptr);
+  printResult(log, "setChannelBuffer overlay", cycles, cycles);
+  cycles = packCycles();
+  printResult(log, "setChannelBuffer", cycles, cycles);
+}
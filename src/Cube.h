@@ -22,18 +22,108 @@
     1 ++              ++ 1
     0 + + + + + + + + + 0
     0 1 2 3 4 5 6 7 8---X               */
+/*----------------------------------------------------------------------------------------------
+ * PLAYLIST
+ *----------------------------------------------------------------------------------------------
+ * The animations the cube picks from. Only the running animation is constructed, so their
+ * sizes don't add up. Animations that need settings or play other animations get a class of
+ * their own here, so every one of them can be constructed without arguments.
+ */
+class DaltonScroller : public OutsideScroller {
+public:
+  DaltonScroller() : OutsideScroller("\x1F" "Dalton Lyceum Barendrecht\x1F") {}
+};
+class TechnasiumScroller : public OutsideScroller {
+public:
+  TechnasiumScroller() : OutsideScroller("\x1F" "Technasium O&O\x1F") {}
+};
+class TechnasiumBanner : public InsideScroller {
+public:
+  TechnasiumBanner() : InsideScroller("Technasium\x1F") {}
+};
+class FireworksShow : public Mixer {
+public:
+  FireworksShow() : Mixer(&fireworks1, &fireworks2), fireworks2(2) {}
+private:
+  Fireworks fireworks1;
+  Fireworks fireworks2;
+};
+class TechnasiumShow : public Mixer {
+public:
+  TechnasiumShow() : Mixer(&banner, &fireworks) {}
+private:
+  TechnasiumBanner banner;
+  FireworksShow fireworks;
+};
+class SpiralSpinner : public Spinner {
+public:
+  SpiralSpinner() : Spinner(&spiral) {}
+private:
+  Spiral spiral;
+};
+class CardPlayer : public Player {
+public:
+  CardPlayer() : Player("cube.vxs") {}
+};
+
+// the spectrum needs audio on AUDIO_PIN, see Spectrum.h
+#ifdef AUDIO_INPUT
+#define AUDIO_PLAYLIST , SpectrumBars
+#else
+#define AUDIO_PLAYLIST
+#endif
+
+#define PLAYLIST Sinus, Spiral, Twinkel, Rain, Rainbow, Spin, Starfield, Sphere, Arrows, \
+                 Bounce, Voxicles, FireworksShow, TechnasiumShow, TechnasiumBanner, \
+                 DaltonScroller, TechnasiumScroller, Plasma, SpiralSpinner, CardPlayer, \
+                 Bytecode AUDIO_PLAYLIST
+
+// size of the largest type
+template<typename T>
+constexpr size_t largest() { return sizeof(T); }
+template<typename T, typename U, typename... Rest>
+constexpr size_t largest() {
+  return sizeof(T) > largest<U, Rest...>() ? sizeof(T) : largest<U, Rest...>();
+}
+
 class Cube : public OctadecaTLC5940 {
+ public:
+  // resampling filter used by transform
+  enum Filter { NEAREST, TRILINEAR };
+  // how the next animation takes over from the one that finished
+  enum Transition { CUT, CROSSFADE, WIPE_X, WIPE_Y, WIPE_Z, DISSOLVE };
+
  private:
-  int m_Width;
-  int m_Height;
-  int m_Depth;
+  // copy of the rendering cube for passes that can't work in place
+  Frame m_scratch;
+  // last frame of the finished animation and how much of it is still shown per voxel
+  Frame m_outgoing;
+  uint8_t m_weights[X_LAYERS][Y_LAYERS][Z_LAYERS];
+  Transition m_transition = CROSSFADE;
+  // length of a transition in microseconds
+  uint32_t m_transitionTime = 1000000;
+  // start of the running transition
+  uint32_t m_transitionStart = 0;
+  bool m_transitioning = false;
+  // time step and random seed of replays
+  static const uint32_t replayStep = 16667;
+  static const uint32_t replaySeed = 0x2545F491;
 
  private:
   void fade(int steps);
+  void replay(Animation* animation);
 
  public:
-  Cube(int width, int height, int depth);
+  // the largest animation of the playlist decides the size of the arena
+  static constexpr size_t arenaSize = largest<PLAYLIST, Streamer>();
+  // RAM set aside for the arena, raise it when an animation grows past it
+  static constexpr size_t arenaBudget = 24*1024;
+  static_assert(arenaSize <= arenaBudget, "the largest animation doesn't fit the arena");
+
+  Cube();
   using OctadecaTLC5940::setVoxel;
+  using OctadecaTLC5940::getRenderingCube;
+  using OctadecaTLC5940::getDisplayedCube;
   void setVoxel(Vector3& v, Color c);
   void mergeVoxel(int x, int y, int z, Color);
   void mergeVoxel(Vector3& v, Color c);
@@ -43,44 +133,34 @@ class Cube : public OctadecaTLC5940 {
   void down();
   void copy();
   void fade(float seconds, float dt);
+  void transform(const Quaternion& q, float scale = 1.0f,
+                 const Vector3& offset = Vector3(0, 0, 0), Filter filter = TRILINEAR);
   void animate();
+  // set how the next animation comes in and how long that takes
+  void setTransition(Transition transition, float seconds);
+  // weights of the outgoing frame for the overlay, in Frame order, at a progress of the
+  // transition from 0 to 256
+  const uint8_t* blend(int progress);
+  // replay every animation on a frozen clock with a fixed seed and check the hash of every
+  // frame against the digests in a file on the SD card. The digests are kept by animation
+  // name and frame format, the ones that aren't in the file yet are recorded. Without
+  // recordMissing the file is only read and a missing digest counts as a change. Returns
+  // the number of animations that draw something else.
+  int verify(Print& log, const char* filename, int frames = 120, bool recordMissing = true);
+  // replay two animations side by side, both draw every frame on an empty canvas. Returns
+  // the largest channel error between them.
+  int compare(Animation* reference, Animation* candidate, int frames = 120);
+  // replay every animation and some kernels and print their CPU cycles as JSON, call it
+  // before begin
+  void benchmark(Print& log, int frames = 120);
 
  private:
-  Sinus sinus = Sinus();
-  Spiral spiral = Spiral();
-  Twinkel twinkel = Twinkel();
-  Rain rain = Rain();
-  Rainbow rainbow = Rainbow();
-  Spin spin = Spin();
-  Starfield starfield = Starfield();
-  Sphere sphere = Sphere();
-  Arrows arrows = Arrows();
-  Bounce bounce = Bounce();
-  Tree tree = Tree();
-  Voxicles voxicles = Voxicles();
-
-  Fireworks fireworks1 = Fireworks();
-  Fireworks fireworks2 = Fireworks();
-  InsideScroller insideScroller = InsideScroller("Dalton Lyceum Barendrecht");
-  InsideScroller insideScroller2 = InsideScroller("Technasium\x1F");
-  OutsideScroller outsideScroller = OutsideScroller(
-      "\x1F"
-      "Dalton Lyceum Barendrecht\x1F");
-  OutsideScroller outsideScroller2 = OutsideScroller(
-      "\x1F"
-      "Technasium O&O\x1F");
-  Mixer mixer1 = Mixer(&fireworks1, &fireworks2);
-  Mixer mixer2 = Mixer(&insideScroller2, &mixer1);
-
- private:
-  Animation* animation = &mixer2;
-  Animation* animations[16] = {&sinus,           &spiral,
-                               &twinkel,         &rain,
-                               &rainbow,         &spin,
-                               &starfield,       &sphere,
-                               &arrows,          &bounce,
-                               &voxicles,        &mixer1,
-                               &mixer2,          &insideScroller2,
-                               &outsideScroller, &outsideScroller2};
+  // storage for the running animation
+  typedef Animation* (*Factory)(void* memory);
+  alignas(8) uint8_t m_arena[arenaSize];
+  Factory m_factory = nullptr;
+  Animation* animation = nullptr;
+  // destroy the running animation and construct another one in the arena
+  void activate(Factory factory);
 };
 #endif
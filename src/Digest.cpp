@@ -0,0 +1,34 @@
+#include "Digest.h"
+/*----------------------------------------------------------------------------------------------
+ * FRAMEDIGEST CLASS
+ *----------------------------------------------------------------------------------------------
+ * Channels are hashed as 12 bit values in memory order, low byte first.
+ */
+uint32_t FrameDigest::hash(const Frame& frame) {
+  const Voxel* v = &frame[0][0][0];
+  uint32_t h = 2166136261u;
+  for(int i=0;i<X_LAYERS*Y_LAYERS*Z_LAYERS;i++) {
+    Color c = v[i];
+    const uint16_t channels[3] = { c.R, c.G, c.B };
+    for(int j=0;j<3;j++) {
+      h = (h ^ (channels[j] & 0xFF)) * 16777619u;
+      h = (h ^ (channels[j] >> 8)) * 16777619u;
+    }
+  }
+  return h;
+}
+
+int FrameDigest::maxError(const Frame& a, const Frame& b) {
+  const Voxel* va = &a[0][0][0];
+  const Voxel* vb = &b[0][0][0];
+  int error = 0;
+  for(int i=0;i<X_LAYERS*Y_LAYERS*Z_LAYERS;i++) {
+    Color ca = va[i], cb = vb[i];
+    const int e[3] = { ca.R - cb.R, ca.G - cb.G, ca.B - cb.B };
+    for(int j=0;j<3;j++) {
+      if(e[j] > error) error = e[j];
+      if(-e[j] > error) error = -e[j];
+    }
+  }
+  return error;
+}
@@ -0,0 +1,15 @@
+#ifndef DIGEST_H
+#define DIGEST_H
+#include <Arduino.h>
+#include "OctadecaTLC5940.h"
+/* Fingerprints of rendered frames, for checking that a rewritten animation still draws the
+ * same thing. Frames are compared exactly by hash, or with a tolerance by channel error
+ * when the new code uses approximate math on purpose. */
+class FrameDigest {
+public:
+  // FNV-1a hash of all channels
+  static uint32_t hash(const Frame& frame);
+  // largest difference between the same channel of two frames
+  static int maxError(const Frame& a, const Frame& b);
+};
+#endif
@@ -9,68 +9,79 @@ extern NoiseGenerator generator;
 /*---------------------------------------------------------------------------------------
  * FIREWORKS
  *-------------------------------------------------------------------------------------*/
+Fireworks::Fireworks(int shells) {
+  numShells = shells < maxShells ? shells : maxShells;
+  debris.gravity = Vector3(0,-10.0f,0);
+  debris.drag = 0.05f;
+}
+
 void Fireworks::init() {
+  debris.clear();
+  float delay = 0;
+  for(int i=0;i<numShells;i++) {
+    launch(shells[i]);
+    // Launch the shells one after another
+    shells[i].delay = delay;
+    delay += generator.nextRandom(0.2f, 1.0f);
+  }
+}
+
+void Fireworks::launch(Shell& shell) {
   // calculate source normally divided from source area
-  source = Vector3(
+  Vector3 source = Vector3(
     generator.nextGaussian((float)width/2.0f, 1.5f), 0,
     generator.nextGaussian((float)depth/2.0f, 1.5f));
   // calculate targets normally divided from target area
-  target = Vector3(
+  shell.target = Vector3(
     generator.nextGaussian((float)width/2.0f, 1.5f),
     generator.nextGaussian((float)2.0f*height/3.0f, 1.5f),
     generator.nextGaussian((float)depth/2.0f, 1.5f));
   // calculate the deltas
-  delta = target - source;
+  Vector3 delta = shell.target - source;
   // Assign a time in seconds to reach the target
   float t = generator.nextGaussian(0.45f, 0.15f, 2.5f);
-  // Determine directional velocities in pixels per second
-  velocity = delta/t;
-  // Set missile source, velocity and gravity
-  missile.position = source;
-  missile.velocity = velocity;
-  missile.gravity = Vector3(0,-10.0f,0);
+  // Set missile source, velocity (directional velocities in pixels per second) and gravity
+  shell.missile.position = source;
+  shell.missile.velocity = delta/t;
+  shell.missile.gravity = Vector3(0,-10.0f,0);
+  shell.exploded = false;
+}
+
+// If target is reached the missile is exploded and debris is formed
+void Fireworks::explode(Shell& shell, const Vector3& position) {
+  shell.exploded = true;
+  Emitter emitter;
+  emitter.position = position;
+  // Overall exploding power of arrow for all debris
+  emitter.power = generator.nextRandom(5.0f,12.0f);
+  emitter.minLife = 1.0f;
+  emitter.maxLife = 2.0f;
+  emitter.burst(debris, generator.nextInt(20,40), generator.nextRandom(0.0f,1.0f), 0.005f);
 }
 
 void Fireworks::draw(float dt) {
-  if(target.y > 0) {
-	Vector3 temp = missile.position;
-    missile.move(dt);
-    if ((temp.y > missile.position.y) | (missile.position.y > target.y))  {
-      target.y = 0;
-      // If target is reached the missile is exploded and debris is formed
-      numDebris = random(20,40);
-      // Overall exploding power of arrow for all debris
-      float pwr = generator.nextRandom(5.0f,12.0f);
-      float colorturn = generator.nextRandom(0.0f,1.0f);
-      colorwheel.turn(colorturn);
-      for(int i=0;i<numDebris;i++) {
-        // Debris is formed at target and has random velocities depending on overall power
-    	Vector3 explode = Vector3(generator.nextRandom(-pwr,pwr),
-    	  generator.nextRandom(-pwr,pwr), generator.nextRandom(-pwr,pwr));
-        debris[i] = { temp, explode, Vector3(0,-10.0f,0) };
-    	debris[i].cb = ColorBlender(colorwheel.color(0.005f*i), Color::BLACK,
-    	  generator.nextRandom(1,2));
-        }
-        colorwheel.turn(-colorturn);
-      }
-    else if(missile.inside(width,height,depth))
-	  cube.setVoxel(missile.position, Color::WHITE);
-  }
-  if(target.y==0) {
-    int visible = 0;
-    for(int i=0;i<numDebris;i++) {
-	  debris[i].move(dt);
-	  debris[i].drag(dt, 0.05f);
-      Color color = debris[i].cb.blend(dt);
-      if(!color.isBlack())
-    		visible++;
-      if(debris[i].position.y < 0)
-        debris[i].position.y = 0;
-      if(debris[i].inside(width,height,depth))
-    		cube.setVoxel(debris[i].position, color);
-    }
-    if(visible==0) {
-      restart();
+  debris.update(dt);
+
+  int flying = 0;
+  for(int i=0;i<numShells;i++) {
+    Shell& shell = shells[i];
+    if(shell.exploded)
+      continue;
+    flying++;
+    if(shell.delay > 0) {
+      shell.delay -= dt;
+      continue;
     }
+    Vector3 temp = shell.missile.position;
+    shell.missile.move(dt);
+    if ((temp.y > shell.missile.position.y) | (shell.missile.position.y > shell.target.y))
+      explode(shell, temp);
+    else if(shell.missile.inside(width,height,depth))
+      cube.setVoxel(shell.missile.position, Color::WHITE);
+  }
+  debris.draw(width, height, depth);
+
+  if(flying==0 && debris.empty()) {
+    restart();
   }
 }
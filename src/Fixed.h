@@ -0,0 +1,65 @@
+#ifndef FIXED_H
+#define FIXED_H
+#include <stdint.h>
+#include <math.h>
+
+/* Q16.16 fixed point number, 16 bits integer part and 16 bits fraction. The range is
+ * -32768 to 32767.99998 with a resolution of 1/65536. Multiplying uses a 64 bit product,
+ * which is a single SMULL instruction on the Cortex-M4. Integers and floats convert
+ * implicitly, so Fixed can be used in templates written for float. */
+class Fixed {
+public:
+  int32_t raw;
+public:
+  constexpr Fixed() : raw(0) {}
+  constexpr Fixed(int v) : raw(v*65536) {}
+  constexpr Fixed(float v) : raw((int32_t)(v*65536.0f + (v < 0 ? -0.5f : 0.5f))) {}
+  constexpr Fixed(double v) : raw((int32_t)(v*65536.0 + (v < 0 ? -0.5 : 0.5))) {}
+  static constexpr Fixed fromRaw(int32_t raw) { Fixed f; f.raw = raw; return f; }
+  explicit constexpr operator float() const { return raw/65536.0f; }
+  // rounds towards minus infinity
+  explicit constexpr operator int() const { return raw >> 16; }
+
+  constexpr Fixed operator-() const { return fromRaw(-raw); }
+  constexpr Fixed& operator+=(Fixed f) { raw += f.raw; return *this; }
+  constexpr Fixed& operator-=(Fixed f) { raw -= f.raw; return *this; }
+  constexpr Fixed& operator*=(Fixed f) { raw = ((int64_t)raw*f.raw) >> 16; return *this; }
+  constexpr Fixed& operator/=(Fixed f) { raw = ((int64_t)raw << 16)/f.raw; return *this; }
+};
+
+constexpr Fixed operator+(Fixed a, Fixed b) { return a += b; }
+constexpr Fixed operator-(Fixed a, Fixed b) { return a -= b; }
+constexpr Fixed operator*(Fixed a, Fixed b) { return a *= b; }
+constexpr Fixed operator/(Fixed a, Fixed b) { return a /= b; }
+constexpr bool operator==(Fixed a, Fixed b) { return a.raw == b.raw; }
+constexpr bool operator!=(Fixed a, Fixed b) { return a.raw != b.raw; }
+constexpr bool operator< (Fixed a, Fixed b) { return a.raw <  b.raw; }
+constexpr bool operator<=(Fixed a, Fixed b) { return a.raw <= b.raw; }
+constexpr bool operator> (Fixed a, Fixed b) { return a.raw >  b.raw; }
+constexpr bool operator>=(Fixed a, Fixed b) { return a.raw >= b.raw; }
+
+// Math functions for the number types used in templates, float uses the single precision
+// versions. The Fixed square root is done on integers, one result bit per iteration.
+inline float squareRoot(float f) { return sqrtf(f); }
+inline Fixed squareRoot(Fixed f) {
+  if(f.raw <= 0) return Fixed();
+  uint64_t v = (uint64_t)f.raw << 16;
+  uint64_t r = 0, bit = (uint64_t)1 << 62;
+  while(bit > v) bit >>= 2;
+  while(bit) {
+    if(v >= r + bit) {
+      v -= r + bit;
+      r = (r >> 1) + bit;
+    } else {
+      r >>= 1;
+    }
+    bit >>= 2;
+  }
+  return Fixed::fromRaw(r);
+}
+// Angles are only converted a few times per frame, so these go through float
+inline float sine(float f) { return sinf(f); }
+inline Fixed sine(Fixed f) { return Fixed(sinf((float)f)); }
+inline float cosine(float f) { return cosf(f); }
+inline Fixed cosine(Fixed f) { return Fixed(cosf((float)f)); }
+#endif
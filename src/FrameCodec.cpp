@@ -0,0 +1,257 @@
+#include "FrameCodec.h"
+/*----------------------------------------------------------------------------------------------
+ * FRAMECODEC CLASS
+ *----------------------------------------------------------------------------------------------
+ * Decodes straight into the rendering cube, skipped voxels are copied from the displayed
+ * cube. The channel reader keeps track of being halfway a 3 byte pair of channels.
+ */
+namespace {
+struct ChannelReader {
+  const uint8_t* p;
+  bool half;
+  uint16_t read() {
+    uint16_t v;
+    if(!half) {
+      v = (p[0] << 4) | (p[1] >> 4);
+      p += 1;
+    } else {
+      v = ((p[0] & 0x0F) << 8) | p[1];
+      p += 2;
+    }
+    half = !half;
+    return v;
+  }
+  // skip the padding to the next whole byte
+  void align() {
+    if(half) p++;
+    half = false;
+  }
+  Color color() {
+    uint16_t r = read();
+    uint16_t g = read();
+    return Color(r, g, read());
+  }
+};
+// the opposite of the reader, the low nibble of the first channel shares a byte
+struct ChannelWriter {
+  uint8_t* p;
+  bool half;
+  void write(uint16_t v) {
+    if(!half) {
+      p[0] = v >> 4;
+      p[1] = (v & 0x0F) << 4;
+      p += 1;
+    } else {
+      p[0] |= v >> 8;
+      p[1] = v & 0xFF;
+      p += 2;
+    }
+    half = !half;
+  }
+  void align() {
+    if(half) p++;
+    half = false;
+  }
+  void color(Color c) {
+    write(c.R);
+    write(c.G);
+    write(c.B);
+  }
+};
+// bytes used by n packed channels
+inline int packedSize(int n) {
+  return (n*3+1)/2;
+}
+inline bool same(const Voxel& a, const Voxel& b) {
+  return memcmp(&a, &b, sizeof(Voxel)) == 0;
+}
+}
+
+bool FrameCodec::decode(uint8_t type, const uint8_t* data, int length,
+                        const Frame& previous, Frame& frame) {
+  Voxel* out = &frame[0][0][0];
+  const Voxel* prev = &previous[0][0][0];
+  const uint8_t* end = data + length;
+  ChannelReader in = { data, false };
+
+  if(type == KEYFRAME) {
+    if(length < packedSize(voxels*3))
+      return false;
+    for(int i=0;i<voxels;i++)
+      out[i] = in.color();
+    return true;
+  }
+  if(type != DELTA)
+    return false;
+
+  int i = 0;
+  while(in.p < end) {
+    uint8_t run = *in.p++;
+    int n = (run & 0x3F) + 1;
+    if(i + n > voxels)
+      return false;
+    switch(run & 0xC0) {
+    case SKIP:
+      // decoding in place keeps skipped voxels as they are
+      if(out != prev)
+        memcpy(out+i, prev+i, n*sizeof(Voxel));
+      break;
+    case LITERAL:
+      if(end - in.p < packedSize(n*3))
+        return false;
+      for(int j=0;j<n;j++)
+        out[i+j] = in.color();
+      in.align();
+      break;
+    case FILL: {
+      if(end - in.p < packedSize(3))
+        return false;
+      Color c = in.color();
+      in.align();
+      for(int j=0;j<n;j++)
+        out[i+j] = c;
+      break;
+    }
+    default:
+      return false;
+    }
+    i += n;
+  }
+  // voxels after the last run didn't change
+  if(out != prev)
+    memcpy(out+i, prev+i, (voxels-i)*sizeof(Voxel));
+  return true;
+}
+
+/* Runs are chosen the same way as by encode_delta in tools/cubestream.py: unchanged voxels
+ * are skipped, 2 or more equal voxels are filled and everything else is literal. Unchanged
+ * voxels at the end are left out, the decoder keeps them. */
+int FrameCodec::encode(const Frame& frame, const Frame* previous, uint8_t* data,
+                       uint8_t& type) {
+  const Voxel* in = &frame[0][0][0];
+  ChannelWriter out = { data, false };
+  const int keyframeSize = packedSize(voxels*3);
+  if(previous) {
+    const Voxel* prev = &(*previous)[0][0][0];
+    int last = voxels;
+    while(last > 0 && same(in[last-1], prev[last-1]))
+      last--;
+    int i = 0;
+    while(i < last) {
+      int n = 1;
+      if(same(in[i], prev[i])) {
+        while(i+n < last && n < maxRun && same(in[i+n], prev[i+n])) n++;
+        *out.p++ = SKIP | (n-1);
+      } else if(i+1 < last && same(in[i+1], in[i])) {
+        n = 2;
+        while(i+n < last && n < maxRun && same(in[i+n], in[i])) n++;
+        *out.p++ = FILL | (n-1);
+        out.color(in[i]);
+        out.align();
+      } else {
+        while(i+n < last && n < maxRun && !same(in[i+n], prev[i+n]) &&
+              !(i+n+1 < last && same(in[i+n+1], in[i+n]))) n++;
+        *out.p++ = LITERAL | (n-1);
+        for(int j=0;j<n;j++)
+          out.color(in[i+j]);
+        out.align();
+      }
+      i += n;
+    }
+    if(out.p - data < keyframeSize) {
+      type = DELTA;
+      return out.p - data;
+    }
+    out = { data, false };
+  }
+  for(int i=0;i<voxels;i++)
+    out.color(in[i]);
+  type = KEYFRAME;
+  return keyframeSize;
+}
+/*----------------------------------------------------------------------------------------------
+ * FRAMERECEIVER CLASS
+ *----------------------------------------------------------------------------------------------
+ * A state machine for the frame header, so it can start listening halfway a stream and
+ * resynchronizes on the next 'V' 'X' after a bad frame.
+ */
+bool FrameReceiver::receive(Stream& stream) {
+  while(stream.available() > 0) {
+    if(m_state == PAYLOAD) {
+      // read the payload in one go, as far as it has arrived
+      int n = stream.available();
+      if(n > m_length - m_received) n = m_length - m_received;
+      n = stream.readBytes((char*)m_payload + m_received, n);
+      for(int i=0;i<n;i++)
+        m_checksum ^= m_payload[m_received+i];
+      m_received += n;
+      if(m_received == m_length) m_state = CHECKSUM;
+      continue;
+    }
+    uint8_t b = stream.read();
+    switch(m_state) {
+    case SYNC1:
+      if(b == 'V') m_state = SYNC2;
+      break;
+    case SYNC2:
+      m_state = b == 'X' ? TYPE : (b == 'V' ? SYNC2 : SYNC1);
+      break;
+    case TYPE:
+      m_type = b;
+      m_state = LENGTH1;
+      break;
+    case LENGTH1:
+      m_length = b;
+      m_state = LENGTH2;
+      break;
+    case LENGTH2:
+      m_length |= b << 8;
+      m_received = 0;
+      m_checksum = 0;
+      if(m_length > FrameCodec::maxPayload) m_state = SYNC1;
+      else m_state = m_length ? PAYLOAD : CHECKSUM;
+      break;
+    case CHECKSUM:
+      m_state = SYNC1;
+      if(b == m_checksum) return true;
+      break;
+    default:
+      m_state = SYNC1;
+      break;
+    }
+  }
+  return false;
+}
+/*----------------------------------------------------------------------------------------------
+ * FRAMESENDER CLASS
+ *----------------------------------------------------------------------------------------------
+ * The whole message is built in one buffer, so flush only has to copy bytes. A PC that
+ * starts listening halfway needs a keyframe before the deltas make sense.
+ */
+void FrameSender::send(const Frame& frame, bool keyframe) {
+  uint8_t type;
+  const int length = FrameCodec::encode(frame, keyframe || !m_started ? nullptr : &m_previous,
+                                        m_message + header, type);
+  uint8_t checksum = 0;
+  for(int i=0;i<length;i++)
+    checksum ^= m_message[header + i];
+  m_message[0] = 'V';
+  m_message[1] = 'X';
+  m_message[2] = type;
+  m_message[3] = length & 0xFF;
+  m_message[4] = length >> 8;
+  m_message[header + length] = checksum;
+  m_size = header + length + 1;
+  m_sent = 0;
+  m_bytes += m_size;
+  memcpy(m_previous, frame, sizeof(Frame));
+  m_started = true;
+}
+
+bool FrameSender::flush(Print& stream) {
+  int n = stream.availableForWrite();
+  if(n > m_size - m_sent) n = m_size - m_sent;
+  if(n > 0)
+    m_sent += stream.write(m_message + m_sent, n);
+  return ready();
+}
@@ -0,0 +1,87 @@
+#ifndef FRAMECODEC_H
+#define FRAMECODEC_H
+#include <Arduino.h>
+#include "OctadecaTLC5940.h"
+/* Compressed frames for sending complete cube frames to and from a PC.
+ *
+ * A frame on the wire: 'V' 'X' type length(2 bytes, LSB first) payload checksum
+ * The checksum is the XOR of all payload bytes.
+ *
+ * Voxels are numbered in memory order of a Frame (x, then y, then z) and colors are sent
+ * as 12 bit channels R, G, B packed MSB first, 2 channels in 3 bytes.
+ *
+ * KEYFRAME payload: all voxels packed, the last 4 bits are padding.
+ * DELTA payload: runs against the previous frame. Every run starts with one byte, the
+ * upper 2 bits are the kind of run and the lower 6 bits the number of voxels minus 1.
+ *   SKIP    voxels are the same as in the previous frame
+ *   LITERAL the colors of all voxels follow, packed and padded to a whole byte
+ *   FILL    one packed color (5 bytes) follows for all voxels
+ *
+ * PROGRAM payload: bytecode for the voxel VM, the cube keeps it in EEPROM. See VoxelVM.h,
+ * tools/cubeasm.py assembles and sends programs. */
+class FrameCodec {
+public:
+  static const uint8_t KEYFRAME = 'K';
+  static const uint8_t DELTA = 'D';
+  static const uint8_t PROGRAM = 'P';
+  static const uint8_t SKIP = 0x00;
+  static const uint8_t LITERAL = 0x40;
+  static const uint8_t FILL = 0x80;
+  static const int voxels = X_LAYERS*Y_LAYERS*Z_LAYERS;
+  // worst case is a delta of single voxel literals: 1 run byte and 5 color bytes each
+  static const int maxPayload = voxels*6;
+  static const int maxRun = 64;
+public:
+  // decode a payload into frame, previous is the last decoded frame. previous and frame
+  // may be the same frame to decode in place. Returns false when the payload is
+  // malformed, frame is only partly written in that case.
+  static bool decode(uint8_t type, const uint8_t* data, int length,
+                     const Frame& previous, Frame& frame);
+  // encode a frame into data, a delta against previous when that is smaller than a
+  // keyframe. Pass nullptr as previous for a keyframe. Returns the payload length, data
+  // needs room for maxPayload bytes.
+  static int encode(const Frame& frame, const Frame* previous, uint8_t* data, uint8_t& type);
+};
+
+/* Collects frames from a byte stream. Partial frames are kept between calls, so nothing
+ * waits for bytes that haven't arrived yet. */
+class FrameReceiver {
+public:
+  // reads available bytes until a frame is complete, returns true if there is one
+  bool receive(Stream& stream);
+  uint8_t type() const { return m_type; }
+  const uint8_t* payload() const { return m_payload; }
+  int length() const { return m_length; }
+private:
+  enum State { SYNC1, SYNC2, TYPE, LENGTH1, LENGTH2, PAYLOAD, CHECKSUM };
+  State m_state = SYNC1;
+  uint8_t m_type = 0;
+  int m_length = 0;
+  int m_received = 0;
+  uint8_t m_checksum = 0;
+  uint8_t m_payload[FrameCodec::maxPayload];
+};
+
+/* Sends frames to a stream without ever waiting for it. send encodes a frame against the
+ * frame sent before it, flush writes as much of it as the stream has room for. */
+class FrameSender {
+public:
+  // true when the last frame is completely written, only then send takes another one
+  bool ready() const { return m_sent == m_size; }
+  // encodes a frame as a keyframe or against the last frame that was sent
+  void send(const Frame& frame, bool keyframe);
+  // writes what the stream takes without blocking, returns ready()
+  bool flush(Print& stream);
+  // bytes of all frames so far
+  uint32_t bytes() const { return m_bytes; }
+private:
+  // 'V' 'X' type and length before the payload, the checksum after it
+  static const int header = 5;
+  Frame m_previous;
+  bool m_started = false;
+  int m_size = 0;
+  int m_sent = 0;
+  uint32_t m_bytes = 0;
+  uint8_t m_message[header + FrameCodec::maxPayload + 1];
+};
+#endif
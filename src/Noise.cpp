@@ -0,0 +1,202 @@
+#include "Noise.h"
+#include "Util.h"
+/*----------------------------------------------------------------------------------------------
+ * SIMPLEXNOISE CLASS
+ *----------------------------------------------------------------------------------------------
+ * Simplex noise divides space in simplices (tetrahedrons in 3D) instead of cubes, so every
+ * point only gets contributions from 4 (3D) or 5 (4D) corners. Space is skewed to find the
+ * cell, the cell corners are hashed through the permutation table to pick a gradient and
+ * every corner adds (0.6-d^2)^4 * (gradient . distance).
+ *
+ * Everything is done in Q16.16 fixed point. Relative coordinates are smaller than 1.0, so
+ * squaring them after a shift of 2 bits fits in 32 bits. The skew factors are Q0.32 and
+ * are multiplied in 64 bits, that is a single SMULL on the Cortex-M4.
+ *
+ * fill evaluates complete rows along z. The skew offset is carried from voxel to voxel by
+ * an addition and the lattice cell, its origin and the hashes of the first and last corner
+ * are reused until the row leaves the cell.
+ */
+// skew and unskew factors in Q0.32: F3=1/3, G3=1/6, F4=(sqrt(5)-1)/4, G4=(5-sqrt(5))/20
+#define F3 1431655765LL
+#define G3 715827883LL
+#define F4 1327217884LL
+#define G4 593536146LL
+// 0.6 in Q16.16, the squared radius of influence of a corner
+#define R2 39322
+
+static const int8_t grad3[12][3] = {
+  { 1, 1, 0},{-1, 1, 0},{ 1,-1, 0},{-1,-1, 0},
+  { 1, 0, 1},{-1, 0, 1},{ 1, 0,-1},{-1, 0,-1},
+  { 0, 1, 1},{ 0,-1, 1},{ 0, 1,-1},{ 0,-1,-1}};
+
+static const int8_t grad4[32][4] = {
+  { 0, 1, 1, 1},{ 0, 1, 1,-1},{ 0, 1,-1, 1},{ 0, 1,-1,-1},
+  { 0,-1, 1, 1},{ 0,-1, 1,-1},{ 0,-1,-1, 1},{ 0,-1,-1,-1},
+  { 1, 0, 1, 1},{ 1, 0, 1,-1},{ 1, 0,-1, 1},{ 1, 0,-1,-1},
+  {-1, 0, 1, 1},{-1, 0, 1,-1},{-1, 0,-1, 1},{-1, 0,-1,-1},
+  { 1, 1, 0, 1},{ 1, 1, 0,-1},{ 1,-1, 0, 1},{ 1,-1, 0,-1},
+  {-1, 1, 0, 1},{-1, 1, 0,-1},{-1,-1, 0, 1},{-1,-1, 0,-1},
+  { 1, 1, 1, 0},{ 1, 1,-1, 0},{ 1,-1, 1, 0},{ 1,-1,-1, 0},
+  {-1, 1, 1, 0},{-1, 1,-1, 0},{-1,-1, 1, 0},{-1,-1,-1, 0}};
+
+// Lattice cell of the previous evaluation
+struct SimplexNoise::Cell {
+  int32_t i, j, k, l;
+  int32_t x0, y0, z0, w0;
+  uint8_t h0, h4;
+};
+
+// Square of a Q16.16 value smaller than 4.0
+static inline int32_t square(int32_t v) {
+  v >>= 2;
+  return (v*v) >> 12;
+}
+// Contribution of one corner, t is 0.6 minus the squared distance to the corner
+static inline int32_t falloff(int32_t t, int32_t dot) {
+  if(t <= 0) return 0;
+  t = (t*t) >> 16;
+  t = (t*t) >> 16;
+  return (t*dot) >> 16;
+}
+static inline int32_t corner3(int g, int32_t x, int32_t y, int32_t z) {
+  const int8_t* gr = grad3[g];
+  return falloff(R2 - square(x) - square(y) - square(z), gr[0]*x + gr[1]*y + gr[2]*z);
+}
+static inline int32_t corner4(int g, int32_t x, int32_t y, int32_t z, int32_t w) {
+  const int8_t* gr = grad4[g];
+  return falloff(R2 - square(x) - square(y) - square(z) - square(w),
+    gr[0]*x + gr[1]*y + gr[2]*z + gr[3]*w);
+}
+static inline int32_t clamp(int32_t n) {
+  return n > 65536 ? 65536 : (n < -65536 ? -65536 : n);
+}
+
+SimplexNoise::SimplexNoise(uint32_t seed_) {
+  seed(seed_);
+}
+void SimplexNoise::seed(uint32_t seed) {
+  NoiseGenerator random(seed);
+  for(int i=0;i<256;i++)
+    m_perm[i] = i;
+  for(int i=255;i>0;i--) {
+    int j = random.nextInt(i+1);
+    uint8_t t = m_perm[i];
+    m_perm[i] = m_perm[j];
+    m_perm[j] = t;
+  }
+  for(int i=0;i<512;i++) {
+    m_perm[i] = m_perm[i & 255];
+    m_permMod12[i] = m_perm[i] % 12;
+  }
+}
+
+int32_t SimplexNoise::noise(int32_t x, int32_t y, int32_t z) const {
+  // skew the input space to determine which cell we're in
+  int32_t s = ((int64_t)(x+y+z) * F3) >> 32;
+  int32_t i = (x+s) >> 16;
+  int32_t j = (y+s) >> 16;
+  int32_t k = (z+s) >> 16;
+  // unskew the cell origin back to (x,y,z) space and get the distances from the origin
+  int32_t t = ((int64_t)(i+j+k) * G3) >> 16;
+  int32_t x0 = x - i*65536 + t;
+  int32_t y0 = y - j*65536 + t;
+  int32_t z0 = z - k*65536 + t;
+  // determine which of the six tetrahedrons we're in
+  int i1, j1, k1, i2, j2, k2;
+  if(x0 >= y0) {
+    if(y0 >= z0)      { i1=1; j1=0; k1=0; i2=1; j2=1; k2=0; }
+    else if(x0 >= z0) { i1=1; j1=0; k1=0; i2=1; j2=0; k2=1; }
+    else              { i1=0; j1=0; k1=1; i2=1; j2=0; k2=1; }
+  } else {
+    if(y0 < z0)       { i1=0; j1=0; k1=1; i2=0; j2=1; k2=1; }
+    else if(x0 < z0)  { i1=0; j1=1; k1=0; i2=0; j2=1; k2=1; }
+    else              { i1=0; j1=1; k1=0; i2=1; j2=1; k2=0; }
+  }
+  const int32_t g1 = G3 >> 16, g2 = 2*g1, g3 = 32768;
+  int ii = i & 255, jj = j & 255, kk = k & 255;
+  int32_t n =
+    corner3(m_permMod12[ii+m_perm[jj+m_perm[kk]]], x0, y0, z0) +
+    corner3(m_permMod12[ii+i1+m_perm[jj+j1+m_perm[kk+k1]]],
+      x0-i1*65536+g1, y0-j1*65536+g1, z0-k1*65536+g1) +
+    corner3(m_permMod12[ii+i2+m_perm[jj+j2+m_perm[kk+k2]]],
+      x0-i2*65536+g2, y0-j2*65536+g2, z0-k2*65536+g2) +
+    corner3(m_permMod12[ii+1+m_perm[jj+1+m_perm[kk+1]]],
+      x0-65536+g3, y0-65536+g3, z0-65536+g3);
+  // scale the result to stay just inside [-1,1]
+  return clamp(32*n);
+}
+
+int32_t SimplexNoise::noise(int32_t x, int32_t y, int32_t z, int32_t w) const {
+  Cell cell;
+  cell.i = INT32_MIN;
+  int32_t s = ((int64_t)(x+y+z+w) * F4) >> 32;
+  return evaluate(x, y, z, w, s, cell);
+}
+
+int32_t SimplexNoise::evaluate(int32_t x, int32_t y, int32_t z, int32_t w, int32_t s,
+                               Cell& cell) const {
+  int32_t i = (x+s) >> 16;
+  int32_t j = (y+s) >> 16;
+  int32_t k = (z+s) >> 16;
+  int32_t l = (w+s) >> 16;
+  if(i != cell.i || j != cell.j || k != cell.k || l != cell.l) {
+    cell.i = i; cell.j = j; cell.k = k; cell.l = l;
+    int32_t t = ((int64_t)(i+j+k+l) * G4) >> 16;
+    cell.x0 = i*65536 - t;
+    cell.y0 = j*65536 - t;
+    cell.z0 = k*65536 - t;
+    cell.w0 = l*65536 - t;
+    int ii = i & 255, jj = j & 255, kk = k & 255, ll = l & 255;
+    cell.h0 = m_perm[ii+m_perm[jj+m_perm[kk+m_perm[ll]]]] & 31;
+    cell.h4 = m_perm[ii+1+m_perm[jj+1+m_perm[kk+1+m_perm[ll+1]]]] & 31;
+  }
+  int32_t x0 = x - cell.x0;
+  int32_t y0 = y - cell.y0;
+  int32_t z0 = z - cell.z0;
+  int32_t w0 = w - cell.w0;
+  // rank the coordinates to find which of the 24 simplices we're in
+  int rx = 0, ry = 0, rz = 0, rw = 0;
+  if(x0 > y0) rx++; else ry++;
+  if(x0 > z0) rx++; else rz++;
+  if(x0 > w0) rx++; else rw++;
+  if(y0 > z0) ry++; else rz++;
+  if(y0 > w0) ry++; else rw++;
+  if(z0 > w0) rz++; else rw++;
+  int i1 = rx>=3, j1 = ry>=3, k1 = rz>=3, l1 = rw>=3;
+  int i2 = rx>=2, j2 = ry>=2, k2 = rz>=2, l2 = rw>=2;
+  int i3 = rx>=1, j3 = ry>=1, k3 = rz>=1, l3 = rw>=1;
+  const int32_t g1 = G4 >> 16, g2 = 2*g1, g3 = 3*g1, g4 = 4*g1;
+  int ii = i & 255, jj = j & 255, kk = k & 255, ll = l & 255;
+  int32_t n =
+    corner4(cell.h0, x0, y0, z0, w0) +
+    corner4(m_perm[ii+i1+m_perm[jj+j1+m_perm[kk+k1+m_perm[ll+l1]]]] & 31,
+      x0-i1*65536+g1, y0-j1*65536+g1, z0-k1*65536+g1, w0-l1*65536+g1) +
+    corner4(m_perm[ii+i2+m_perm[jj+j2+m_perm[kk+k2+m_perm[ll+l2]]]] & 31,
+      x0-i2*65536+g2, y0-j2*65536+g2, z0-k2*65536+g2, w0-l2*65536+g2) +
+    corner4(m_perm[ii+i3+m_perm[jj+j3+m_perm[kk+k3+m_perm[ll+l3]]]] & 31,
+      x0-i3*65536+g3, y0-j3*65536+g3, z0-k3*65536+g3, w0-l3*65536+g3) +
+    corner4(cell.h4, x0-65536+g4, y0-65536+g4, z0-65536+g4, w0-65536+g4);
+  return clamp(27*n);
+}
+
+void SimplexNoise::fill(int16_t* values, int width, int height, int depth,
+                        int32_t scale, const int32_t offset[3], int32_t w) const {
+  Cell cell;
+  cell.i = INT32_MIN;
+  // skew offset increment for one step along z, with 48 fraction bits
+  const int64_t ds = (int64_t)scale * F4;
+  for(int x=0;x<width;x++) {
+    int32_t X = offset[0] + x*scale;
+    for(int y=0;y<height;y++) {
+      int32_t Y = offset[1] + y*scale;
+      int32_t Z = offset[2];
+      int64_t s = (int64_t)(X+Y+Z+w) * F4;
+      for(int z=0;z<depth;z++) {
+        int32_t n = evaluate(X, Y, Z, w, s >> 32, cell);
+        *values++ = n >= 65536 ? 32767 : n >> 1;
+        Z += scale;
+        s += ds;
+      }
+    }
+  }
+}
@@ -0,0 +1,29 @@
+#ifndef NOISE_H
+#define NOISE_H
+#include <stdint.h>
+
+/* Simplex noise (Perlin 2001, as described by Gustavson) in Q16.16 fixed point, so it
+ * runs on integer hardware only. All coordinates are Q16.16 (65536 = 1.0), the noise
+ * values are Q16.16 and lie between -1.0 and 1.0. */
+class SimplexNoise {
+public:
+  SimplexNoise(uint32_t seed = 0);
+  // shuffle the permutation table to get a different noise field
+  void seed(uint32_t seed);
+  // 3D noise value at (x,y,z)
+  int32_t noise(int32_t x, int32_t y, int32_t z) const;
+  // 4D noise value at (x,y,z,w), use w as time to get an evolving 3D field
+  int32_t noise(int32_t x, int32_t y, int32_t z, int32_t w) const;
+  // fill values[x][y][z] with the noise at (x,y,z)*scale+offset and time w, the values
+  // are stored as Q1.15 (32767 = 1.0)
+  void fill(int16_t* values, int width, int height, int depth,
+            int32_t scale, const int32_t offset[3], int32_t w) const;
+private:
+  struct Cell;
+  int32_t evaluate(int32_t x, int32_t y, int32_t z, int32_t w, int32_t s, Cell& cell) const;
+private:
+  // permutation table repeated twice, so indexes don't need to wrap
+  uint8_t m_perm[512];
+  uint8_t m_permMod12[512];
+};
+#endif
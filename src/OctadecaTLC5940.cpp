@@ -1,15 +1,24 @@
 #include "OctadecaTLC5940.h"
 /* Interrupt Service Routine for FTM1 this is called whenever the BLANK and XLAT combo
  * needs to be pulsed. So at this time we turn off all outputs, and previous clocked
- * in data gets latched in. We must now clock in new data to be latched with the next
- * interrupt. So make sure this interrupt finishes before the next triggers. */
+ * in data gets latched in. This interrupt has a high priority and only switches the
+ * pins, it then hands over to the software interrupt.
+ *
+ * The software interrupt runs at a low priority, so USB and the other interrupts can
+ * come first. It clocks in the new data to be latched with the next FTM1 interrupt, so
+ * make sure it finishes before the next triggers. Libraries that also use software_isr,
+ * like the Audio library, can't be used next to this one. */
 OctadecaTLC5940* OctadecaTLC5940::me;
 void ftm1_isr(void) {
   OctadecaTLC5940::me->multiplex();
 }
+void software_isr(void) {
+  OctadecaTLC5940::me->prepareLayer();
+}
 // Initialize all TLC, start the timers and set the static me to enable multiplexing.
 OctadecaTLC5940::OctadecaTLC5940() {
   me=this;
+  resetStats();
 }
 /* VPRG=GND and DCPRG=VCC in my design, this sets the operating mode in GSPWM mode using
  * the DC-Register, thus never using the EEPROM values. The content of the DC-Register
@@ -35,20 +44,19 @@ void OctadecaTLC5940::begin() {
   delayMicroseconds(1);
   pinMode(XLAT, OUTPUT);
   pinMode(GSCLK, OUTPUT);
-  pinMode(SIN, OUTPUT);
-  pinMode(SCLK, OUTPUT);
   digitalWriteFast(XLAT, LOW);
   digitalWriteFast(GSCLK, LOW);
-  digitalWriteFast(SIN, LOW);
-  digitalWriteFast(SCLK, LOW);
+  for(int bus = 0; bus < SPI_BUSES; bus++) {
+    pinMode(m_sinPin[bus], OUTPUT);
+    pinMode(m_sclkPin[bus], OUTPUT);
+    digitalWriteFast(m_sinPin[bus], LOW);
+    digitalWriteFast(m_sclkPin[bus], LOW);
+  }
   delayMicroseconds(1);
   
   // Overflow the GS Register and latch this to reset DC-Register and GS-Register.
-  for(int i = 0; i < CHNBITS + 1; i++) {
-    digitalWriteFast(SCLK, HIGH);
-    delayMicroseconds(1);
-    digitalWriteFast(SCLK, LOW);
-    delayMicroseconds(1);
+  for(int i = 0; i < BUSBITS + 1; i++) {
+    clockChains();
   }
   digitalWriteFast(XLAT, HIGH);
   delayMicroseconds(1);
@@ -56,11 +64,8 @@ void OctadecaTLC5940::begin() {
   delayMicroseconds(1);
   
   // Set All outputs off for the first BLANK, XLAT interrupt
-  for(int i = 0; i < CHNBITS; i++) {
-    digitalWriteFast(SCLK, HIGH);
-    delayMicroseconds(1);
-    digitalWriteFast(SCLK, LOW);
-    delayMicroseconds(1);
+  for(int i = 0; i < BUSBITS; i++) {
+    clockChains();
   }
 
   /* System Clock Gating Control Register 4
@@ -128,17 +133,45 @@ void OctadecaTLC5940::begin() {
   FTM1_SC = FTM_SC_CLKS(1)|FTM_SC_CPWMS|FTM_SC_TOIE|FTM_SC_PS((int)(log(FTMDIV)/log(2)));
   // MCGEN (bit 0) Modulator and Carrier Generator Enabled
   CMT_MSC = 0x01;
+  // Cycle counter for the interrupt timings
+  ARM_DEMCR |= ARM_DEMCR_TRCENA;
+  ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+  // Latch above USB (112), prepare the layer below it
+  NVIC_SET_PRIORITY(IRQ_FTM1, 16);
+  NVIC_SET_PRIORITY(IRQ_SOFTWARE, 208);
+  NVIC_ENABLE_IRQ(IRQ_SOFTWARE);
   // Set FMT1 Overflow interrupt
   NVIC_ENABLE_IRQ(IRQ_FTM1);
 }
 
+// Clocks one bit into all chains at the same time
+void OctadecaTLC5940::clockChains() {
+  for(int bus = 0; bus < SPI_BUSES; bus++)
+    digitalWriteFast(m_sclkPin[bus], HIGH);
+  delayMicroseconds(1);
+  for(int bus = 0; bus < SPI_BUSES; bus++)
+    digitalWriteFast(m_sclkPin[bus], LOW);
+  delayMicroseconds(1);
+}
+
 /* Sets the next frame ready flag when the display switches from top layer to bottom
  * layer the display and rendering buffers get switched and an empty rendering cube is
  * prepared for a new animation frame. The nextFrameReady is set to false and the
  * animation routines can continue rendering on the empty cube. */
 void OctadecaTLC5940::update() {
   m_nextFrameReady = true;
-  while(m_nextFrameReady);
+  while(m_nextFrameReady) {
+    if(m_idle)
+      m_idle();
+  }
+}
+
+void OctadecaTLC5940::setIdle(void (*idle)()) {
+  m_idle = idle;
+}
+
+uint32_t OctadecaTLC5940::frames() {
+  return m_frames;
 }
 
 /* Sets a voxel in the rendering cube so there will be no visual anomalies. */
@@ -146,6 +179,61 @@ void OctadecaTLC5940::setVoxel(int x, int y, int z, Color c) {
   m_rgbCube[m_renderingCube][x][y][z] = c;
 }
 
+/* The weights are set before the frame, so the interrupt never sees a frame without them.
+ * After clearing it, the frame may be written again: the compiler may not move those writes
+ * in front of the clear. */
+void OctadecaTLC5940::setOverlay(const Frame* overlay, const uint8_t* weights) {
+  if(overlay) {
+    m_overlayWeights = weights;
+    m_overlay = overlay;
+  } else {
+    m_overlay = nullptr;
+    __asm__ volatile("" ::: "memory");
+  }
+}
+
+/* The budget is kept as a sum of channel values, so the packer only needs to add */
+void OctadecaTLC5940::setLayerBudget(float fraction) {
+  if (fraction <= 0 || fraction >= 1) {
+    m_layerBudget = 0;
+  } else {
+    m_layerBudget = fraction * (X_LAYERS*Z_LAYERS*3*4095UL);
+  }
+}
+
+float OctadecaTLC5940::layerPeak(int y) {
+  return m_layerPeak[y] / (float)(X_LAYERS*Z_LAYERS*3*4095UL);
+}
+
+uint32_t OctadecaTLC5940::limitedScans() {
+  return m_limitedScans;
+}
+
+uint32_t OctadecaTLC5940::latchCycles() {
+  return m_latchCycles;
+}
+
+uint32_t OctadecaTLC5940::prepareCycles() {
+  return m_prepareCycles;
+}
+
+uint32_t OctadecaTLC5940::latchJitter() {
+  if (m_maxLatchPeriod < m_minLatchPeriod)
+    return 0;
+  return m_maxLatchPeriod - m_minLatchPeriod;
+}
+
+void OctadecaTLC5940::resetStats() {
+  for (int y = 0; y < Y_LAYERS; y++)
+    m_layerPeak[y] = 0;
+  m_limitedScans = 0;
+  m_latchCycles = 0;
+  m_prepareCycles = 0;
+  m_lastLatch = 0;
+  m_minLatchPeriod = UINT32_MAX;
+  m_maxLatchPeriod = 0;
+}
+
 /* Gets a voxel from the displayed cube, so animations can use the current display */
 Color OctadecaTLC5940::getDisplayedVoxel(int x, int y, int z) {
   return m_rgbCube[m_displayedCube][x][y][z];
@@ -156,9 +244,20 @@ Color OctadecaTLC5940::getRenderingVoxel(int x, int y, int z) {
   return m_rgbCube[m_renderingCube][x][y][z];
 }
 
+/* Gets the entire rendering cube */
+Frame& OctadecaTLC5940::getRenderingCube() {
+  return m_rgbCube[m_renderingCube];
+}
+
+/* Gets the entire displayed cube */
+const Frame& OctadecaTLC5940::getDisplayedCube() {
+  return m_rgbCube[m_displayedCube];
+}
+
 // Multiplex only uses digitalWriteFast, this allows the fastest possible timing on
-// switching pins. Calculations for next cycle are done in advance after this.
+// switching pins. The next layer is prepared by the software interrupt after this.
 void OctadecaTLC5940::multiplex() {
+  const uint32_t start = ARM_DWT_CYCCNT;
   // Turn off all outputs before doing anything else
   digitalWriteFast(BLANK, HIGH);
   // Set XLAT to signal new data is available
@@ -184,7 +283,23 @@ void OctadecaTLC5940::multiplex() {
   m_currentLayer = m_layerPin[m_LayerOffset];
   m_nextLayer = m_layerPin[(m_LayerOffset+1) % Y_LAYERS];
 
-  // Prepare the NEXT layer, this will be send out NEXT multiplex refresh cycle.
+  NVIC_SET_PENDING(IRQ_SOFTWARE);
+
+  // The first latch has no period yet
+  if (m_lastLatch) {
+    const uint32_t period = start - m_lastLatch;
+    if (period < m_minLatchPeriod) m_minLatchPeriod = period;
+    if (period > m_maxLatchPeriod) m_maxLatchPeriod = period;
+  }
+  m_lastLatch = start;
+  const uint32_t cycles = ARM_DWT_CYCCNT - start;
+  if (cycles > m_latchCycles)
+    m_latchCycles = cycles;
+}
+
+// Prepares the NEXT layer, this will be send out NEXT multiplex refresh cycle.
+void OctadecaTLC5940::prepareLayer() {
+  const uint32_t start = ARM_DWT_CYCCNT;
   if(m_LayerOffset==Y_LAYERS-1) {
     // If the next animation frame is ready, swap the rendering and displayed cube
     if(m_nextFrameReady) {
@@ -194,6 +309,7 @@ void OctadecaTLC5940::multiplex() {
 	  memset(m_rgbCube[m_renderingCube], 0, sizeof(m_rgbCube[0]));
 	  // Reset the nextFrameReady flag until a next frame is ready.
       m_nextFrameReady = false;
+      m_frames++;
     }
     setChannelBuffer(0);
   } else {
@@ -201,14 +317,59 @@ void OctadecaTLC5940::multiplex() {
   }
   // Send out the color buffer, using DMA, so this takes no processor time.
   sendChannelBuffer();
+  const uint32_t cycles = ARM_DWT_CYCCNT - start;
+  if (cycles > m_prepareCycles)
+    m_prepareCycles = cycles;
 }
 
-// Prepares the color buffer to be send to the TLC's
+/* Prepares the color buffer to be send to the TLC's. The layer is blended and its channel
+ * values are summed first, the sum decides the scale of the layer before anything is
+ * packed. A scale left from the previous scan would be wrong for every scan that shows
+ * another frame or other overlay weights, a layer could go over its budget for a whole
+ * frame and a dimmer one would be scaled down for nothing. */
 void OctadecaTLC5940::setChannelBuffer(int y) {
   uint16_t *chn;
+  const Frame* overlay = m_overlay;
+  const uint8_t* weights = m_overlayWeights;
+  Color layer[X_LAYERS][Z_LAYERS];
+  uint32_t load = 0;
+  if (y == 0)
+    m_ditherScan++;
   for (int x = 0; x < X_LAYERS; x++) {
     for (int z = 0; z < Z_LAYERS; z++) {
+      // 8 bit voxels are expanded to 12 bits here
       Color c = m_rgbCube[m_displayedCube][x][y][z];
+      if (overlay) {
+        // weight 255 becomes 256, so the overlay can replace the voxel completely
+        uint32_t w = weights[(x*Y_LAYERS + y)*Z_LAYERS + z];
+        w += w >> 7;
+        Color o = (*overlay)[x][y][z];
+        c.R = (c.R*(256-w) + o.R*w) >> 8;
+        c.G = (c.G*(256-w) + o.G*w) >> 8;
+        c.B = (c.B*(256-w) + o.B*w) >> 8;
+      }
+      load += c.R + c.G + c.B;
+      layer[x][z] = c;
+    }
+  }
+  // what the layer asks for is kept as its load
+  const uint32_t budget = m_layerBudget;
+  const uint32_t scale = budget && load > budget ? (budget << 8) / load : 256;
+  for (int x = 0; x < X_LAYERS; x++) {
+    for (int z = 0; z < Z_LAYERS; z++) {
+      Color c = layer[x][z];
+      if (scale < 256) {
+        c.R = (c.R*scale) >> 8;
+        c.G = (c.G*scale) >> 8;
+        c.B = (c.B*scale) >> 8;
+      }
+#if GSSHIFT > 0
+      // down to the steps the TLC's count in a cycle of GSCNT pulses
+      const uint32_t t = ditherThreshold(x, z);
+      c.R = (c.R + t) >> GSSHIFT;
+      c.G = (c.G + t) >> GSSHIFT;
+      c.B = (c.B + t) >> GSSHIFT;
+#endif
       // Flip axis of the cube, otherwise (0,0,0) would be at the back of the cube
       chn = m_ledChannel[Z_LAYERS-1-z][x];
       setChannel(*chn++, c.B);
@@ -216,11 +377,33 @@ void OctadecaTLC5940::setChannelBuffer(int y) {
       setChannel(*chn,   c.R);
     }
   }
+  if (scale < 256)
+    m_limitedScans = m_limitedScans + 1;
+  if (load > m_layerPeak[y])
+    m_layerPeak[y] = load;
+}
+
+/* Ordered dither over time. A voxel adds the thresholds 0 to 2^GSSHIFT-1 before shifting,
+ * one per scan, so the values it shows add up to its 12 bit value over those scans. The
+ * thresholds come in bit reversed order to spread the brighter scans out, and neighbouring
+ * voxels start at another point of the order so they don't flicker together. */
+namespace {
+const uint8_t ditherOrder[16] = {0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15};
+}
+
+uint32_t OctadecaTLC5940::ditherThreshold(int x, int z) {
+#if defined(TEMPORAL_DITHER) && GSSHIFT > 0
+  return ditherOrder[(m_ditherScan + x + 2*z) & ((1 << GSSHIFT) - 1)] >> (4 - GSSHIFT);
+#else
+  return 0;
+#endif
 }
 
-// Find the right bytes in the channelBuffer and set the right bits to include the color
+// Find the right bytes in the channelBuffer and set the right bits to include the color.
+// The last channel of a chain is sent first.
 void OctadecaTLC5940::setChannel(uint16_t channel, uint16_t color) {
-  uint8_t *index12p = m_channelBuffer + (((CHANNELS - channel - 1) * 3) >> 1);
+  uint8_t *buffer = m_channelBuffer[channel / BUSCHANNELS];
+  uint8_t *index12p = buffer + (((BUSCHANNELS - channel % BUSCHANNELS - 1) * 3) >> 1);
   if (channel & 0x01) {
     *(index12p++) = color >> 4;
     *index12p = ((uint8_t)(color << 4)) | (*index12p & 0xF);
@@ -230,23 +413,118 @@ void OctadecaTLC5940::setChannel(uint16_t channel, uint16_t color) {
   }
 }
 
-/* Sends the channel buffer for the next layer to be displayed */
+/* The SPI buses with their registers and the DMA request of their transmit FIFO */
+namespace {
+struct SpiBus {
+  SPIClass& spi;
+  volatile uint32_t& status;
+  volatile uint32_t& requests;
+  volatile uint32_t& push;
+  uint8_t dmaSource;
+};
+SpiBus spiBus[3] = {
+  { SPI,  SPI0_SR, SPI0_RSER, SPI0_PUSHR, DMAMUX_SOURCE_SPI0_TX },
+  { SPI1, SPI1_SR, SPI1_RSER, SPI1_PUSHR, DMAMUX_SOURCE_SPI1 },
+  { SPI2, SPI2_SR, SPI2_RSER, SPI2_PUSHR, DMAMUX_SOURCE_SPI2 }};
+}
+
+/* Sends the channel buffers for the next layer to be displayed, every bus has its own DMA
+ * channel so the chains are clocked in at the same time */
 void OctadecaTLC5940::sendChannelBuffer() {
-  SPI.begin();
+  for(int bus = 0; bus < SPI_BUSES; bus++)
+    sendChannelBuffer(bus);
+}
+
+void OctadecaTLC5940::sendChannelBuffer(int bus) {
+  SpiBus& b = spiBus[bus];
+  b.spi.begin();
   // Setup SPI for DMA transfer
-  SPI0_SR = 0xFF0F0000;
-  SPI0_RSER = 0x00;
+  b.status = 0xFF0F0000;
+  b.requests = 0x00;
   // Make sure SPI triggers a DMA transfer after each transmit
-  SPI0_RSER = SPI_RSER_TFFF_RE | SPI_RSER_TFFF_DIRS;
-  SPI.beginTransaction(m_spiSettings);
-  m_dmaChannel.sourceBuffer(m_channelBuffer, CHNBYTES);
+  b.requests = SPI_RSER_TFFF_RE | SPI_RSER_TFFF_DIRS;
+  b.spi.beginTransaction(m_spiSettings);
+  m_dmaChannel[bus].sourceBuffer(m_channelBuffer[bus], BUSBYTES);
   // Move data into the SPI FIFO register
-  m_dmaChannel.destination((volatile uint8_t&)SPI0_PUSHR);
+  m_dmaChannel[bus].destination((volatile uint8_t&)b.push);
   // Only transfer data once the previous byte has been transmitted
   // This is to ensure all bytes are sent.
-  m_dmaChannel.triggerAtHardwareEvent(DMAMUX_SOURCE_SPI0_TX);
-  // Stop after transmitting all 256 bytes
-  m_dmaChannel.disableOnCompletion();
-  m_dmaChannel.enable();
-  SPI.endTransaction();
+  m_dmaChannel[bus].triggerAtHardwareEvent(b.dmaSource);
+  // Stop after transmitting all bytes of this chain
+  m_dmaChannel[bus].disableOnCompletion();
+  m_dmaChannel[bus].enable();
+  b.spi.endTransaction();
+}
+
+/* Measures the packer on a random frame, the same kind of frame test/test_packer checks
+ * its bits with */
+int OctadecaTLC5940::check(Print& log) {
+  int errors = checkChannelMap(log);
+  Frame& frame = m_rgbCube[m_displayedCube];
+  Voxel* v = &frame[0][0][0];
+  for(int i = 0; i < X_LAYERS*Y_LAYERS*Z_LAYERS; i++) {
+    Color c;
+    c.random();
+    v[i] = c;
+  }
+  uint32_t cycles = packCycles();
+  uint32_t start;
+  log.printf("packer: %lu cycles per layer, %d wrong channels\n", (unsigned long)cycles, errors);
+  // and with an overlay, as used by transitions
+  uint8_t weights[X_LAYERS*Y_LAYERS*Z_LAYERS] = {};
+  setOverlay(&frame, weights);
+  start = ARM_DWT_CYCCNT;
+  for(int y = 0; y < Y_LAYERS; y++)
+    setChannelBuffer(y);
+  cycles = (ARM_DWT_CYCCNT - start)/Y_LAYERS;
+  setOverlay(nullptr, nullptr);
+  log.printf("packer with overlay: %lu cycles per layer\n", (unsigned long)cycles);
+  // and with every layer over its budget
+  uint32_t budget = m_layerBudget;
+  m_layerBudget = X_LAYERS*Z_LAYERS*3*4095UL/4;
+  start = ARM_DWT_CYCCNT;
+  for(int y = 0; y < Y_LAYERS; y++)
+    setChannelBuffer(y);
+  cycles = (ARM_DWT_CYCCNT - start)/Y_LAYERS;
+  m_layerBudget = budget;
+  resetStats();
+  log.printf("packer with budget: %lu cycles per layer\n", (unsigned long)cycles);
+  memset(frame, 0, sizeof(Frame));
+  return errors;
+}
+
+// Cycles for packing one layer, averaged over all layers
+uint32_t OctadecaTLC5940::packCycles() {
+  ARM_DEMCR |= ARM_DEMCR_TRCENA;
+  ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+  const uint32_t start = ARM_DWT_CYCCNT;
+  for(int y = 0; y < Y_LAYERS; y++)
+    setChannelBuffer(y);
+  return (ARM_DWT_CYCCNT - start)/Y_LAYERS;
+}
+
+// Every color of every led needs a channel of its own
+int OctadecaTLC5940::checkChannelMap(Print& log) {
+  uint8_t used[CHANNELS] = {};
+  int errors = 0;
+  for(int x = 0; x < X_LAYERS; x++)
+  for(int z = 0; z < Z_LAYERS; z++)
+  for(int c = 0; c < 3; c++) {
+    uint16_t channel = m_ledChannel[x][z][c];
+    if(channel >= CHANNELS || used[channel]++) {
+      log.printf("led %d,%d color %d: channel %d is out of range or used twice\n",
+                 x, z, c, channel);
+      errors++;
+    }
+  }
+  return errors;
+}
+
+const uint8_t* OctadecaTLC5940::channelBuffer(int bus) {
+  return m_channelBuffer[bus];
+}
+
+// the table is laid out from the back of the cube, see setChannelBuffer
+const uint16_t* OctadecaTLC5940::ledChannels(int x, int z) {
+  return m_ledChannel[Z_LAYERS-1-z][x];
 }
@@ -36,7 +36,23 @@
 #define CHNBYTES    CHNBITS / 8
 #define SPISPEED    5000000
 
-// Definition of the hardware layers
+/* The TLC's can be split in up to 3 chains of equal length, each on its own SPI bus. All
+ * chains are sent at the same time by DMA, so a layer takes 1/SPI_BUSES of the time. The
+ * first chain on SPI0 gets the lowest channels, then SPI1 and SPI2.
+ *
+ * At 5MHz a layer of 3*N*N channels has to be sent within one GSCLK cycle (1.09ms), so
+ * 1 bus fits up to 12x12 layers, 2 buses 17x17 and 3 buses 21x21. A 16x16x16 cube then
+ * refreshes at 915/16 = 57Hz. */
+#ifndef SPI_BUSES
+#define SPI_BUSES   1
+#endif
+#define BUSCHANNELS (CHANNELS / SPI_BUSES)
+#define BUSBITS     (BUSCHANNELS * 12)
+#define BUSBYTES    (BUSBITS / 8)
+
+/* Definition of the hardware layers. This is the only place the size of the cube is set,
+ * Cube and the animations use it as a constant. Another size also needs its own
+ * m_ledChannel and m_layerPin tables. */
 #define X_LAYERS	9
 #define Y_LAYERS	9
 #define Z_LAYERS	9
@@ -55,6 +71,11 @@
  * documentation on how to do that. */
 #define SIN     11
 #define SCLK    13
+// Data and clock of the second and third chain when SPI_BUSES is more than 1
+#define SIN1    0
+#define SCLK1   32
+#define SIN2    44
+#define SCLK2   46
 
 /* CORE_PIN3_CONFIG configures Pin Control Register PTA12.
  * Pin Mux Control, MUX (bit 10-8) -> Alternative 1 PTA12
@@ -93,8 +114,27 @@
 #define FTMDIV  4
 // Time of one GSCLK period
 #define PERIOD  (CGH1+CGL1)/2
-// Amount of GSCLK pulses for a complete cycle
+/* Amount of GSCLK pulses for a complete cycle. Fewer pulses refresh the layers faster,
+ * 1024 runs them at 3.7kHz, but leaves fewer grayscale steps: the 12 bit channels are
+ * shifted down by GSSHIFT bits. Defining TEMPORAL_DITHER spreads the lost bits over
+ * 2^GSSHIFT scans of a layer, so the average of those scans still has 12 bits. A layer
+ * also has to be sent in the shorter cycle, see SPI_BUSES. */
+#ifndef GSCNT
 #define GSCNT   4096
+#endif
+#if GSCNT == 4096
+#define GSSHIFT 0
+#elif GSCNT == 2048
+#define GSSHIFT 1
+#elif GSCNT == 1024
+#define GSSHIFT 2
+#elif GSCNT == 512
+#define GSSHIFT 3
+#elif GSCNT == 256
+#define GSSHIFT 4
+#else
+#error "GSCNT must be a power of 2 from 256 to 4096"
+#endif
 /* FTMOD takes the CGH1 and CGL1 and amount of GSCNT needed to calculate
  * the MODULO of the FTM timer, divide by prescaler. */
 #define FTMOD   (PERIOD*GSCNT)/FTMDIV
@@ -109,10 +149,14 @@
  * Animations use the elapsed time to adjust animation speed accordingly */
 #define REFRESH_RATE  (F_BUS/(GSCNT*(CGH1+CGL1))/Y_LAYERS)
 
+/* One complete frame of the cube, with FRAMEBUFFER_8BIT defined voxels take 3 bytes
+ * instead of 6 (see Voxel in Color.h) */
+typedef Voxel Frame[X_LAYERS][Y_LAYERS][Z_LAYERS];
+
 class OctadecaTLC5940 {
 private:
   /* The memory of the entire cube, double buffered */
-  Color m_rgbCube[2][X_LAYERS][Y_LAYERS][Z_LAYERS];
+  Frame m_rgbCube[2];
   /* One buffer is currently being used for display and the other buffer is the canvas
    * for rendering. These buffers will swap places after a call to update, this is when
    * a new frame is ready to be displayed and right before the bottom layer is about to
@@ -123,6 +167,19 @@ private:
   /* When the animation routines have a frame ready update is called and a buffer switch
    * will be done right before the bottom layer data is being send in */
   volatile bool m_nextFrameReady = false;
+  /* Number of frames the display took, counts up when the cubes are swapped */
+  volatile uint32_t m_frames = 0;
+  /* Frame and per voxel weights blended over the displayed cube, see setOverlay */
+  const Frame* volatile m_overlay = nullptr;
+  const uint8_t* volatile m_overlayWeights = nullptr;
+  /* Current budget of one layer as the sum of its channel values, 0 when there is none.
+   * A layer that asks for more is scaled down to it on the scan that shows it. */
+  volatile uint32_t m_layerBudget = 0;
+  /* Highest sum every layer asked for and the number of scans that were scaled down */
+  volatile uint32_t m_layerPeak[Y_LAYERS];
+  volatile uint32_t m_limitedScans = 0;
+  /* Counts the scans of the cube, it picks the dither threshold of every voxel */
+  uint32_t m_ditherScan = 0;
   /* Hardware LED address mapping for getting the right LED offset see PCB schematic.
    * The table has the following layout: LED0B, LED0G, LED0R, LED1B, ..., LED81G, LED81R
    * There are some holes in this table, some are spare led addresses, others are unused.
@@ -161,32 +218,101 @@ private:
    * the bottom layer. All layers are switched with a mosfet LOW=ON, HIGH=OFF, they are
    * connected with a 1K pull up resistor as to not switch them on at boot up time. */
   uint8_t m_layerPin[Y_LAYERS] = {14, 15, 16, 17, 18, 19, 20, 21, 22};
+  /* Data and clock pins of every chain, used for resetting the TLC's */
+  uint8_t m_sinPin[3] = {SIN, SIN1, SIN2};
+  uint8_t m_sclkPin[3] = {SCLK, SCLK1, SCLK2};
+  static_assert(SPI_BUSES >= 1 && SPI_BUSES <= 3 && CHANNELS % (16*SPI_BUSES) == 0,
+                "every SPI bus needs a chain of whole TLC's");
+  /* The DMA sends the next layer while the TLC's count the current one, it has to be done
+   * before the latch. GSCNT=1024 on one bus needs 691us for a 273us cycle. */
+  static_assert(BUSBYTES*8*1000000ULL/SPISPEED < GSCNT*(CGH1+CGL1)*1000000ULL/F_BUS,
+                "a layer takes longer to send than a GSCLK cycle, add SPI_BUSES or raise GSCNT");
   /* Initialize settings for transferring data using DMA and SPI */
-  DMAChannel m_dmaChannel;
+  DMAChannel m_dmaChannel[SPI_BUSES];
   SPISettings m_spiSettings = SPISettings(SPISPEED, MSBFIRST, SPI_MODE0);
   /* Number of bytes that are needed to send all bits to the TLC's. (12 bits/channel) */
-  uint8_t m_channelBuffer[CHNBYTES];
+  uint8_t m_channelBuffer[SPI_BUSES][BUSBYTES];
   /* There should be only one displayed layer that is set to LOW, all other layers should
    * be set to HIGH. The displaying of the layers will start at the bottom (y=0). Every
    * cycle turns off the current layer first and than turns on the next one. */
   uint8_t m_LayerOffset = 0;
   uint8_t m_currentLayer = m_layerPin[0];
   uint8_t m_nextLayer    = m_layerPin[1];
+  /* Longest run of each interrupt in CPU cycles, and the shortest and longest time between
+   * two latches. The difference of the last two is how late a latch can come. */
+  volatile uint32_t m_latchCycles = 0;
+  volatile uint32_t m_prepareCycles = 0;
+  volatile uint32_t m_lastLatch = 0;
+  volatile uint32_t m_minLatchPeriod = UINT32_MAX;
+  volatile uint32_t m_maxLatchPeriod = 0;
+  /* Called over and over while update waits for the display to take the frame */
+  void (*m_idle)() = nullptr;
 public:
   OctadecaTLC5940();
   void setVoxel(int x, int y, int z, Color c);
   Color getRenderingVoxel(int x, int y, int z);
   Color getDisplayedVoxel(int x, int y, int z);
   void update();
+  /* Sets a function for update to call while it waits, it should return quickly. Pass
+   * nullptr to just wait. */
+  void setIdle(void (*idle)());
+  /* Number of frames the display took since begin. The displayed cube only changes when
+   * this does, so a copy of it is whole when the number is the same before and after. */
+  uint32_t frames();
   void multiplex();
+  void prepareLayer();
   /* Function pointer object instance to call multiplex() from the static interrupt
-   * service routine declared as void ftm1_isr(void) */
+   * service routine declared as void ftm1_isr(void), and prepareLayer() from the
+   * software interrupt */
   static OctadecaTLC5940* me;
   // Start timers and interrupts
   void begin();
+  /* Blends another frame over the displayed cube while packing, so the rendered frames
+   * themselves are left alone. weights holds one value per voxel in Frame order, 0 shows
+   * only the displayed cube and 255 only the overlay. Pass nullptr to stop blending, after
+   * that no layer is packed from the overlay and it may be overwritten. */
+  void setOverlay(const Frame* overlay, const uint8_t* weights);
+  /* Limits the current of every layer to a part of what a completely white layer draws,
+   * 0.5 allows half of it. Layers that ask for more are dimmed evenly. 0 or 1 switch the
+   * limit off. */
+  void setLayerBudget(float fraction);
+  // highest load a layer asked for since the last reset, 1 is a completely white layer
+  float layerPeak(int y);
+  // number of layer scans that were dimmed since the last reset
+  uint32_t limitedScans();
+  // longest run of the latch and of the layer preparation in CPU cycles
+  uint32_t latchCycles();
+  uint32_t prepareCycles();
+  // CPU cycles between the earliest and the latest latch
+  uint32_t latchJitter();
+  // clears the layer loads and the interrupt timings
+  void resetStats();
+  /* Checks that every led has channels of its own and measures the CPU cycles for packing
+   * a layer, plain, with an overlay and over budget. Call it before begin, the interrupt
+   * uses the same buffers. Returns the number of wrong channels. The packed bits
+   * themselves are checked on the PC by test/test_packer. */
+  int check(Print& log);
+  /* CPU cycles for packing one layer of the displayed cube. Call it before begin, like
+   * check. */
+  uint32_t packCycles();
+  /* Packs one layer of the displayed cube into the channel buffers, as the interrupt does
+   * before it sends them. Call it before begin, like check. */
+  void setChannelBuffer(int layer);
+  // the packed bits for the chain on one SPI bus, in the order they are sent
+  const uint8_t* channelBuffer(int bus);
+  // the blue, green and red channel of the led that shows column x,z of a layer
+  const uint16_t* ledChannels(int x, int z);
+protected:
+  /* Direct access to the rendering and displayed cube for passes that work on the entire
+   * cube. The displayed cube must only be read. */
+  Frame& getRenderingCube();
+  const Frame& getDisplayedCube();
 private:
+  int checkChannelMap(Print& log);
+  uint32_t ditherThreshold(int x, int z);
+  void clockChains();
   void setChannel(uint16_t channel, uint16_t color);
-  void setChannelBuffer(int layer);
   void sendChannelBuffer();
+  void sendChannelBuffer(int bus);
 };
 #endif
@@ -0,0 +1,118 @@
+#include "Particles.h"
+#include "Cube.h"
+#include "Util.h"
+#include <math.h>
+
+extern Cube cube;
+extern ColorWheel colorwheel;
+extern NoiseGenerator generator;
+/*----------------------------------------------------------------------------------------------
+ * PARTICLESYSTEM CLASS
+ *----------------------------------------------------------------------------------------------
+ * Every particle has a position, a velocity, an age and a start color. All particles share
+ * gravity, drag and the color they fade to. A particle ages from 0 to 1 during its lifetime
+ * and its color ramps from the start color to the fade color. Expired particles are removed
+ * by moving the last particle into their slot, so alive particles are always 0..size-1.
+ *
+ * Delta Time (float dt) is in seconds.
+ */
+ParticleSystem::ParticleSystem(float* data, Color* colors, int capacity) {
+  m_capacity = capacity;
+  m_x = data;
+  m_y = m_x + capacity;
+  m_z = m_y + capacity;
+  m_vx = m_z + capacity;
+  m_vy = m_vx + capacity;
+  m_vz = m_vy + capacity;
+  m_age = m_vz + capacity;
+  m_rate = m_age + capacity;
+  m_color = colors;
+}
+bool ParticleSystem::emit(const Vector3& p, const Vector3& v, Color c, float life) {
+  if(m_size == m_capacity)
+    return false;
+  int i = m_size++;
+  m_x[i] = p.x; m_y[i] = p.y; m_z[i] = p.z;
+  m_vx[i] = v.x; m_vy[i] = v.y; m_vz[i] = v.z;
+  m_age[i] = 0;
+  m_rate[i] = life > 0 ? 1/life : 1;
+  m_color[i] = c;
+  return true;
+}
+void ParticleSystem::clear() {
+  m_size = 0;
+}
+void ParticleSystem::update(float dt) {
+  integrate(dt);
+  cull();
+}
+// Same as Object::move followed by Object::drag, but the drag factor is calculated once
+void ParticleSystem::integrate(float dt) {
+  const int n = m_size;
+  const float d = powf(drag, dt);
+  const float gx = gravity.x*dt, gy = gravity.y*dt, gz = gravity.z*dt;
+  for(int i=0;i<n;i++) {
+    m_x[i] += m_vx[i]*dt;
+    m_y[i] += m_vy[i]*dt;
+    m_z[i] += m_vz[i]*dt;
+  }
+  for(int i=0;i<n;i++) {
+    m_vx[i] = (m_vx[i] + gx)*d;
+    m_vy[i] = (m_vy[i] + gy)*d;
+    m_vz[i] = (m_vz[i] + gz)*d;
+  }
+  if(floor) {
+    for(int i=0;i<n;i++)
+      m_y[i] = m_y[i] < 0 ? 0 : m_y[i];
+  }
+  for(int i=0;i<n;i++)
+    m_age[i] += m_rate[i]*dt;
+}
+// Remove particles that reached the end of their lifetime
+void ParticleSystem::cull() {
+  int i = 0;
+  while(i < m_size) {
+    if(m_age[i] < 1.0f) {
+      i++;
+      continue;
+    }
+    int last = --m_size;
+    m_x[i] = m_x[last]; m_y[i] = m_y[last]; m_z[i] = m_z[last];
+    m_vx[i] = m_vx[last]; m_vy[i] = m_vy[last]; m_vz[i] = m_vz[last];
+    m_age[i] = m_age[last]; m_rate[i] = m_rate[last];
+    m_color[i] = m_color[last];
+  }
+}
+void ParticleSystem::draw(int width, int height, int depth) {
+  const long fr = fade.R, fg = fade.G, fb = fade.B;
+  for(int i=0;i<m_size;i++) {
+    if(m_x[i] < 0 || m_x[i] >= width ||
+       m_y[i] < 0 || m_y[i] >= height ||
+       m_z[i] < 0 || m_z[i] >= depth)
+      continue;
+    // Same ramp as ColorBlender, but in 256 steps so the divide becomes a shift
+    long step = m_age[i]*256;
+    Color c = m_color[i];
+    c.R += (step*(fr - c.R)) >> 8;
+    c.G += (step*(fg - c.G)) >> 8;
+    c.B += (step*(fb - c.B)) >> 8;
+    cube.setVoxel(m_x[i], m_y[i], m_z[i], c);
+  }
+}
+/*----------------------------------------------------------------------------------------------
+ * EMITTER CLASS
+ *----------------------------------------------------------------------------------------------
+ * Emits a burst of particles at once, like the debris of an exploding firework.
+ */
+int Emitter::burst(ParticleSystem& ps, int count, float hue, float hueStep) {
+  int emitted = 0;
+  for(int i=0;i<count;i++) {
+    Vector3 v = velocity + Vector3(generator.nextRandom(-power,power),
+      generator.nextRandom(-power,power), generator.nextRandom(-power,power));
+    Color c = colorwheel.color(hue + hueStep*i);
+    if(!ps.emit(position, v, c, generator.nextRandom(minLife, maxLife)))
+      break;
+    emitted++;
+  }
+  return emitted;
+}
@@ -0,0 +1,75 @@
+#ifndef PARTICLES_H
+#define PARTICLES_H
+#include "Color.h"
+#include "Quaternion.h"
+
+/* A pool of particles stored as a structure of arrays, so the integrate, cull and draw
+ * loops run over plain float arrays. The storage is owned by ParticlePool<N> below, this
+ * class only knows where the arrays are and how many particles are alive. */
+class ParticleSystem {
+public:
+  // constant acceleration acting on all particles in pixels per second^2
+  Vector3 gravity = Vector3(0,0,0);
+  // fraction of the velocity left after one second, 1 means no drag
+  float drag = 1.0f;
+  // color every particle ramps to at the end of its lifetime
+  Color fade = Color::BLACK;
+  // keep particles from falling through the bottom of the display
+  bool floor = true;
+public:
+  // add a particle living for life seconds, returns false if the pool is full
+  bool emit(const Vector3& position, const Vector3& velocity, Color color, float life);
+  // move all particles dt seconds forward in time and remove the expired ones
+  void update(float dt);
+  // draw all particles that are inside the display
+  void draw(int width, int height, int depth);
+  // remove all particles
+  void clear();
+  int size() const { return m_size; }
+  int capacity() const { return m_capacity; }
+  bool empty() const { return m_size==0; }
+  // the arrays belong to a pool, a copy would keep pointing into the pool it came from
+  ParticleSystem(const ParticleSystem&) = delete;
+  ParticleSystem& operator=(const ParticleSystem&) = delete;
+protected:
+  ParticleSystem(float* data, Color* colors, int capacity);
+private:
+  void integrate(float dt);
+  void cull();
+private:
+  int m_capacity;
+  int m_size = 0;
+  // position, velocity, normalized age (0..1) and aging rate (1/lifetime)
+  float *m_x, *m_y, *m_z;
+  float *m_vx, *m_vy, *m_vz;
+  float *m_age, *m_rate;
+  // start color of the color ramp
+  Color *m_color;
+};
+
+template<int N>
+class ParticlePool : public ParticleSystem {
+public:
+  ParticlePool() : ParticleSystem(m_data, m_colors, N) {}
+  ParticlePool(const ParticlePool&) = delete;
+  ParticlePool& operator=(const ParticlePool&) = delete;
+private:
+  float m_data[8*N];
+  Color m_colors[N];
+};
+
+/* An emitter creates bursts of particles around a position. Each particle gets the
+ * base velocity plus a random velocity of up to power pixels per second on each axis
+ * and a color taken from the color wheel. */
+class Emitter {
+public:
+  Vector3 position = Vector3(0,0,0);
+  Vector3 velocity = Vector3(0,0,0);
+  float power = 0;
+  float minLife = 1.0f;
+  float maxLife = 2.0f;
+public:
+  // emit count particles colored from hue onwards in steps of hueStep on the color wheel
+  int burst(ParticleSystem& ps, int count, float hue, float hueStep);
+};
+#endif
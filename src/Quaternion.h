@@ -1,105 +1,262 @@
 #ifndef QUATERNION_H_
 #define QUATERNION_H_
-
-class Vector3 {
+#include "Fixed.h"
+/*----------------------------------------------------------------------------------------------
+ * V3 CLASS
+ *----------------------------------------------------------------------------------------------
+ * A vector V in physics is an (angel, magnitude) magnitude is length and the angle
+ * is usually represented by Greek letter theta.
+ *
+ * In game development a vector is stored as (x,y,z) representing a movement
+ * in the Cartesian plane across the x, y and z axis.
+ *
+ * A point or the position of an object can also be represented by a vector by moving
+ * from the origin to the coordinates (x,y,z)
+ *
+ * The length = sqrt(x*x + y*y + z*z)
+ *
+ * All operators are inline, so adding and scaling vectors compiles to a few instructions.
+ * T is the number type, Vector3 uses float and FixedVector3 uses Q16.16 fixed point.
+ */
+template<typename T>
+class Vector3T {
 public:
-  float x,y,z;
+  T x,y,z;
 public:
   // constructors
-  Vector3();
-  Vector3(float x, float y, float z);
-  Vector3(const Vector3& v);
-  // copy assignment
-  Vector3& operator=(const Vector3& v);
-
-  // moving
-  Vector3 operator+(const Vector3& v) const;
-  Vector3 operator-(const Vector3& v) const;
-  void operator+=(const Vector3& v);
-  void operator-=(const Vector3& v);
+  constexpr Vector3T():x(0),y(0),z(0) {}
+  constexpr Vector3T(T x_, T y_, T z_):x(x_),y(y_),z(z_) {}
+
+  // moving (add, subtract)
+  constexpr Vector3T operator+(const Vector3T& v) const {
+    return Vector3T(x+v.x, y+v.y, z+v.z);
+  }
+  constexpr Vector3T operator-(const Vector3T& v) const {
+    return Vector3T(x-v.x, y-v.y, z-v.z);
+  }
+  constexpr void operator+=(const Vector3T& v) {
+    x+=v.x; y+=v.y; z+=v.z;
+  }
+  constexpr void operator-=(const Vector3T& v) {
+    x-=v.x; y-=v.y; z-=v.z;
+  }
   // negate
-  Vector3 operator-() const;
+  constexpr Vector3T operator-() const {
+    return Vector3T(-x, -y, -z);
+  }
 
-  // scaling
-  Vector3 operator*(float s) const;
-  Vector3 operator/(float s) const;
-  void operator*=(float s);
-  void operator/=(float s);
+  // scaling (multiply, divide by scalar)
+  constexpr Vector3T operator*(T s) const {
+    return Vector3T(x*s, y*s, z*s);
+  }
+  constexpr Vector3T operator/(T s) const {
+    return Vector3T(x/s, y/s, z/s);
+  }
+  constexpr void operator*=(T s) {
+    x*=s; y*=s; z*=s;
+  }
+  constexpr void operator/=(T s) {
+    x/=s; y/=s; z/=s;
+  }
 
   // cross product
-  Vector3 cross(const Vector3& v) const;
-  Vector3 operator*(const Vector3& v) const;
-  void operator*=(const Vector3& v);
+  constexpr Vector3T cross(const Vector3T& v) const {
+    return Vector3T(y*v.z-z*v.y, z*v.x-x*v.z, x*v.y-y*v.x);
+  }
+  constexpr Vector3T operator*(const Vector3T& v) const {
+    return cross(v);
+  }
+  constexpr void operator*=(const Vector3T& v) {
+    *this=cross(v);
+  }
 
   // dot product
-  float dot(const Vector3& v) const;
-  float operator%(const Vector3& v) const;
+  constexpr T dot(const Vector3T& v) const {
+    return x*v.x+y*v.y+z*v.z;
+  }
+  constexpr T operator%(const Vector3T& v) const {
+    return dot(v);
+  }
 
   // unit vector
-  void normalize();
-  Vector3 normalized() const;
+  void normalize() {
+    *this/=magnitude();
+  }
+  Vector3T normalized() const {
+    return (*this)/magnitude();
+  }
   // magnitude or length of the vector
-  float magnitude() const;
-  float norm() const;
+  T magnitude() const {
+    return squareRoot(norm());
+  }
+  constexpr T norm() const {
+    return x*x+y*y+z*z;
+  }
 
-  // rotate v by this axis (vector) and angle
-  void rotate(float angle, Vector3& v) const;
-  Vector3 rotated(float angle, const Vector3& v) const;
+  // rotate v by this vector (axis) and angle using Rodrigues formula
+  // Angle is in radians, unlike the degrees of QuaternionT::convertAxisAngle
+  void rotate(T angle, Vector3T& v) const {
+    T c = cosine(angle);
+    T s = sine(angle);
+    // normalize this vector to get n hat
+    Vector3T n = normalized();
+    // (1-cos(0))(v.n)n + cos(0)v + sin(0)(n x v)
+    v = n*((1-c)*n.dot(v)) + ((v*c) + n.cross(v)*s);
+  }
+  Vector3T rotated(T angle, const Vector3T& v) const {
+    Vector3T v_ = v;
+    rotate(angle, v_);
+    return v_;
+  }
 
   // test if vector is inside object space
-  bool inside(int w, int h, int d);
+  constexpr bool inside(int width, int height, int depth) const {
+    return (x < width && x >= 0) &&
+           (y < height && y >= 0) &&
+           (z < depth && z >= 0);
+  }
 };
 
-
-class Quaternion {
+/*----------------------------------------------------------------------------------------------
+ * Q4 CLASS (QUATERNION)
+ *----------------------------------------------------------------------------------------------
+ * A Quaternion is a complex number in the form  w + xi + yj + zk, where w, x, y, z are real
+ * numbers and i, j, k are imaginary.
+ *
+ * In the implementation i,j and k are ignored, w is a scalar and x,y,z is a vector
+ */
+template<typename T>
+class QuaternionT {
 public:
-  float w;
-  Vector3 v;
+  T w;
+  Vector3T<T> v;
 public:
   // constructors
-  Quaternion(float a, const Vector3& v);
-  Quaternion();
-  Quaternion(const Quaternion& q);
-  // copy assignment
-  Quaternion& operator=(const Quaternion& q);
-  void convertAxisAngle();
+  constexpr QuaternionT():w(0),v() {}
+  constexpr QuaternionT(T w_, const Vector3T<T>& v_):w(w_),v(v_) {}
+
+  // Makes a real quaternion from an angle and an axis stored in this 'fake' quaternion
+  // Angle is in degree and is converted to radian by 2PI/360 * angle => PI/180 * angle
+  // Angles are divided by 2 when using quaternions so back to PI/360
+  void convertAxisAngle() {
+    v.normalize();
+    w*=T(3.14159265358979f/360);
+    v*=sine(w);
+    w=cosine(w);
+  }
 
   // moving (add subtract)
-  Quaternion operator+(const Quaternion& q) const;
-  Quaternion operator-(const Quaternion& q) const;
-  void operator+=(const Quaternion& q);
-  void operator-=(const Quaternion& q);
+  constexpr QuaternionT operator+(const QuaternionT& q) const {
+    return QuaternionT(w+q.w, v+q.v);
+  }
+  constexpr QuaternionT operator-(const QuaternionT& q) const {
+    return QuaternionT(w-q.w, v-q.v);
+  }
+  constexpr void operator+=(const QuaternionT& q) {
+    w+=q.w; v+=q.v;
+  }
+  constexpr void operator-=(const QuaternionT& q) {
+    w-=q.w; v-=q.v;
+  }
 
   // scaling (multiply divide by scalar)
-  Quaternion operator*(float s) const;
-  Quaternion operator/(float s) const;
-
-  void operator*=(float s);
-  void operator/=(float s);
+  constexpr QuaternionT operator*(T s) const {
+    return QuaternionT(w*s, v*s);
+  }
+  constexpr QuaternionT operator/(T s) const {
+    return QuaternionT(w/s, v/s);
+  }
+  constexpr void operator*=(T s) {
+    w*=s; v*=s;
+  }
+  constexpr void operator/=(T s) {
+    w/=s; v/=s;
+  }
 
   // multiply quaternions
-  Quaternion operator*(const Quaternion& q) const;
-  Quaternion operator/(const Quaternion& q) const;
-  void operator*=(const Quaternion& q);
+  constexpr QuaternionT operator*(const QuaternionT& q) const {
+    return QuaternionT(w*q.w - v.dot(q.v), v*q.w + q.v*w + v.cross(q.v));
+  }
+  QuaternionT operator/(const QuaternionT& q) const {
+    return ((*this)*q.inversed());
+  }
+  constexpr void operator*=(const QuaternionT& q) {
+    (*this)=operator*(q);
+  }
 
   // dot product
-  float dot(const Quaternion& q) const;
-  float operator%(const Quaternion& q) const;
+  constexpr T dot(const QuaternionT& q) const {
+    return w*q.w + v.dot(q.v);
+  }
+  constexpr T operator%(const QuaternionT& q) const {
+    return dot(q);
+  }
 
   // inverse
-  void inverse();
-  Quaternion inversed() const;
+  void inverse() {
+    conjugate();
+    *this*=1/norm();
+  }
+  QuaternionT inversed() const {
+    return conjugated()*(1/norm());
+  }
   // get conjugate (negative imaginary part)
-  void conjugate();
-  Quaternion conjugated() const;
+  constexpr void conjugate() {
+    v= -v;
+  }
+  constexpr QuaternionT conjugated() const {
+    return QuaternionT(w, -v);
+  }
   // unit quaternion
-  void normalize();
-  Quaternion normalized() const;
+  void normalize() {
+    *this/=magnitude();
+  }
+  QuaternionT normalized() const {
+    return (*this)/magnitude();
+  }
   // magnitude or length of the quaterion
-  float magnitude() const;
-  float norm() const;
+  T magnitude() const {
+    return squareRoot(norm());
+  }
+  constexpr T norm() const {
+    return w*w + v.dot(v);
+  }
+
   // rotate v by quaternion
-  void rotate(Vector3& v) const;
-  Vector3 rotated(const Vector3& v) const;
+  void rotate(Vector3T<T>& v_) const {
+    // creates a pure quaternion from a vector
+    QuaternionT p = QuaternionT(0, v_);
+    // multiply (p)(q)(pi)
+    v_ = ((*this)*p*(*this).inversed()).v;
+  }
+  Vector3T<T> rotated(const Vector3T<T>& v_) const {
+    Vector3T<T> r = v_;
+    rotate(r);
+    return r;
+  }
+  // rotate n vectors by this unit quaternion, the rotation matrix is calculated only once
+  void rotate(Vector3T<T>* vs, int n) const {
+    T m[3][3];
+    toMatrix(m);
+    for(int i=0;i<n;i++) {
+      Vector3T<T> p = vs[i];
+      vs[i].x = m[0][0]*p.x + m[0][1]*p.y + m[0][2]*p.z;
+      vs[i].y = m[1][0]*p.x + m[1][1]*p.y + m[1][2]*p.z;
+      vs[i].z = m[2][0]*p.x + m[2][1]*p.y + m[2][2]*p.z;
+    }
+  }
+  // Rotating many vectors is cheaper with a matrix: 9 multiplies instead of 2 quaternion
+  // products per vector. m*v rotates v the same as rotate(v) does for a unit quaternion.
+  constexpr void toMatrix(T m[3][3]) const {
+    T x=v.x, y=v.y, z=v.z;
+    m[0][0] = 1-2*(y*y+z*z); m[0][1] = 2*(x*y-w*z);   m[0][2] = 2*(x*z+w*y);
+    m[1][0] = 2*(x*y+w*z);   m[1][1] = 1-2*(x*x+z*z); m[1][2] = 2*(y*z-w*x);
+    m[2][0] = 2*(x*z-w*y);   m[2][1] = 2*(y*z+w*x);   m[2][2] = 1-2*(x*x+y*y);
+  }
 };
+
+typedef Vector3T<float> Vector3;
+typedef QuaternionT<float> Quaternion;
+typedef Vector3T<Fixed> FixedVector3;
+typedef QuaternionT<Fixed> FixedQuaternion;
 #endif
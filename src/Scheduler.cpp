@@ -0,0 +1,46 @@
+#include "Scheduler.h"
+/*----------------------------------------------------------------------------------------------
+ * SCHEDULER CLASS
+ *----------------------------------------------------------------------------------------------
+ * Times are 32 bits and compared by their difference, so they keep working when micros()
+ * wraps after 71 minutes, also on a PC where unsigned long is wider. A task that missed
+ * whole periods runs once and is then due a period later, it doesn't try to catch up.
+ */
+Scheduler::Scheduler(TimeSource now) : m_now(now) {}
+
+bool Scheduler::add(Task task, unsigned long period) {
+  if(m_numTasks == maxTasks)
+    return false;
+  m_tasks[m_numTasks++] = { task, (uint32_t)period, (uint32_t)(m_now() + period) };
+  return true;
+}
+
+bool Scheduler::run() {
+  const uint32_t now = m_now();
+  Entry* next = nullptr;
+  uint32_t lateness = 0;
+  for(int i=0;i<m_numTasks;i++) {
+    const uint32_t late = now - m_tasks[i].due;
+    if((int32_t)late >= 0 && (!next || late > lateness)) {
+      next = &m_tasks[i];
+      lateness = late;
+    }
+  }
+  if(!next)
+    return false;
+  if(lateness > m_maxLateness)
+    m_maxLateness = lateness;
+  next->due += next->period;
+  if((int32_t)(now - next->due) >= 0)
+    next->due = now + next->period;
+  next->task();
+  return true;
+}
+
+unsigned long Scheduler::maxLateness() {
+  return m_maxLateness;
+}
+
+void Scheduler::resetStats() {
+  m_maxLateness = 0;
+}
@@ -0,0 +1,35 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+#include <Arduino.h>
+/* Runs small jobs next to the animations, like reading commands or printing statistics.
+ * Every task is a function that is called again every period and has to return quickly,
+ * nothing interrupts it. The task that is due longest runs first. run is called from the
+ * idle hook of the cube, while it waits for the display to take the next frame. */
+class Scheduler {
+public:
+  typedef void (*Task)();
+  // where the time comes from, in microseconds that wrap at 32 bits
+  typedef unsigned long (*TimeSource)();
+  static const int maxTasks = 8;
+public:
+  // the time comes from micros(), tests give a source they can move themselves
+  Scheduler(TimeSource now = micros);
+  // adds a task that is due every period microseconds, false when there is no room left
+  bool add(Task task, unsigned long period);
+  // runs the task that is due longest, false when no task is due
+  bool run();
+  // longest time a task started after it was due, in microseconds
+  unsigned long maxLateness();
+  void resetStats();
+private:
+  struct Entry {
+    Task task;
+    uint32_t period;
+    uint32_t due;
+  };
+  TimeSource m_now;
+  Entry m_tasks[maxTasks];
+  int m_numTasks = 0;
+  uint32_t m_maxLateness = 0;
+};
+#endif
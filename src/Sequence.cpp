@@ -0,0 +1,130 @@
+#include "Sequence.h"
+/*----------------------------------------------------------------------------------------------
+ * SEQUENCEFILE CLASS
+ *----------------------------------------------------------------------------------------------
+ * Frames are read ahead into a small ring of buffers. prefetch() fills the free buffers
+ * right after a frame is decoded, so the card is read while the frame is displayed and
+ * next() normally finds its payload waiting.
+ */
+namespace {
+enum CardState { CARD_UNKNOWN, CARD_READY, CARD_MISSING };
+CardState card = CARD_UNKNOWN;
+const int headerSize = 16;
+}
+
+// a missing card isn't retried every time a file is opened
+bool beginCard() {
+  if(card == CARD_UNKNOWN)
+    card = SD.begin(BUILTIN_SDCARD) ? CARD_READY : CARD_MISSING;
+  return card == CARD_READY;
+}
+
+bool SequenceFile::open(const char* name) {
+  close();
+  if(!beginCard())
+    return false;
+  m_file = SD.open(name);
+  if(!m_file)
+    return false;
+  uint8_t header[8];
+  if(m_file.read(header, 8) != 8 || memcmp(header, "VXS1", 4) != 0 ||
+     header[4] != X_LAYERS || header[5] != Y_LAYERS || header[6] != Z_LAYERS ||
+     header[7] == 0) {
+    m_file.close();
+    return false;
+  }
+  m_fps = header[7];
+  m_frames = readLong();
+  m_indexOffset = readLong();
+  m_position = 0;
+  m_read = 0;
+  m_first = 0;
+  m_count = 0;
+  m_file.seek(headerSize);
+  m_open = m_frames > 0;
+  if(!m_open)
+    m_file.close();
+  return m_open;
+}
+
+void SequenceFile::close() {
+  if(m_open)
+    m_file.close();
+  m_open = false;
+}
+
+void SequenceFile::prefetch() {
+  while(m_open && m_count < numBuffers && m_read < m_frames) {
+    if(!read(m_buffers[(m_first+m_count)%numBuffers])) {
+      close();
+      return;
+    }
+    m_count++;
+    m_read++;
+  }
+}
+
+bool SequenceFile::next(const Frame& previous, Frame& frame) {
+  if(!m_open || m_position >= m_frames)
+    return false;
+  if(m_count == 0)
+    prefetch();
+  if(m_count == 0)
+    return false;
+  const Buffer& b = m_buffers[m_first];
+  m_first = (m_first+1)%numBuffers;
+  m_count--;
+  m_position++;
+  return FrameCodec::decode(b.type, b.data, b.length, previous, frame);
+}
+
+bool SequenceFile::seek(int n, Frame& frame) {
+  if(!m_open || n < 0 || n >= m_frames)
+    return false;
+  // walk back through the index to the keyframe
+  int key = n;
+  uint32_t offset;
+  for(;;) {
+    if(!readOffset(key, offset))
+      return false;
+    m_file.seek(offset);
+    if(m_file.read() == FrameCodec::KEYFRAME || key == 0)
+      break;
+    key--;
+  }
+  // drop the frames read ahead and decode from the keyframe on, every delta in place into
+  // the frame it is based on
+  m_file.seek(offset);
+  m_first = 0;
+  m_count = 0;
+  m_read = key;
+  m_position = key;
+  while(m_position <= n)
+    if(!next(frame, frame))
+      return false;
+  return true;
+}
+
+bool SequenceFile::read(Buffer& buffer) {
+  uint8_t header[3];
+  if(m_file.read(header, 3) != 3)
+    return false;
+  buffer.type = header[0];
+  buffer.length = header[1] | (header[2] << 8);
+  if(buffer.length > FrameCodec::maxPayload)
+    return false;
+  return m_file.read(buffer.data, buffer.length) == buffer.length;
+}
+
+bool SequenceFile::readOffset(int n, uint32_t& offset) {
+  if(!m_file.seek(m_indexOffset + n*4))
+    return false;
+  offset = readLong();
+  return offset >= headerSize && offset < m_indexOffset;
+}
+
+uint32_t SequenceFile::readLong() {
+  uint8_t b[4] = { 0, 0, 0, 0 };
+  m_file.read(b, 4);
+  return b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24);
+}
@@ -0,0 +1,58 @@
+#ifndef SEQUENCE_H
+#define SEQUENCE_H
+#include <SD.h>
+#include "FrameCodec.h"
+/* A pre-recorded voxel sequence on the SD card.
+ *
+ * File layout, all numbers LSB first:
+ *   0  'V' 'X' 'S' '1'
+ *   4  width, height, depth, frames per second (1 byte each)
+ *   8  number of frames (4 bytes)
+ *   12 offset of the frame index (4 bytes)
+ *   16 frames: type (1 byte) length (2 bytes) payload, see FrameCodec
+ *   .. frame index: file offset of every frame (4 bytes each)
+ * The first frame is a keyframe, after that keyframes are placed every now and then so
+ * seeking only has to decode a few deltas. */
+// starts the SD card the first time it is called, returns false when there is no card
+bool beginCard();
+
+class SequenceFile {
+public:
+  bool open(const char* name);
+  void close();
+  bool isOpen() const { return m_open; }
+  int frames() const { return m_frames; }
+  int fps() const { return m_fps; }
+  // index of the next frame that will be decoded
+  int position() const { return m_position; }
+  // read frames ahead into the free buffers, so decoding doesn't wait for the card
+  void prefetch();
+  // decode the next frame into frame, previous is the frame shown before this one
+  bool next(const Frame& previous, Frame& frame);
+  // decode frame n into frame, starting from the nearest keyframe before it
+  bool seek(int n, Frame& frame);
+private:
+  struct Buffer {
+    uint8_t type;
+    int length;
+    uint8_t data[FrameCodec::maxPayload];
+  };
+  bool read(Buffer& buffer);
+  bool readOffset(int n, uint32_t& offset);
+  uint32_t readLong();
+private:
+  static const int numBuffers = 2;
+  File m_file;
+  bool m_open = false;
+  int m_frames = 0;
+  int m_fps = 0;
+  uint32_t m_indexOffset = 0;
+  // next frame to decode and next frame to read from the card
+  int m_position = 0;
+  int m_read = 0;
+  // ring of frames read ahead, m_first is the oldest
+  Buffer m_buffers[numBuffers];
+  int m_first = 0;
+  int m_count = 0;
+};
+#endif
@@ -0,0 +1,273 @@
+#include "Spectrum.h"
+#include <math.h>
+/*----------------------------------------------------------------------------------------------
+ * FIXEDFFT CLASS
+ *----------------------------------------------------------------------------------------------
+ * Decimation in time: the input is put in base 4 digit reversed order, then every stage
+ * combines four transforms into one four times as long. A butterfly takes three complex
+ * multiplies and eight halving adds and subtracts, the ones by -i swap the halves with
+ * SHASX and SHSAX. Four stages for 256 points load and store every number half as often
+ * as eight radix-2 stages and need a quarter less multiplies. Other processors get the
+ * same results from plain C.
+ */
+namespace {
+#if defined(__ARM_ARCH_7EM__)
+inline uint32_t halvingAdd(uint32_t a, uint32_t b) {
+  uint32_t r; asm("shadd16 %0, %1, %2" : "=r" (r) : "r" (a), "r" (b)); return r;
+}
+inline uint32_t halvingSub(uint32_t a, uint32_t b) {
+  uint32_t r; asm("shsub16 %0, %1, %2" : "=r" (r) : "r" (a), "r" (b)); return r;
+}
+// (a + b*-i)/2 and (a - b*-i)/2
+inline uint32_t halvingAddMinusI(uint32_t a, uint32_t b) {
+  uint32_t r; asm("shsax %0, %1, %2" : "=r" (r) : "r" (a), "r" (b)); return r;
+}
+inline uint32_t halvingSubMinusI(uint32_t a, uint32_t b) {
+  uint32_t r; asm("shasx %0, %1, %2" : "=r" (r) : "r" (a), "r" (b)); return r;
+}
+// low*low - high*high
+inline int32_t multiplySub(uint32_t a, uint32_t b) {
+  int32_t r; asm("smusd %0, %1, %2" : "=r" (r) : "r" (a), "r" (b)); return r;
+}
+// low*high + high*low
+inline int32_t multiplyAddCross(uint32_t a, uint32_t b) {
+  int32_t r; asm("smuadx %0, %1, %2" : "=r" (r) : "r" (a), "r" (b)); return r;
+}
+// low*low + high*high
+inline int32_t multiplyAdd(uint32_t a, uint32_t b) {
+  int32_t r; asm("smuad %0, %1, %2" : "=r" (r) : "r" (a), "r" (b)); return r;
+}
+#else
+inline int32_t lo(uint32_t a) { return (int16_t)a; }
+inline int32_t hi(uint32_t a) { return (int16_t)(a >> 16); }
+inline uint32_t halvingAdd(uint32_t a, uint32_t b) {
+  return FixedFFT::pack((lo(a) + lo(b)) >> 1, (hi(a) + hi(b)) >> 1);
+}
+inline uint32_t halvingSub(uint32_t a, uint32_t b) {
+  return FixedFFT::pack((lo(a) - lo(b)) >> 1, (hi(a) - hi(b)) >> 1);
+}
+inline uint32_t halvingAddMinusI(uint32_t a, uint32_t b) {
+  return FixedFFT::pack((lo(a) + hi(b)) >> 1, (hi(a) - lo(b)) >> 1);
+}
+inline uint32_t halvingSubMinusI(uint32_t a, uint32_t b) {
+  return FixedFFT::pack((lo(a) - hi(b)) >> 1, (hi(a) + lo(b)) >> 1);
+}
+inline int32_t multiplySub(uint32_t a, uint32_t b) { return lo(a)*lo(b) - hi(a)*hi(b); }
+inline int32_t multiplyAddCross(uint32_t a, uint32_t b) { return lo(a)*hi(b) + hi(a)*lo(b); }
+inline int32_t multiplyAdd(uint32_t a, uint32_t b) { return lo(a)*lo(b) + hi(a)*hi(b); }
+#endif
+// a times the twiddle factor w, rounded back to Q1.15
+inline uint32_t multiply(uint32_t a, uint32_t w) {
+  return FixedFFT::pack((multiplySub(a, w) + 0x4000) >> 15,
+                        (multiplyAddCross(a, w) + 0x4000) >> 15);
+}
+}
+
+FixedFFT::FixedFFT() {
+  for(int k=0;k<size*3/4;k++) {
+    float angle = -2*PI*k/size;
+    m_twiddle[k] = pack(lroundf(32767*cosf(angle)), lroundf(32767*sinf(angle)));
+  }
+  for(int i=0;i<size;i++) {
+    int r = 0;
+    for(int d=0;d<bits;d+=2)
+      r |= ((i >> d) & 3) << (bits-2-d);
+    m_reverse[i] = r;
+  }
+}
+
+void FixedFFT::transform(uint32_t* data) const {
+  for(int i=0;i<size;i++) {
+    int r = m_reverse[i];
+    if(r > i) {
+      uint32_t t = data[i];
+      data[i] = data[r];
+      data[r] = t;
+    }
+  }
+  for(int quarter=1, step=size/4; quarter<size; quarter<<=2, step>>=2) {
+    for(int j=0;j<quarter;j++) {
+      const uint32_t w1 = m_twiddle[j*step];
+      const uint32_t w2 = m_twiddle[2*j*step];
+      const uint32_t w3 = m_twiddle[3*j*step];
+      for(int i=j;i<size;i+=4*quarter) {
+        const uint32_t a = data[i];
+        const uint32_t b = multiply(data[i+quarter], w1);
+        const uint32_t c = multiply(data[i+2*quarter], w2);
+        const uint32_t d = multiply(data[i+3*quarter], w3);
+        const uint32_t sumAC = halvingAdd(a, c);
+        const uint32_t diffAC = halvingSub(a, c);
+        const uint32_t sumBD = halvingAdd(b, d);
+        const uint32_t diffBD = halvingSub(b, d);
+        data[i] = halvingAdd(sumAC, sumBD);
+        data[i+quarter] = halvingAddMinusI(diffAC, diffBD);
+        data[i+2*quarter] = halvingSub(sumAC, sumBD);
+        data[i+3*quarter] = halvingSubMinusI(diffAC, diffBD);
+      }
+    }
+  }
+}
+/*----------------------------------------------------------------------------------------------
+ * SPECTRUM CLASS
+ *----------------------------------------------------------------------------------------------
+ * Every block gets its DC offset removed and a Hann window, then the energy of the bins of
+ * every band is added up. Bands are about half an octave wide from 100Hz to 12.8kHz. The
+ * energy is turned into dB and shown relative to the loudest band of the last seconds,
+ * so the bars use the whole height whatever the volume is.
+ */
+Spectrum* Spectrum::me;
+const uint8_t Spectrum::m_bandEdges[numBands+1] = {1, 2, 3, 5, 8, 13, 21, 34, 55, 128};
+namespace {
+// dB shown from the bottom to the top of a band
+const float range = 36;
+// fall back of the levels and the peak per block of 10ms
+const float levelRelease = 0.04f;
+const float peakRelease = 0.05f;
+// the peak doesn't fall below this, so silence and noise stay dark
+const float quietPeak = 40;
+}
+
+Spectrum::Spectrum() {
+  for(int i=0;i<FixedFFT::size;i++)
+    m_window[i] = lroundf(32767*(0.5f - 0.5f*cosf(2*PI*i/FixedFFT::size)));
+  for(int b=0;b<numBands;b++)
+    m_levels[b] = 0;
+  m_peak = quietPeak;
+}
+
+/* The ADC is set up by analogRead, after that it converts on every trigger of the PDB
+ * and requests the DMA when a result is ready. */
+void Spectrum::begin() {
+  if(m_started)
+    return;
+  m_started = true;
+  me = this;
+  analogReadResolution(12);
+  analogReadAveraging(4);
+  analogRead(AUDIO_PIN);
+  ADC0_SC2 |= ADC_SC2_ADTRG | ADC_SC2_DMAEN;
+
+  // the DMA reads the low half of the 32 bit result register, it only needs the address
+  volatile uint16_t* result = (volatile uint16_t*)&ADC0_RA;
+  m_dma.source(*result);
+  m_dma.destinationBuffer(m_ring, sizeof(m_ring));
+  m_dma.interruptAtHalf();
+  m_dma.interruptAtCompletion();
+  m_dma.attachInterrupt(dmaIsr);
+  m_dma.triggerAtHardwareEvent(DMAMUX_SOURCE_ADC0);
+  m_dma.enable();
+
+  // PDB runs continuously from the bus clock and triggers ADC0 channel A
+  SIM_SCGC6 |= SIM_SCGC6_PDB;
+  PDB0_MOD = F_BUS/AUDIO_RATE - 1;
+  PDB0_IDLY = 1;
+  PDB0_CH0C1 = PDB_CH0C1_TOS | PDB_CH0C1_EN;
+  PDB0_SC = PDB_SC_TRGSEL(15) | PDB_SC_PDBEN | PDB_SC_CONT | PDB_SC_LDOK;
+  PDB0_SC |= PDB_SC_SWTRIG;
+}
+
+// The DMA is already writing the other half of the ring
+void Spectrum::dmaIsr() {
+  me->m_dma.clearInterrupt();
+  const uint16_t* write = (const uint16_t*)me->m_dma.TCD->DADDR;
+  me->m_ready = write < me->m_ring + FixedFFT::size ? 1 : 0;
+}
+
+void Spectrum::update() {
+  const int half = m_ready;
+  if(half < 0)
+    return;
+  m_ready = -1;
+  analyze(m_ring + half*FixedFFT::size);
+}
+
+float Spectrum::level(int band) {
+  return m_levels[band];
+}
+
+void Spectrum::analyze(const uint16_t* samples) {
+  uint32_t sum = 0;
+  for(int i=0;i<FixedFFT::size;i++)
+    sum += samples[i];
+  const int32_t mean = sum/FixedFFT::size;
+  // 12 bits to 15 bits, a full swing around the mean just fits
+  for(int i=0;i<FixedFFT::size;i++) {
+    int32_t s = (samples[i] - mean)*8;
+    m_data[i] = FixedFFT::pack((s*m_window[i]) >> 15, 0);
+  }
+  m_fft.transform(m_data);
+
+  float loudest = 0;
+  float energy[numBands];
+  for(int b=0;b<numBands;b++) {
+    // all bins together are at most the energy of the samples, that fits 32 bits
+    uint32_t e = 1;
+    for(int k=m_bandEdges[b];k<m_bandEdges[b+1];k++)
+      e += multiplyAdd(m_data[k], m_data[k]);
+    energy[b] = 10*log10f(e);
+    if(energy[b] > loudest) loudest = energy[b];
+  }
+  m_peak -= peakRelease;
+  if(m_peak < loudest) m_peak = loudest;
+  if(m_peak < quietPeak) m_peak = quietPeak;
+  for(int b=0;b<numBands;b++) {
+    float level = (energy[b] - (m_peak - range))/range;
+    if(level < 0) level = 0;
+    m_levels[b] -= levelRelease;
+    if(m_levels[b] < level) m_levels[b] = level;
+  }
+}
+
+/* The test signal has two tones and a little noise, so every bin gets something. The FFT
+ * is scaled by 1/size, the DFT is divided the same way. */
+int Spectrum::check(Print& log) {
+  int16_t signal[FixedFFT::size];
+  uint32_t state = 1;
+  for(int n=0;n<FixedFFT::size;n++) {
+    state = state*1664525 + 1013904223;
+    float v = 12000*sinf(2*PI*10*n/FixedFFT::size) + 6000*cosf(2*PI*37*n/FixedFFT::size) +
+              (int32_t)(state >> 20) - 2048;
+    signal[n] = lroundf(v);
+    m_data[n] = FixedFFT::pack(signal[n], 0);
+  }
+  ARM_DEMCR |= ARM_DEMCR_TRCENA;
+  ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+  uint32_t start = ARM_DWT_CYCCNT;
+  m_fft.transform(m_data);
+  const uint32_t fftCycles = ARM_DWT_CYCCNT - start;
+
+  int wrong = 0;
+  float maxError = 0;
+  for(int k=0;k<FixedFFT::size;k++) {
+    float re = 0, im = 0;
+    for(int n=0;n<FixedFFT::size;n++) {
+      float angle = -2*PI*((k*n) % FixedFFT::size)/FixedFFT::size;
+      re += signal[n]*cosf(angle);
+      im += signal[n]*sinf(angle);
+    }
+    re /= FixedFFT::size;
+    im /= FixedFFT::size;
+    float error = fabsf(re - FixedFFT::real(m_data[k]));
+    if(fabsf(im - FixedFFT::imag(m_data[k])) > error)
+      error = fabsf(im - FixedFFT::imag(m_data[k]));
+    if(error > maxError) maxError = error;
+    if(error > 4) wrong++;
+  }
+
+  // a whole block, on a copy of the samples so the levels don't change
+  uint16_t samples[FixedFFT::size];
+  for(int n=0;n<FixedFFT::size;n++)
+    samples[n] = 2048 + signal[n]/16;
+  float levels[numBands];
+  memcpy(levels, m_levels, sizeof(levels));
+  const float peak = m_peak;
+  start = ARM_DWT_CYCCNT;
+  analyze(samples);
+  const uint32_t blockCycles = ARM_DWT_CYCCNT - start;
+  memcpy(m_levels, levels, sizeof(levels));
+  m_peak = peak;
+
+  log.printf("fft: %lu cycles, block: %lu cycles, largest error %.2f LSB, %d wrong bins\n",
+             (unsigned long)fftCycles, (unsigned long)blockCycles, maxError, wrong);
+  return wrong;
+}
@@ -0,0 +1,79 @@
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+#include <Arduino.h>
+#include <DMAChannel.h>
+#include <stdint.h>
+
+/* Audio comes in on A10 (ADC0_DP0), a pin of its own that isn't shared with the layer
+ * pins. The signal has to be biased to half of 3.3V, like a line input through a capacitor
+ * and two resistors or an electret microphone board with a DC offset. */
+#define AUDIO_PIN   A10
+/* Samples per second, a block of 256 samples takes 10ms and every bin is 100Hz wide */
+#define AUDIO_RATE  25600
+
+/* Radix-4 FFT on Q1.15 complex numbers. A complex number is packed in 32 bits, the real
+ * part in the low half and the imaginary part in the high half, so the Cortex-M4 DSP
+ * instructions work on both at once: SMUSD and SMUADX multiply by a twiddle factor and
+ * SHADD16/SHSUB16/SHASX/SHSAX do a butterfly. The halving adds keep every stage from
+ * overflowing, so the result is scaled by 1/size. */
+class FixedFFT {
+public:
+  static const int bits = 8;
+  static const int size = 1 << bits;
+  static_assert(bits % 2 == 0, "radix-4 stages need a power of 4");
+public:
+  FixedFFT();
+  // transforms size packed complex numbers in place
+  void transform(uint32_t* data) const;
+  static uint32_t pack(int16_t re, int16_t im) {
+    return ((uint32_t)(uint16_t)im << 16) | (uint16_t)re;
+  }
+  static int16_t real(uint32_t c) { return (int16_t)c; }
+  static int16_t imag(uint32_t c) { return (int16_t)(c >> 16); }
+private:
+  // e^(-2*pi*i*k/size) for the first three quarters of the circle
+  uint32_t m_twiddle[size*3/4];
+  uint8_t m_reverse[size];
+};
+
+/* Samples the audio input by DMA and splits every block into frequency bands. The PDB
+ * timer starts a conversion of ADC0 AUDIO_RATE times a second and the DMA moves every
+ * result into a ring of two blocks, so the CPU only works on whole blocks. */
+class Spectrum {
+public:
+  static const int numBands = 9;
+public:
+  Spectrum();
+  // starts sampling, does nothing when it already runs
+  void begin();
+  // analyzes the newest block when one came in since the last call, call it every frame
+  void update();
+  // loudness of a band between 0 and 1, band 0 is the lowest. Follows the music up at
+  // once and falls back slowly, scaled to the loudest band of the last seconds.
+  float level(int band);
+  // analyzes one block of 12 bit samples
+  void analyze(const uint16_t* samples);
+  /* Checks the FFT against a floating point DFT of a test signal and measures the CPU
+   * cycles of the FFT and of a whole block. Returns the number of bins that are off by
+   * more than a few LSB. */
+  int check(Print& log);
+  /* Object instance to reach the spectrum from the DMA interrupt */
+  static Spectrum* me;
+private:
+  static void dmaIsr();
+private:
+  FixedFFT m_fft;
+  DMAChannel m_dma;
+  bool m_started = false;
+  uint16_t m_ring[2*FixedFFT::size];
+  // the half of the ring that was filled last and isn't analyzed yet, -1 when none
+  volatile int m_ready = -1;
+  uint16_t m_window[FixedFFT::size];
+  uint32_t m_data[FixedFFT::size];
+  float m_levels[numBands];
+  // energy of the loudest band in dB, decays so the levels adjust to the volume
+  float m_peak;
+  // first bin of every band and the end of the last band
+  static const uint8_t m_bandEdges[numBands+1];
+};
+#endif
@@ -1,39 +1,159 @@
 #include "Util.h"
+#include "Font.h"
 #include <math.h>
 /*----------------------------------------------------------------------------------------------
  * NoiseGenerator CLASS
  *----------------------------------------------------------------------------------------------
  * This class generates numbers according to a plan. The numbers can be random, from a
  * Perlin noise like distribution or from a Gaussian distribution.
+ *
+ * Random bits come from xoshiro128** (Blackman and Vigna), which only needs 16 bytes of
+ * state, 32 bit shifts and rotates and is seedable, so every run can be repeated. Gaussian
+ * values use the Ziggurat method (Marsaglia and Tsang), which needs one random number, a
+ * table lookup and a multiply for 98% of all values. Only values outside the rectangular
+ * parts of the Ziggurat layers fall back to exp and log.
  */
+uint32_t NoiseGenerator::m_kn[128];
+float NoiseGenerator::m_wn[128];
+float NoiseGenerator::m_fn[128];
+bool NoiseGenerator::m_tables = false;
+
+NoiseGenerator::NoiseGenerator(uint32_t seed_) {
+  if(!m_tables) createTables();
+  seed(seed_);
+}
+// Expands the seed into the four state words using splitmix32, the state can't be all zero
+void NoiseGenerator::seed(uint32_t seed) {
+  for(int i=0;i<4;i++) {
+    uint32_t z = (seed += 0x9E3779B9);
+    z = (z ^ (z >> 16)) * 0x85EBCA6B;
+    z = (z ^ (z >> 13)) * 0xC2B2AE35;
+    m_state[i] = z ^ (z >> 16);
+  }
+}
+uint32_t NoiseGenerator::next() {
+  uint32_t* s = m_state;
+  uint32_t result = s[1] * 5;
+  result = ((result << 7) | (result >> 25)) * 9;
+  uint32_t t = s[1] << 9;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = (s[3] << 11) | (s[3] >> 21);
+  return result;
+}
+// Scales 32 random bits to the range with a multiply instead of a modulo (Lemire)
+int32_t NoiseGenerator::nextInt(int32_t max) {
+  if(max <= 0) return 0;
+  return ((uint64_t)next() * (uint32_t)max) >> 32;
+}
+int32_t NoiseGenerator::nextInt(int32_t min, int32_t max) {
+  if(min >= max) return min;
+  return min + nextInt(max - min);
+}
+// 24 random bits fit exactly in the mantissa of a float
 float NoiseGenerator::nextRandom(float min, float max) {
-  return min + random(1UL << 31) * (double)(max - min) / (1UL <<31);
+  return min + (next() >> 8) * (1.0f/16777215) * (max - min);
 }
 float NoiseGenerator::nextGaussian(float mean, float stdev, int range) {
   float gauss;
   do {
-	gauss = nextGaussian(mean, stdev);
+	gauss = nextNormal();
   }
-  while( (gauss > range*stdev+mean) || (gauss < -range*stdev+mean));
-  return gauss;
+  while( (gauss > range) || (gauss < -range));
+  return mean + stdev * gauss;
 }
 float NoiseGenerator::nextGaussian(float mean, float stdev) {
-  if(hasSpare) {
-	hasSpare = false;
-	return mean + stdev * spare;
+  return mean + stdev * nextNormal();
+}
+void NoiseGenerator::fillRandom(float* values, int n, float min, float max) {
+  const float scale = (max - min) * (1.0f/16777215);
+  for(int i=0;i<n;i++)
+    values[i] = min + (next() >> 8) * scale;
+}
+void NoiseGenerator::fillGaussian(float* values, int n, float mean, float stdev) {
+  for(int i=0;i<n;i++)
+    values[i] = mean + stdev * nextNormal();
+}
+// The lowest 7 bits select the layer, the other bits are the signed position in the layer
+float NoiseGenerator::nextNormal() {
+  uint32_t u = next();
+  int iz = u & 127;
+  int32_t hz = (int32_t)(u & ~127UL);
+  uint32_t ahz = hz < 0 ? -(uint32_t)hz : hz;
+  if(ahz < m_kn[iz])
+	return hz * m_wn[iz];
+  return nextNormalTail(hz, iz);
+}
+// Slow path for values in the wedges of the layers or in the tail of the distribution
+float NoiseGenerator::nextNormalTail(int32_t hz, int iz) {
+  const float r = 3.442620f;
+  for(;;) {
+	float x = hz * m_wn[iz];
+	if(iz == 0) {
+	  float y;
+	  do {
+		x = -logf(nextRandom(1e-7f, 1.0f)) / r;
+		y = -logf(nextRandom(1e-7f, 1.0f));
+	  } while(y+y < x*x);
+	  return hz > 0 ? r+x : -r-x;
+	}
+	if(m_fn[iz] + nextRandom(0, 1)*(m_fn[iz-1] - m_fn[iz]) < expf(-0.5f*x*x))
+	  return x;
+	uint32_t u = next();
+	iz = u & 127;
+	hz = (int32_t)(u & ~127UL);
+	uint32_t ahz = hz < 0 ? -(uint32_t)hz : hz;
+	if(ahz < m_kn[iz])
+	  return hz * m_wn[iz];
   }
-  hasSpare = true;
-  float u, v, s;
-  do {
-	u = (rand() / ((float) RAND_MAX)) * 2.0 - 1.0;
-	v = (rand() / ((float) RAND_MAX)) * 2.0 - 1.0;
-	s = u * u + v * v;
+}
+// Creates the 128 layers of the Ziggurat, each layer has the same area vn
+void NoiseGenerator::createTables() {
+  const double m1 = 2147483648.0;
+  const double vn = 9.91256303526217e-3;
+  double dn = 3.442619855899, tn = dn;
+  double q = vn/exp(-0.5*dn*dn);
+  m_kn[0] = (dn/q)*m1;
+  m_kn[1] = 0;
+  m_wn[0] = q/m1;
+  m_wn[127] = dn/m1;
+  m_fn[0] = 1.0f;
+  m_fn[127] = exp(-0.5*dn*dn);
+  for(int i=126;i>=1;i--) {
+	dn = sqrt(-2.0*log(vn/dn + exp(-0.5*dn*dn)));
+	m_kn[i+1] = (dn/tn)*m1;
+	tn = dn;
+	m_fn[i] = exp(-0.5*dn*dn);
+	m_wn[i] = dn/m1;
   }
-  while( (s >= 1.0) || (s == 0.0) );
+  m_tables = true;
+}
+/*----------------------------------------------------------------------------------------------
+ * CLOCK CLASS
+ *----------------------------------------------------------------------------------------------
+ * Animations and timers read the time from the clock. Freezing it makes every frame of a
+ * replay see exactly the same time steps, whatever the frame rate of the cube is.
+ */
+bool Clock::m_frozen = false;
+uint32_t Clock::m_time = 0;
 
-  s = sqrt(-2.0 * log(s) / s);
-  spare = v * s;
-  return mean + stdev * u * s;
+void Clock::tick() {
+  if(!m_frozen)
+    m_time = micros();
+}
+void Clock::freeze(uint32_t start) {
+  m_frozen = true;
+  m_time = start;
+}
+void Clock::step(uint32_t us) {
+  m_time += us;
+}
+void Clock::run() {
+  m_frozen = false;
+  m_time = micros();
 }
 /*----------------------------------------------------------------------------------------------
  * TIMER CLASS
@@ -50,39 +170,55 @@ float NoiseGenerator::nextGaussian(float mean, float stdev) {
  * Returns true if the timer has counted to 0.10 seconds
  * t.expired();
  */
-Timer::Timer() {
-  m_startTime=0;
+Timer::Timer() { }
+Timer::Timer(float seconds) {
+  operator=(seconds);
 }
-Timer::Timer(float alarm) {
-  operator=(alarm);
-}
-void Timer::operator=(float alarm) {
-  m_startTime = 0;
-  m_alarm = alarm;
+void Timer::operator=(float seconds) {
+  m_started = false;
+  m_period = seconds > 0 ? lroundf(seconds*1000000.0f) : 0;
 }
 int Timer::ticks() {
-  m_currentTime = micros();
-  if(m_startTime==0) {
+  const uint32_t now = Clock::now();
+  if(!m_started) {
+    m_started = true;
     m_ticks = 0;
-	m_startTime = m_currentTime;
-	m_lastTime = m_currentTime;
+    m_deadline = now + m_period;
   }
-  m_deltaTime = m_currentTime-m_lastTime;
-  m_runTime = m_currentTime-m_startTime;
-  m_lastTime = m_currentTime;
-
-  if(m_alarm > 0) {
-	unsigned int threshold = m_runTime/(m_alarm * 1000000.0f);
-	if(m_ticks < threshold) {
-	  m_ticks  = threshold;
-  	  return m_ticks;
-	}
-  }
-  return 0;
+  if(m_period == 0 || (int32_t)(now - m_deadline) < 0)
+    return 0;
+  // periods that ended between two calls count too
+  const uint32_t ended = 1 + (now - m_deadline)/m_period;
+  m_ticks += ended;
+  m_deadline += ended*m_period;
+  return m_ticks;
 }
 bool Timer::expired() {
   ticks(); return (m_ticks!=0);
 }
+/*----------------------------------------------------------------------------------------------
+ * TEXTSTRIP CLASS
+ *----------------------------------------------------------------------------------------------
+ * Text rasterized once into a strip of 8 pixel high columns, so scrollers only need to look
+ * up a column instead of picking bits out of the font for every pixel of every frame. The
+ * font stores rows with bit x being column x, the strip stores columns with bit y being
+ * row y counted from the bottom.
+ */
+void TextStrip::setText(const char* text) {
+  m_numChars = 0;
+  while(text[m_numChars] && m_numChars < maxChars) {
+    uint8_t chr = text[m_numChars] & 0x7F;
+    m_text[m_numChars] = chr;
+    uint8_t* col = m_strip + m_numChars*8;
+    for(int x=0;x<8;x++) {
+      uint8_t bits = 0;
+      for(int y=0;y<8;y++)
+        if(charset[chr][7-y] & (1<<x)) bits |= 1<<y;
+      col[x] = bits;
+    }
+    m_numChars++;
+  }
+}
 /*----------------------------------------------------------------------------------------------
  * OBJECT CLASS
  *----------------------------------------------------------------------------------------------
@@ -4,33 +4,99 @@
 #include "Quaternion.h"
 
 class NoiseGenerator {
-private:
-  bool hasSpare = false;
-  float spare;
 public:
+  NoiseGenerator(uint32_t seed = 0x2545F491);
+  // restart the random sequence from the given seed
+  void seed(uint32_t seed);
+  // get the next 32 random bits
+  uint32_t next();
+  // get a random integer between 0 and max (max excluded), same as Arduino random(max)
+  int32_t nextInt(int32_t max);
+  // get a random integer between min and max (max excluded), same as random(min, max)
+  int32_t nextInt(int32_t min, int32_t max);
   // get next normally divided value with given mean and stdev
   float nextGaussian(float mean, float stdev);
   // nextGaussian but with a max deviation of range * stdev
   float nextGaussian(float mean, float stdev, int range);
   // get a random float value between min and max (boundaries included)
   float nextRandom(float min, float max);
+  // fill an array with random values between min and max
+  void fillRandom(float* values, int n, float min, float max);
+  // fill an array with normally divided values with given mean and stdev
+  void fillGaussian(float* values, int n, float mean, float stdev);
+private:
+  // get a normally divided value with mean 0 and stdev 1
+  float nextNormal();
+  float nextNormalTail(int32_t hz, int iz);
+  static void createTables();
+private:
+  // xoshiro128** state
+  uint32_t m_state[4];
+  // Ziggurat layer boundaries, widths and heights of the normal distribution
+  static uint32_t m_kn[128];
+  static float m_wn[128];
+  static float m_fn[128];
+  static bool m_tables;
+};
+
+/* Time in microseconds for animations and timers. The cube reads micros() once at the start
+ * of every frame, so everything in a frame sees the same time and timers don't each read
+ * the hardware. A frozen clock only moves on step() so animations can be replayed with the
+ * same time steps. The time wraps after 71 minutes, so times are only ever compared by
+ * their difference. */
+class Clock {
+public:
+  static uint32_t now() { return m_time; }
+  // take the time for the next frame from micros(), does nothing when the clock is frozen
+  static void tick();
+  // stop following micros(), the clock stays at start until step is called
+  static void freeze(uint32_t start);
+  static void step(uint32_t us);
+  // follow micros() again
+  static void run();
+private:
+  static bool m_frozen;
+  static uint32_t m_time;
 };
 
+/* Counts periods from the first call of ticks or expired. The period is kept in whole
+ * microseconds and the timer only compares the clock with the end of the running period,
+ * it only divides when a period has ended. */
 class Timer {
 public:
   Timer();
-  Timer(float);
-  void operator=(float);
+  Timer(float seconds);
+  void operator=(float seconds);
+  // the number of periods since the start when a period ended since the last call, else 0
   int ticks();
+  // true once the first period has ended
   bool expired();
 private:
-  float m_alarm = 0;
+  // 0 never ticks
+  uint32_t m_period = 0;
+  // time the running period ends
+  uint32_t m_deadline = 0;
   unsigned int m_ticks = 0;
-  unsigned long m_startTime = 0;
-  unsigned long m_lastTime = 0;
-  unsigned long m_currentTime = 0;
-  unsigned long m_deltaTime = 0;
-  unsigned long m_runTime = 0;
+  bool m_started = false;
+};
+
+class TextStrip {
+public:
+  static const int maxChars = 64;
+public:
+  // rasterize text into the strip, text longer than maxChars is cut off
+  void setText(const char* text);
+  // number of characters and columns (8 per character) in the strip
+  int characters() const { return m_numChars; }
+  int columns() const { return m_numChars*8; }
+  // bit y of a column is the pixel at height y
+  uint8_t column(int c) const { return m_strip[c]; }
+  // the character a column belongs to
+  char character(int c) const { return m_text[c/8]; }
+private:
+  int m_numChars = 0;
+  char m_text[maxChars];
+  uint8_t m_strip[maxChars*8];
 };
 
 class Object {
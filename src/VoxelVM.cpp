@@ -0,0 +1,243 @@
+#include "VoxelVM.h"
+#include <EEPROM.h>
+#include <math.h>
+/*----------------------------------------------------------------------------------------------
+ * VOXELVM CLASS
+ *----------------------------------------------------------------------------------------------
+ * The stack holds a value for every lane, so an instruction is a loop over the lanes of the
+ * slice. Products and quotients go through 64 bits, the sine is looked up in a table of a
+ * turn and interpolated between its steps, the square root uses the FPU.
+ */
+namespace {
+// values every instruction takes from and puts on the stack
+struct Effect {
+  int8_t pops;
+  int8_t pushes;
+};
+const Effect effects[VoxelVM::numOpcodes] = {
+  {0, 1}, {0, 1}, {0, 1}, {0, 1}, {0, 1}, {1, 2}, {1, 0}, {2, 2}, {2, 3},  // PUSH .. OVER
+  {2, 1}, {2, 1}, {2, 1}, {2, 1}, {2, 1}, {2, 1}, {2, 1},                  // ADD .. LESS
+  {1, 1}, {1, 1}, {1, 1}, {1, 1}, {1, 1}, {1, 1}, {1, 1}, {4, 1},          // NEG .. NOISE
+  {2, 0}, {3, 0}};                                                         // PALETTE, RGB
+// program in EEPROM: 'VXP1', length (2 bytes, LSB first), code
+const int storeHeader = 6;
+const int ONE = 65536;
+}
+
+int32_t VoxelVM::m_sine[257];
+bool VoxelVM::m_tables = false;
+
+VoxelVM::VoxelVM() {
+  if(!m_tables) {
+    for(int i=0;i<257;i++)
+      m_sine[i] = lroundf(ONE*sinf(2*PI*i/256));
+    m_tables = true;
+  }
+  for(int y=0;y<Y_LAYERS;y++)
+  for(int z=0;z<Z_LAYERS;z++) {
+    m_y[y*Z_LAYERS + z] = y*ONE;
+    m_z[y*Z_LAYERS + z] = z*ONE;
+  }
+}
+
+bool VoxelVM::validate(const uint8_t* code, int length) {
+  if(length <= 0 || length > maxCode)
+    return false;
+  int depth = 0;
+  int pc = 0;
+  while(pc < length) {
+    const uint8_t op = code[pc++];
+    if(op >= numOpcodes)
+      return false;
+    if(op == OP_PUSH) {
+      pc += 4;
+      if(pc > length)
+        return false;
+    }
+    if(depth < effects[op].pops)
+      return false;
+    depth += effects[op].pushes - effects[op].pops;
+    if(depth > maxStack)
+      return false;
+    if(op == OP_PALETTE || op == OP_RGB)
+      return pc == length && depth == 0;
+  }
+  // no output at the end
+  return false;
+}
+
+bool VoxelVM::load(const uint8_t* code, int length) {
+  m_length = 0;
+  if(!validate(code, length))
+    return false;
+  memcpy(m_code, code, length);
+  m_length = length;
+  return true;
+}
+
+bool VoxelVM::store(const uint8_t* code, int length) {
+  if(!validate(code, length) || storeHeader + length > EEPROM.length())
+    return false;
+  const uint8_t header[storeHeader] = { 'V', 'X', 'P', '1',
+                                        uint8_t(length), uint8_t(length >> 8) };
+  // update only writes the bytes that changed, that saves the flash
+  for(int i=0;i<storeHeader;i++)
+    EEPROM.update(i, header[i]);
+  for(int i=0;i<length;i++)
+    EEPROM.update(storeHeader + i, code[i]);
+  return true;
+}
+
+int VoxelVM::restore(uint8_t* code) {
+  if(EEPROM.read(0) != 'V' || EEPROM.read(1) != 'X' || EEPROM.read(2) != 'P' ||
+     EEPROM.read(3) != '1')
+    return 0;
+  const int length = EEPROM.read(4) | (EEPROM.read(5) << 8);
+  if(length <= 0 || length > maxCode)
+    return 0;
+  for(int i=0;i<length;i++)
+    code[i] = EEPROM.read(storeHeader + i);
+  return validate(code, length) ? length : 0;
+}
+
+// instructions on the top value, or on the two top values that leave one
+#define UNARY(expression) { \
+    int32_t* a = m_stack[sp-1]; \
+    for(int i=0;i<lanes;i++) a[i] = (expression); \
+  } break
+#define BINARY(expression) { \
+    sp--; \
+    int32_t* a = m_stack[sp-1]; \
+    const int32_t* b = m_stack[sp]; \
+    for(int i=0;i<lanes;i++) a[i] = (expression); \
+  } break
+
+namespace {
+inline int32_t sine(const int32_t* table, int32_t turns) {
+  const int index = (turns >> 8) & 0xFF;
+  const int32_t step = turns & 0xFF;
+  return table[index] + (((table[index+1] - table[index])*step) >> 8);
+}
+}
+
+void VoxelVM::run(Frame& frame, ColorWheel& wheel, float t) {
+  const int32_t time = t*ONE;
+  for(int x=0;x<X_LAYERS;x++) {
+    int sp = 0;
+    int pc = 0;
+    while(pc < m_length) {
+      const uint8_t op = m_code[pc++];
+      switch(op) {
+      case OP_PUSH: {
+        const int32_t c = m_code[pc] | (m_code[pc+1] << 8) | (m_code[pc+2] << 16) |
+                          ((uint32_t)m_code[pc+3] << 24);
+        pc += 4;
+        int32_t* a = m_stack[sp++];
+        for(int i=0;i<lanes;i++) a[i] = c;
+      } break;
+      case OP_X: {
+        int32_t* a = m_stack[sp++];
+        for(int i=0;i<lanes;i++) a[i] = x*ONE;
+      } break;
+      case OP_Y: memcpy(m_stack[sp++], m_y, sizeof(m_y)); break;
+      case OP_Z: memcpy(m_stack[sp++], m_z, sizeof(m_z)); break;
+      case OP_T: {
+        int32_t* a = m_stack[sp++];
+        for(int i=0;i<lanes;i++) a[i] = time;
+      } break;
+      case OP_DUP: memcpy(m_stack[sp], m_stack[sp-1], sizeof(m_stack[0])); sp++; break;
+      case OP_DROP: sp--; break;
+      case OP_SWAP: {
+        int32_t* a = m_stack[sp-2];
+        int32_t* b = m_stack[sp-1];
+        for(int i=0;i<lanes;i++) {
+          int32_t v = a[i];
+          a[i] = b[i];
+          b[i] = v;
+        }
+      } break;
+      case OP_OVER: memcpy(m_stack[sp], m_stack[sp-2], sizeof(m_stack[0])); sp++; break;
+      case OP_ADD:   BINARY(a[i] + b[i]);
+      case OP_SUB:   BINARY(a[i] - b[i]);
+      case OP_MUL:   BINARY(((int64_t)a[i]*b[i]) >> 16);
+      case OP_DIV:   BINARY(b[i] ? (int32_t)(((int64_t)a[i] << 16)/b[i]) : 0);
+      case OP_MIN:   BINARY(a[i] < b[i] ? a[i] : b[i]);
+      case OP_MAX:   BINARY(a[i] > b[i] ? a[i] : b[i]);
+      case OP_LESS:  BINARY(a[i] < b[i] ? ONE : 0);
+      case OP_NEG:   UNARY(-a[i]);
+      case OP_ABS:   UNARY(a[i] < 0 ? -a[i] : a[i]);
+      case OP_FLOOR: UNARY(a[i] & ~0xFFFF);
+      case OP_FRACT: UNARY(a[i] & 0xFFFF);
+      // sqrt(a/65536)*65536
+      case OP_SQRT:  UNARY(a[i] > 0 ? (int32_t)(sqrtf(a[i])*256) : 0);
+      case OP_SIN:   UNARY(sine(m_sine, a[i]));
+      case OP_COS:   UNARY(sine(m_sine, a[i] + ONE/4));
+      case OP_NOISE: {
+        sp -= 3;
+        int32_t* a = m_stack[sp-1];
+        const int32_t* b = m_stack[sp];
+        const int32_t* c = m_stack[sp+1];
+        const int32_t* d = m_stack[sp+2];
+        for(int i=0;i<lanes;i++) a[i] = m_noise.noise(a[i], b[i], c[i], d[i]);
+      } break;
+      case OP_PALETTE:
+      case OP_RGB:
+        output(op, sp, &frame[x][0][0], wheel);
+        sp = 0;
+        break;
+      }
+    }
+  }
+}
+#undef UNARY
+#undef BINARY
+
+// Dark voxels are left alone, the canvas is cleared before every frame
+void VoxelVM::output(uint8_t op, int sp, Voxel* slice, ColorWheel& wheel) {
+  if(op == OP_PALETTE) {
+    const int32_t* position = m_stack[sp-2];
+    const int32_t* brightness = m_stack[sp-1];
+    for(int i=0;i<lanes;i++) {
+      int32_t b = brightness[i];
+      if(b <= 0) continue;
+      Color c = wheel.color(position[i]*(1.0f/ONE));
+      if(b < ONE) {
+        c.R = (c.R*b) >> 16;
+        c.G = (c.G*b) >> 16;
+        c.B = (c.B*b) >> 16;
+      }
+      slice[i] = c;
+    }
+  } else {
+    int32_t* channel[3] = { m_stack[sp-3], m_stack[sp-2], m_stack[sp-1] };
+    for(int i=0;i<lanes;i++) {
+      uint16_t rgb[3];
+      for(int k=0;k<3;k++) {
+        int32_t v = channel[k][i];
+        rgb[k] = v <= 0 ? 0 : (v >= ONE ? 4095 : (v*4095) >> 16);
+      }
+      if(rgb[0] | rgb[1] | rgb[2])
+        slice[i] = Color(rgb[0], rgb[1], rgb[2]);
+    }
+  }
+}
+
+const uint8_t VoxelVM::rainbow[] = {
+  0x01, 0x00, 0x1F, 0x05, 0x00, 0x00, 0x0B, 0x02, 0x00, 0x8F, 0x02, 0x00,
+  0x00, 0x0B, 0x09, 0x03, 0x00, 0x48, 0x01, 0x00, 0x00, 0x0B, 0x09, 0x04,
+  0x00, 0x9A, 0x19, 0x00, 0x00, 0x0B, 0x09, 0x00, 0x00, 0x00, 0x01, 0x00,
+  0x04, 0x00, 0x22, 0x02, 0x00, 0x00, 0x09, 0x00, 0x9A, 0x19, 0x00, 0x00,
+  0x0B, 0x16, 0x0A, 0x00, 0xD0, 0x87, 0x00, 0x00, 0x0B, 0x09, 0x00, 0x00,
+  0x00, 0x01, 0x00, 0x18
+};
+const int VoxelVM::rainbowLength = sizeof(rainbow);
+const uint8_t VoxelVM::sinus[] = {
+  0x01, 0x00, 0x00, 0x00, 0x04, 0x00, 0x0A, 0x00, 0x00, 0x80, 0x00, 0x00,
+  0x0B, 0x05, 0x0B, 0x03, 0x00, 0x00, 0x00, 0x04, 0x00, 0x0A, 0x00, 0x00,
+  0x80, 0x00, 0x00, 0x0B, 0x05, 0x0B, 0x09, 0x14, 0x00, 0xBE, 0x28, 0x00,
+  0x00, 0x0B, 0x04, 0x00, 0x00, 0x80, 0x00, 0x00, 0x0B, 0x09, 0x15, 0x00,
+  0x00, 0x00, 0x04, 0x00, 0x0B, 0x00, 0x00, 0x80, 0x04, 0x00, 0x09, 0x12,
+  0x05, 0x02, 0x0A, 0x11, 0x00, 0x00, 0x80, 0x00, 0x00, 0x0F, 0x07, 0x00,
+  0x8F, 0x02, 0x00, 0x00, 0x0B, 0x07, 0x18
+};
+const int VoxelVM::sinusLength = sizeof(sinus);
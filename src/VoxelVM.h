@@ -0,0 +1,74 @@
+#ifndef VOXELVM_H
+#define VOXELVM_H
+#include <Arduino.h>
+#include "Color.h"
+#include "Noise.h"
+#include "OctadecaTLC5940.h"
+
+/* A small stack machine that computes the color of every voxel from a program, so new
+ * effects can be uploaded over USB serial instead of flashed. tools/cubeasm.py turns text
+ * into programs and uploads them.
+ *
+ * All numbers are Q16.16 fixed point (65536 = 1.0). Every instruction is one byte, PUSH is
+ * followed by its constant in 4 bytes LSB first. Angles are in turns, 1.0 is a full circle.
+ * Stack effects are written as (before -- after), the top of the stack is on the right.
+ *
+ *   PUSH c   ( -- c)        X Y Z    ( -- coordinate)    T  ( -- seconds since start)
+ *   DUP      (a -- a a)     DROP     (a -- )             SWAP (a b -- b a)
+ *   OVER     (a b -- a b a)
+ *   ADD SUB MUL DIV MIN MAX LESS (a b -- a+b a-b a*b a/b min max a<b?1:0)
+ *   NEG ABS FLOOR FRACT SQRT SIN COS (a -- result)
+ *   NOISE    (x y z w -- simplex noise between -1 and 1)
+ *   PALETTE  (position brightness -- ) color of the color wheel, dimmed by brightness
+ *   RGB      (r g b -- ) channels between 0 and 1
+ *
+ * A program ends with PALETTE or RGB and leaves nothing on the stack. Programs are checked
+ * when they are loaded, so the interpreter doesn't need to check anything.
+ *
+ * The interpreter runs every instruction on a whole slice of the cube at once: all voxels
+ * with the same x, so the cost of decoding an instruction is shared by 81 voxels. */
+class VoxelVM {
+public:
+  enum Opcode : uint8_t {
+    OP_PUSH, OP_X, OP_Y, OP_Z, OP_T, OP_DUP, OP_DROP, OP_SWAP, OP_OVER,
+    OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MIN, OP_MAX, OP_LESS,
+    OP_NEG, OP_ABS, OP_FLOOR, OP_FRACT, OP_SQRT, OP_SIN, OP_COS, OP_NOISE,
+    OP_PALETTE, OP_RGB, numOpcodes
+  };
+  static const int maxCode = 256;
+  static const int maxStack = 8;
+  static const int lanes = Y_LAYERS*Z_LAYERS;
+public:
+  VoxelVM();
+  // checks and loads a program, returns false when it is malformed
+  bool load(const uint8_t* code, int length);
+  bool loaded() const { return m_length > 0; }
+  // renders a frame of the loaded program at time t in seconds
+  void run(Frame& frame, ColorWheel& wheel, float t);
+  // checks a program without loading it
+  static bool validate(const uint8_t* code, int length);
+  // keeps a program in EEPROM, so it survives a reset
+  static bool store(const uint8_t* code, int length);
+  // reads the stored program into code, returns its length or 0 when there is none
+  static int restore(uint8_t* code);
+public:
+  // the same effects as the Rainbow and Sinus animations, see tools/programs
+  static const uint8_t rainbow[];
+  static const int rainbowLength;
+  static const uint8_t sinus[];
+  static const int sinusLength;
+private:
+  void output(uint8_t op, int sp, Voxel* slice, ColorWheel& wheel);
+private:
+  uint8_t m_code[maxCode];
+  int m_length = 0;
+  int32_t m_stack[maxStack][lanes];
+  // y and z of every lane
+  int32_t m_y[lanes];
+  int32_t m_z[lanes];
+  SimplexNoise m_noise;
+  // a turn of the sine in 256 steps and one extra for interpolating the last step
+  static int32_t m_sine[257];
+  static bool m_tables;
+};
+#endif
@@ -2,17 +2,60 @@
 #include "Cube.h"
 #include "Color.h"
 #include "Util.h"
+#include "Scheduler.h"
+#include "Spectrum.h"
 /*---------------------------------------------------------------------------------------
  * Globals
  *-------------------------------------------------------------------------------------*/
-Cube cube(9,9,9);
+Cube cube;
 ColorWheel colorwheel(150);
 NoiseGenerator generator;
+Scheduler scheduler;
+#ifdef AUDIO_INPUT
+Spectrum spectrum;
+#endif
+/*---------------------------------------------------------------------------------------
+ * Background tasks, run while the cube waits for the next frame to be displayed
+ *-------------------------------------------------------------------------------------*/
+void idle() {
+  scheduler.run();
+}
+#ifdef TIMING_STATS
+// the longest interrupt runs and task delays of the last second
+void printStats() {
+  Serial.printf("latch %lu prepare %lu jitter %lu cycles, task lateness %lu us\n",
+                (unsigned long)cube.latchCycles(), (unsigned long)cube.prepareCycles(),
+                (unsigned long)cube.latchJitter(), scheduler.maxLateness());
+  cube.resetStats();
+  scheduler.resetStats();
+}
+#endif
+#ifdef MIRROR
+/* Sends what the cube shows to a PC, at most MIRROR frames per second and only while the
+ * last frame isn't still being written, see tools/cubemirror.py. The displayed cube is
+ * copied first and the copy is thrown away when the display took a new frame meanwhile. */
+FrameSender mirror;
+Frame mirrorFrame;
+uint32_t mirroredFrames = 0;
+void mirrorDisplay() {
+  if(!mirror.flush(Serial))
+    return;
+  const uint32_t frames = cube.frames();
+  if(frames == mirroredFrames)
+    return;
+  memcpy(mirrorFrame, cube.getDisplayedCube(), sizeof(Frame));
+  if(cube.frames() != frames)
+    return;
+  // a keyframe every 64 frames, for a PC that starts listening later
+  mirror.send(mirrorFrame, frames/64 != mirroredFrames/64);
+  mirroredFrames = frames;
+  mirror.flush(Serial);
+}
+#endif
 /*---------------------------------------------------------------------------------------
  * Initialize setup parameters
  *-------------------------------------------------------------------------------------*/
 void setup() {
-  cube.begin();
   colorwheel.add(Color::RED);
   colorwheel.add(Color::GREEN);
   colorwheel.add(Color::BLUE);
@@ -20,6 +63,43 @@ void setup() {
   colorwheel.add(Color::GREEN);
   colorwheel.add(Color::BLUE);
   colorwheel.add(Color::BLACK);
+#ifdef DRIVER_CHECK
+  // check the led channel map and time the packer before the display starts
+  while(!Serial && millis() < 5000);
+  cube.check(Serial);
+#endif
+#if defined(AUDIO_INPUT) && defined(AUDIO_CHECK)
+  // check the FFT against a DFT and report the cycles per block
+  while(!Serial && millis() < 5000);
+  spectrum.check(Serial);
+#endif
+#ifdef LAYER_BUDGET
+  // dim layers that would draw more than this part of a completely white layer
+  cube.setLayerBudget(LAYER_BUDGET);
+#endif
+#ifdef BENCHMARK
+  // time every animation and the kernels they use, tools/cubebench.py keeps the results
+  while(!Serial && millis() < 5000);
+  cube.benchmark(Serial);
+#endif
+  cube.begin();
+  cube.setIdle(idle);
+#ifdef TIMING_STATS
+  scheduler.add(printStats, 1000000);
+#endif
+#ifdef MIRROR
+  scheduler.add(mirrorDisplay, 1000000/MIRROR);
+#endif
+#ifdef GOLDEN_FRAMES
+  // give the serial monitor some time to connect, then check all animations
+  while(!Serial && millis() < 5000);
+  cube.verify(Serial, "golden.dig");
+#endif
+#ifdef VM_CHECK
+  // compare the bytecode programs with the animations they copy and report their speed
+  while(!Serial && millis() < 5000);
+  Bytecode::check(Serial);
+#endif
 }
 /*---------------------------------------------------------------------------------------
  * Start the main loop
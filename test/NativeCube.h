@@ -0,0 +1,92 @@
+#ifndef NATIVE_CUBE_H
+#define NATIVE_CUBE_H
+/* The globals of main.cpp for the native tests, include this in one file of a test. The
+ * display interrupts run while update waits, see nativeDisplay in kinetis.h, so animations
+ * and replays work as on the cube. */
+#include <string>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include "Cube.h"
+#include "Scheduler.h"
+#include "Spectrum.h"
+
+Cube cube;
+ColorWheel colorwheel(150);
+NoiseGenerator generator;
+Scheduler scheduler;
+#ifdef AUDIO_INPUT
+Spectrum spectrum;
+#endif
+
+// the colors of setup() in main.cpp, and the display interrupts for update
+inline void beginCube() {
+  static bool begun = false;
+  if(begun)
+    return;
+  begun = true;
+  colorwheel.add(Color::RED);
+  colorwheel.add(Color::GREEN);
+  colorwheel.add(Color::BLUE);
+  colorwheel.add(Color::RED);
+  colorwheel.add(Color::GREEN);
+  colorwheel.add(Color::BLUE);
+  colorwheel.add(Color::BLACK);
+  cube.setIdle(nativeDisplay);
+}
+
+// path of a file in the project, tests may run from another directory
+inline std::string projectPath(const char* name) {
+  std::string path = __FILE__;
+  const size_t slash = path.find_last_of('/');
+  path = slash == std::string::npos ? std::string(".") : path.substr(0, slash);
+  return path + "/../" + name;
+}
+
+// true when the tools can run, the tests that need them are ignored otherwise
+inline bool hasPython() {
+  return system("python3 -c '' 2>/dev/null") == 0;
+}
+
+// a raw pseudo terminal for Serial.open, the tools open ptsname(master) as their port. The
+// slave side is kept open so the tools can't hang it up, close both when done.
+inline bool openTerminal(int& master, int& slave) {
+  master = posix_openpt(O_RDWR | O_NOCTTY);
+  if(master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+    return false;
+  slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+  if(slave < 0)
+    return false;
+  termios settings;
+  tcgetattr(slave, &settings);
+  cfmakeraw(&settings);
+  return tcsetattr(slave, TCSANOW, &settings) == 0;
+}
+
+// frame t of demo_frame in tools/cubestream.py, a tilted plane sweeping through the cube
+inline void demoFrame(double t, Frame& frame) {
+  for(int x=0;x<X_LAYERS;x++)
+  for(int y=0;y<Y_LAYERS;y++)
+  for(int z=0;z<Z_LAYERS;z++) {
+    const double h = 4 + 4*sin(t + (x+z)*0.3);
+    if(fabs(y - h) < 0.6)
+      frame[x][y][z] = Color(0xFFF*x/8, 0x400, 0xFFF*z/8);
+    else
+      frame[x][y][z] = Color(0, 0, 0);
+  }
+}
+
+// keeps what is printed, for checking the reports of the cube
+class PrintLog : public Print {
+public:
+  std::string text;
+  size_t write(uint8_t b) { text += (char)b; return 1; }
+  using Print::write;
+  int count(const char* s) const {
+    int n = 0;
+    for(size_t i = text.find(s); i != std::string::npos; i = text.find(s, i + 1))
+      n++;
+    return n;
+  }
+};
+#endif
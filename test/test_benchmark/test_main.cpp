@@ -0,0 +1,48 @@
+#include <unity.h>
+#include "../NativeCube.h"
+/* Runs Cube::benchmark on the PC and prints its JSON lines, for tools/cubebench.py. The
+ * cycles are the time the PC took counted at F_CPU, they only compare with other runs on
+ * the same PC, and kernels that take less than a cycle show 0. Cycles on the Teensy come
+ * from a build with -D BENCHMARK. */
+namespace {
+#define NAMES(...) #__VA_ARGS__
+#define EXPANDED_NAMES(...) NAMES(__VA_ARGS__)
+const char playlistNames[] = EXPANDED_NAMES(PLAYLIST);
+PrintLog results;
+}
+
+void setUp() {
+  beginCube();
+}
+
+void tearDown() {}
+
+void test_benchmark_runs_every_animation() {
+  cube.benchmark(results);
+  Serial.write((const uint8_t*)results.text.data(), results.text.size());
+  std::string names = std::string(playlistNames) + ", Fireworks, Tree";
+  for(size_t start = 0; start < names.size();) {
+    size_t end = names.find(',', start);
+    if(end == std::string::npos)
+      end = names.size();
+    while(names[start] == ' ')
+      start++;
+    const std::string name = "{\"name\":\"" + names.substr(start, end - start) + "\"";
+    TEST_ASSERT_EQUAL_MESSAGE(1, results.count(name.c_str()), name.c_str());
+    start = end + 1;
+  }
+}
+
+void test_packer_is_the_last_result() {
+  // tools/cubebench.py stops reading at the packer
+  const char* packer = "{\"name\":\"setChannelBuffer\",";
+  const size_t last = results.text.rfind("{\"name\":");
+  TEST_ASSERT_EQUAL(0, results.text.compare(last, strlen(packer), packer));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_benchmark_runs_every_animation);
+  RUN_TEST(test_packer_is_the_last_result);
+  return UNITY_END();
+}
@@ -0,0 +1,93 @@
+#include <unity.h>
+#include <vector>
+#include "../NativeCube.h"
+/* Timers and animations across the wrap of the 32 bit clock, which micros() reaches after
+ * 71 minutes. The clock is frozen a little before the wrap and stepped over it. */
+namespace {
+const uint32_t beforeWrap = 0xFFFF0000;
+
+// keeps the time step of every frame
+class StepRecorder : public Animation {
+public:
+  std::vector<float> steps;
+private:
+  void init() { }
+  void draw(float dt) { steps.push_back(dt); }
+};
+}
+
+void setUp() {
+  Clock::freeze(beforeWrap);
+}
+
+void tearDown() {
+  Clock::run();
+}
+
+void test_timer_counts_across_the_wrap() {
+  // 10 ms periods in 1 ms frames, the clock wraps after 65.536 ms
+  Timer timer = 0.01f;
+  timer.ticks();
+  int fired = 0;
+  for(int frame=1;frame<=200;frame++) {
+    Clock::step(1000);
+    const int ticks = timer.ticks();
+    if(frame % 10) {
+      TEST_ASSERT_EQUAL(0, ticks);
+    } else {
+      // every deadline fires once, in the frame it is reached
+      fired++;
+      TEST_ASSERT_EQUAL(frame/10, ticks);
+    }
+  }
+  TEST_ASSERT_EQUAL(20, fired);
+}
+
+void test_deadline_after_the_wrap_fires_once() {
+  // the deadline is 1 ms later, past the wrap while the clock is still before it
+  Clock::freeze(0xFFFFFF00);
+  Timer timer = 0.001f;
+  TEST_ASSERT_FALSE(timer.expired());
+  int fired = 0;
+  for(int frame=1;frame<20;frame++) {
+    Clock::step(100);
+    fired += timer.ticks() != 0;
+    TEST_ASSERT_EQUAL(frame >= 10, timer.expired());
+  }
+  TEST_ASSERT_EQUAL(1, fired);
+}
+
+void test_missed_periods_count_across_the_wrap() {
+  // a frame that takes 3.5 periods and crosses the wrap 2 periods in counts all of them
+  Clock::freeze(0xFFFFF830);
+  Timer timer = 0.001f;
+  timer.ticks();
+  Clock::step(3500);
+  TEST_ASSERT_EQUAL(3, timer.ticks());
+  Clock::step(499);
+  TEST_ASSERT_EQUAL(0, timer.ticks());
+  Clock::step(1);
+  TEST_ASSERT_EQUAL(4, timer.ticks());
+}
+
+void test_animation_step_has_no_spike_at_the_wrap() {
+  StepRecorder recorder;
+  // 60 frames per second for 2 seconds, the wrap comes after 4 frames
+  for(int frame=0;frame<120;frame++) {
+    recorder.animate();
+    Clock::step(16667);
+  }
+  TEST_ASSERT_EQUAL(120, (int)recorder.steps.size());
+  TEST_ASSERT_EQUAL_FLOAT(0, recorder.steps[0]);
+  for(size_t f=1;f<recorder.steps.size();f++)
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, 0.016667f, recorder.steps[f]);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_timer_counts_across_the_wrap);
+  RUN_TEST(test_deadline_after_the_wrap_fires_once);
+  RUN_TEST(test_missed_periods_count_across_the_wrap);
+  RUN_TEST(test_animation_step_has_no_spike_at_the_wrap);
+  return UNITY_END();
+}
@@ -0,0 +1,159 @@
+#include <unity.h>
+#include "../NativeCube.h"
+#include "FrameCodec.h"
+/* The frame codec against the encoder of the PC. demo.vxstream holds the first 40 frames
+ * of tools/cubestream.py at 60 fps, written with
+ *   python3 tools/cubestream.py --output test/test_codec/demo.vxstream --frames 40
+ * a keyframe followed by deltas made by encode_delta. */
+namespace {
+const int streamFrames = 40;
+const double fps = 60;
+
+// bytes in memory as a Stream, like Serial with everything already received
+class ByteStream : public Stream {
+public:
+  std::string bytes;
+  size_t position = 0;
+  int available() { return bytes.size() - position; }
+  int read() { return position < bytes.size() ? (uint8_t)bytes[position++] : -1; }
+  int peek() { return position < bytes.size() ? (uint8_t)bytes[position] : -1; }
+  size_t write(uint8_t b) { bytes += (char)b; return 1; }
+  using Print::write;
+};
+
+Frame previous, frame, expected;
+
+bool same(const Frame& a, const Frame& b) {
+  return memcmp(&a, &b, sizeof(Frame)) == 0;
+}
+
+std::string readStream() {
+  SD.setRoot(projectPath("test/test_codec").c_str());
+  File file = SD.open("demo.vxstream");
+  std::string bytes;
+  for(int c = file.read(); c >= 0; c = file.read())
+    bytes += (char)c;
+  return bytes;
+}
+
+// decodes every frame of stream and checks it against the demo, returns the frames
+int decodeDemo(Stream& stream) {
+  FrameReceiver receiver;
+  memset(&previous, 0, sizeof(previous));
+  int n = 0;
+  while(receiver.receive(stream)) {
+    TEST_ASSERT_TRUE(FrameCodec::decode(receiver.type(), receiver.payload(), receiver.length(),
+                                        previous, frame));
+    demoFrame(n/fps*2, expected);
+    TEST_ASSERT_TRUE_MESSAGE(same(expected, frame), "decoded frame differs from the demo");
+    memcpy(&previous, &frame, sizeof(Frame));
+    n++;
+  }
+  return n;
+}
+
+// a frame with runs of every kind against the frame before it
+void randomFrame(Frame& f) {
+  Voxel* v = &f[0][0][0];
+  int i = 0;
+  while(i < FrameCodec::voxels) {
+    const int n = random(1, 100);
+    const Color c(random(4096), random(4096), random(4096));
+    const bool keep = random(3) == 0;
+    for(int j=0;j<n && i<FrameCodec::voxels;j++,i++)
+      if(!keep)
+        v[i] = random(2) ? c : Color(random(4096), random(4096), random(4096));
+  }
+}
+}
+
+void setUp() {
+  beginCube();
+}
+
+void tearDown() {
+  SD.setRoot(".");
+}
+
+void test_decodes_the_stream_of_the_pc() {
+  SD.setRoot(projectPath("test/test_codec").c_str());
+  File file = SD.open("demo.vxstream");
+  TEST_ASSERT_TRUE(file);
+  TEST_ASSERT_EQUAL(streamFrames, decodeDemo(file));
+}
+
+void test_skips_bytes_between_frames() {
+  // text the cube or a terminal adds, with sync bytes that don't start a frame
+  const std::string bytes = readStream();
+  ByteStream stream;
+  stream.bytes = "VVX\x01garbage\n";
+  for(size_t i = 0; i < bytes.size(); ) {
+    const size_t length = 5 + ((uint8_t)bytes[i+3] | (uint8_t)bytes[i+4] << 8) + 1;
+    stream.bytes += bytes.substr(i, length) + "V\r\nXV";
+    i += length;
+  }
+  TEST_ASSERT_EQUAL(streamFrames, decodeDemo(stream));
+}
+
+void test_encodes_like_the_pc() {
+#ifdef FRAMEBUFFER_8BIT
+  TEST_IGNORE_MESSAGE("8 bit voxels send rounded colors");
+#endif
+  const std::string bytes = readStream();
+  static uint8_t data[FrameCodec::maxPayload];
+  size_t i = 0;
+  for(int n=0;n<streamFrames;n++) {
+    demoFrame(n/fps*2, frame);
+    uint8_t type;
+    const int length = FrameCodec::encode(frame, n ? &previous : nullptr, data, type);
+    TEST_ASSERT_EQUAL(bytes[i+2], type);
+    TEST_ASSERT_EQUAL((uint8_t)bytes[i+3] | (uint8_t)bytes[i+4] << 8, length);
+    TEST_ASSERT_EQUAL_MEMORY(bytes.data() + i + 5, data, length);
+    i += 5 + length + 1;
+    memcpy(&previous, &frame, sizeof(Frame));
+  }
+  TEST_ASSERT_EQUAL(bytes.size(), i);
+}
+
+void test_round_trip() {
+  static uint8_t data[FrameCodec::maxPayload];
+  randomSeed(3);
+  memset(&previous, 0, sizeof(previous));
+  int deltas = 0;
+  for(int n=0;n<200;n++) {
+    memcpy(&expected, &previous, sizeof(Frame));
+    randomFrame(expected);
+    uint8_t type;
+    const int length = FrameCodec::encode(expected, n % 50 ? &previous : nullptr, data, type);
+    TEST_ASSERT_TRUE(length <= FrameCodec::maxPayload);
+    deltas += type == FrameCodec::DELTA;
+    TEST_ASSERT_TRUE(FrameCodec::decode(type, data, length, previous, frame));
+    TEST_ASSERT_TRUE(same(expected, frame));
+    // in place, like SequenceFile::seek
+    TEST_ASSERT_TRUE(FrameCodec::decode(type, data, length, previous, previous));
+    TEST_ASSERT_TRUE(same(expected, previous));
+  }
+  TEST_ASSERT_GREATER_THAN(100, deltas);
+}
+
+void test_rejects_cut_payloads() {
+  static uint8_t data[FrameCodec::maxPayload];
+  memset(&previous, 0, sizeof(previous));
+  demoFrame(0, expected);
+  uint8_t type;
+  int length = FrameCodec::encode(expected, nullptr, data, type);
+  TEST_ASSERT_FALSE(FrameCodec::decode(type, data, length - 1, previous, frame));
+  length = FrameCodec::encode(expected, &previous, data, type);
+  TEST_ASSERT_EQUAL(FrameCodec::DELTA, type);
+  TEST_ASSERT_FALSE(FrameCodec::decode(type, data, length - 1, previous, frame));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_decodes_the_stream_of_the_pc);
+  RUN_TEST(test_skips_bytes_between_frames);
+  RUN_TEST(test_encodes_like_the_pc);
+  RUN_TEST(test_round_trip);
+  RUN_TEST(test_rejects_cut_payloads);
+  return UNITY_END();
+}
@@ -0,0 +1,79 @@
+#include <unity.h>
+#include "../NativeCube.h"
+/* Cube::fade scales the displayed frame down in steps, a cube that keeps fading must end up black.
+ * With 8 bit frames every fade stores its result on the 8 bit curve again. */
+void setUp() {
+  beginCube();
+}
+
+void tearDown() {}
+
+namespace {
+// every channel value on its own voxel, then fade until nothing is left
+bool fadesToBlack(int steps) {
+  int value = 0;
+  for(int x=0;x<X_LAYERS;x++)
+  for(int y=0;y<Y_LAYERS;y++)
+  for(int z=0;z<Z_LAYERS;z++) {
+    cube.setVoxel(x, y, z, Color(value, 4095 - value, value/2));
+    value = (value + 7) % 4096;
+  }
+  cube.update();
+  for(int n=0;n<2000;n++) {
+    cube.fade(steps, 1);
+    cube.update();
+  }
+  for(int x=0;x<X_LAYERS;x++)
+  for(int y=0;y<Y_LAYERS;y++)
+  for(int z=0;z<Z_LAYERS;z++)
+    if(!cube.getDisplayedVoxel(x, y, z).isBlack())
+      return false;
+  return true;
+}
+}
+
+void test_short_fades_reach_black() {
+  TEST_ASSERT_TRUE(fadesToBlack(5));
+  TEST_ASSERT_TRUE(fadesToBlack(12));
+  TEST_ASSERT_TRUE(fadesToBlack(21));
+}
+
+void test_long_fades_reach_black() {
+  TEST_ASSERT_TRUE(fadesToBlack(71));
+  TEST_ASSERT_TRUE(fadesToBlack(143));
+}
+
+void test_stored_colors_are_kept() {
+  // a frame gives back the colors it stores, fades only ever make them darker
+  for(int c=0;c<4096;c++) {
+    cube.setVoxel(0, 0, 0, Color(c, c, c));
+    const Color stored = cube.getRenderingVoxel(0, 0, 0);
+    TEST_ASSERT_TRUE(stored.R <= c);
+    cube.setVoxel(0, 0, 0, stored);
+    TEST_ASSERT_EQUAL(stored.R, cube.getRenderingVoxel(0, 0, 0).R);
+  }
+}
+
+void test_bright_colors_are_clamped() {
+#ifdef FRAMEBUFFER_8BIT
+  // a sum of colors can go past 12 bits, it is stored as the brightest step
+  cube.setVoxel(0, 0, 0, Color(4095, 4095, 4095));
+  const Color white = cube.getRenderingVoxel(0, 0, 0);
+  cube.setVoxel(0, 0, 0, Color(4096, 8000, 65535));
+  const Color stored = cube.getRenderingVoxel(0, 0, 0);
+  TEST_ASSERT_EQUAL(white.R, stored.R);
+  TEST_ASSERT_EQUAL(white.G, stored.G);
+  TEST_ASSERT_EQUAL(white.B, stored.B);
+#else
+  TEST_IGNORE_MESSAGE("12 bit frames store colors as they are");
+#endif
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_short_fades_reach_black);
+  RUN_TEST(test_long_fades_reach_black);
+  RUN_TEST(test_stored_colors_are_kept);
+  RUN_TEST(test_bright_colors_are_clamped);
+  return UNITY_END();
+}
@@ -0,0 +1,149 @@
+#include <unity.h>
+#include <stdio.h>
+#include "../NativeCube.h"
+/* Golden frame digests: Cube::verify records a digest file on the first run and checks
+ * every animation against it after that, Cube::compare replays two animations side by
+ * side. The card is the temporary directory of the PC, except for the digests committed
+ * next to this file. Those are only read, a build with -D GOLDEN_RECORD writes them anew:
+ *   PLATFORMIO_BUILD_FLAGS="-D GOLDEN_RECORD" pio test -e native -f test_golden
+ * and the same with -e native_8bit. */
+namespace {
+const char* digests = "golden_test.dig";
+const int frames = 30;
+#ifdef FRAMEBUFFER_8BIT
+const char* otherFormat = "12bit";
+const char* committed = "golden_8bit.dig";
+#else
+const char* otherFormat = "8bit";
+const char* committed = "golden_12bit.dig";
+#endif
+
+struct Record {
+  char key[32];
+  uint32_t frames;
+};
+}
+
+void setUp() {
+  beginCube();
+  SD.setRoot(P_tmpdir);
+  SD.remove(digests);
+}
+
+void tearDown() {
+  SD.setRoot(P_tmpdir);
+  SD.remove(digests);
+  SD.setRoot(".");
+}
+
+void test_animations_match_the_committed_digests() {
+  SD.setRoot(projectPath("test/test_golden").c_str());
+#ifdef GOLDEN_RECORD
+  SD.remove(committed);
+  PrintLog recording;
+  cube.verify(recording, committed);
+  TEST_MESSAGE(committed);
+#endif
+  PrintLog log;
+  const int changed = cube.verify(log, committed, 120, false);
+  if(changed)
+    TEST_MESSAGE(log.text.substr(0, log.text.size() - 1).c_str());
+  TEST_ASSERT_EQUAL_MESSAGE(0, changed, "animations draw other frames than the committed digests");
+  TEST_ASSERT_GREATER_THAN(10, log.count(" ok"));
+  TEST_ASSERT_EQUAL(log.count(" digest "), log.count(" ok"));
+}
+
+void test_verify_records_then_checks() {
+  PrintLog first;
+  TEST_ASSERT_EQUAL(0, cube.verify(first, digests, frames));
+  const int n = first.count(" recorded");
+  TEST_ASSERT_GREATER_THAN(10, n);
+  File file = SD.open(digests);
+  TEST_ASSERT_EQUAL(n*(sizeof(Record) + frames*4), file.size());
+  file.close();
+
+  // whatever the cube showed before
+  for(int x=0;x<X_LAYERS;x++)
+  for(int y=0;y<Y_LAYERS;y++)
+  for(int z=0;z<Z_LAYERS;z++)
+    cube.setVoxel(x, y, z, Color::WHITE);
+  cube.update();
+  PrintLog second;
+  TEST_ASSERT_EQUAL(0, cube.verify(second, digests, frames));
+  TEST_ASSERT_EQUAL(n, second.count(" ok"));
+  TEST_ASSERT_EQUAL(0, second.count(" recorded"));
+  // the replays draw the same frames every time
+  TEST_ASSERT_EQUAL_STRING(first.text.substr(0, first.text.find(" recorded")).c_str(),
+                           second.text.substr(0, second.text.find(" ok")).c_str());
+}
+
+void test_verify_finds_records_by_name() {
+  PrintLog log;
+  cube.verify(log, digests, frames);
+  // change frame 7 of Sinus, wherever its record is
+  File file = SD.open(digests, FILE_WRITE);
+  Record record;
+  uint32_t position = 0;
+  while(file.seek(position) && file.read(&record, sizeof(record)) == sizeof(record)) {
+    if(strcmp(record.key, "Sinus 12bit") == 0 || strcmp(record.key, "Sinus 8bit") == 0) {
+      uint32_t h = 0;
+      file.seek(position + sizeof(record) + 7*4);
+      file.read(&h, 4);
+      h ^= 1;
+      file.seek(position + sizeof(record) + 7*4);
+      file.write((const uint8_t*)&h, 4);
+    }
+    position += sizeof(record) + record.frames*4;
+  }
+  file.close();
+
+  PrintLog check;
+  TEST_ASSERT_EQUAL(1, cube.verify(check, digests, frames));
+  TEST_ASSERT_EQUAL(1, check.count("Sinus "));
+  TEST_ASSERT_EQUAL(1, check.count(" changed at frame 7"));
+  TEST_ASSERT_TRUE(check.text.find("Sinus ") < check.text.find(" changed at frame 7"));
+}
+
+void test_verify_keeps_formats_apart() {
+  // a build with the other frame format recorded first, with other hashes
+  File file = SD.open(digests, FILE_WRITE);
+  Record other = {};
+  snprintf(other.key, sizeof(other.key), "Sinus %s", otherFormat);
+  other.frames = frames;
+  uint32_t hashes[frames] = {};
+  file.write((const uint8_t*)&other, sizeof(other));
+  file.write((const uint8_t*)hashes, sizeof(hashes));
+  file.close();
+
+  PrintLog log;
+  TEST_ASSERT_EQUAL(0, cube.verify(log, digests, frames));
+  TEST_ASSERT_EQUAL(log.count(" digest "), log.count(" recorded"));
+  TEST_ASSERT_EQUAL(0, cube.verify(log, digests, frames));
+  file = SD.open(digests);
+  file.read(&other, sizeof(other));
+  TEST_ASSERT_EQUAL(0, strncmp(other.key, "Sinus ", 6));
+  TEST_ASSERT_EQUAL_STRING(otherFormat, other.key + 6);
+  file.close();
+}
+
+void test_compare_same_animations() {
+  // Arrows merge their voxels with what is already drawn, they only match on a canvas
+  // that is cleared before each of them draws
+  Arrows reference, candidate;
+  TEST_ASSERT_EQUAL(0, cube.compare(&reference, &candidate, 60));
+  Twinkel fading, again;
+  TEST_ASSERT_EQUAL(0, cube.compare(&fading, &again, 60));
+  Sinus sinus;
+  Rainbow rainbow;
+  TEST_ASSERT_GREATER_THAN(1000, cube.compare(&sinus, &rainbow, 10));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_animations_match_the_committed_digests);
+  RUN_TEST(test_verify_records_then_checks);
+  RUN_TEST(test_verify_finds_records_by_name);
+  RUN_TEST(test_verify_keeps_formats_apart);
+  RUN_TEST(test_compare_same_animations);
+  return UNITY_END();
+}
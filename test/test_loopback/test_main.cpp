@@ -0,0 +1,79 @@
+#include <unity.h>
+#include "../NativeCube.h"
+#include "FrameCodec.h"
+/* Streams the demo of tools/cubestream.py through a pseudo terminal into Serial and shows
+ * every frame like Streamer::draw does, decoded into the rendering cube against the
+ * displayed cube. Reports the frames per second and the decode time. Needs python3, the
+ * stream script opens the terminal as a file when pyserial isn't installed. */
+namespace {
+const int frames = 120;
+const int fps = 60;
+
+Frame expected;
+}
+
+void setUp() {
+  beginCube();
+}
+
+void tearDown() {
+  Serial.open(-1);
+}
+
+void test_streams_the_demo_through_a_terminal() {
+  if(!hasPython())
+    TEST_IGNORE_MESSAGE("python3 is needed to stream frames");
+  int master = -1, slave = -1;
+  TEST_ASSERT_TRUE(openTerminal(master, slave));
+  Serial.open(master);
+
+  char command[512];
+  snprintf(command, sizeof(command), "python3 %s %s --fps %d --frames %d",
+           projectPath("tools/cubestream.py").c_str(), ptsname(master), fps, frames);
+  FILE* pc = popen(command, "r");
+  TEST_ASSERT_NOT_NULL(pc);
+
+  FrameReceiver receiver;
+  int shown = 0;
+  uint32_t decodeCycles = 0;
+  unsigned long start = 0;
+  const unsigned long timeout = millis() + 5000 + frames*1000/fps;
+  while(shown < frames && millis() < timeout) {
+    if(!receiver.receive(Serial))
+      continue;
+    if(!shown)
+      start = micros();
+    const uint32_t cycles = ARM_DWT_CYCCNT;
+    const bool decoded = FrameCodec::decode(receiver.type(), receiver.payload(),
+      receiver.length(), cube.getDisplayedCube(), cube.getRenderingCube());
+    decodeCycles += ARM_DWT_CYCCNT - cycles;
+    TEST_ASSERT_TRUE(decoded);
+    cube.update();
+    demoFrame(shown/(double)fps*2, expected);
+    TEST_ASSERT_EQUAL_MEMORY_MESSAGE(&expected, &cube.getDisplayedCube(), sizeof(Frame),
+                                     "shown frame differs from the demo");
+    shown++;
+  }
+  const unsigned long elapsed = micros() - start;
+  char report[128] = "";
+  fgets(report, sizeof(report), pc);
+  report[strcspn(report, "\n")] = 0;
+  pclose(pc);
+  close(slave);
+  close(master);
+  TEST_ASSERT_EQUAL(frames, shown);
+
+  char message[256];
+  snprintf(message, sizeof(message), "%d frames, %.1f fps, decode %lu us a frame, pc: %s",
+           shown, (shown - 1)*1e6/elapsed,
+           (unsigned long)(decodeCycles/shown/(F_CPU/1000000)), report);
+  TEST_MESSAGE(message);
+  // the PC paces the frames, the cube keeps up with it
+  TEST_ASSERT_TRUE((shown - 1)*1e6/elapsed > fps/2);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_streams_the_demo_through_a_terminal);
+  return UNITY_END();
+}
@@ -0,0 +1,128 @@
+#include <unity.h>
+#include <vector>
+#include "../NativeCube.h"
+#include "Sequence.h"
+/* The mirror of main.cpp through a pseudo terminal: every animation of the playlist is shown
+ * for a few frames and sent with a FrameSender, tools/cubemirror.py decodes them and records
+ * a sequence, and SequenceFile reads that back. Every frame has to come back unchanged.
+ * Reports the bytes per frame of every animation. Needs python3. */
+namespace {
+#define NAMES(...) #__VA_ARGS__
+#define EXPANDED_NAMES(...) NAMES(__VA_ARGS__)
+const char playlistNames[] = EXPANDED_NAMES(PLAYLIST);
+const char* recording = "mirror_test.vxs";
+const int framesPerAnimation = 60;
+const uint32_t step = 16667;
+
+struct Shown {
+  Frame frame;
+};
+std::vector<Shown> shown;
+FrameSender mirror;
+const char* names = playlistNames;
+bool stalled = false;
+
+// writes the last frame completely, like mirrorDisplay over a number of calls
+void flush() {
+  const unsigned long timeout = millis() + 5000;
+  while(!mirror.flush(Serial) && millis() < timeout);
+  stalled |= !mirror.ready();
+}
+
+template<typename T>
+void show() {
+  while(*names == ',' || *names == ' ') names++;
+  const char* name = names;
+  while(*names && *names != ',' && *names != ' ') names++;
+
+  const uint32_t bytes = mirror.bytes();
+  Animation* animation = new T();
+  for(int f=0;f<framesPerAnimation && !stalled;f++) {
+    Clock::step(step);
+    animation->animate();
+    cube.update();
+    shown.push_back(Shown());
+    memcpy(shown.back().frame, cube.getDisplayedCube(), sizeof(Frame));
+    // a keyframe every 64 frames, like mirrorDisplay
+    mirror.send(shown.back().frame, shown.size() % 64 == 1);
+    flush();
+  }
+  delete animation;
+
+  char message[128];
+  snprintf(message, sizeof(message), "%.*s %lu bytes/frame", (int)(names - name), name,
+           (unsigned long)((mirror.bytes() - bytes)/framesPerAnimation));
+  TEST_MESSAGE(message);
+}
+
+template<typename... T>
+void showAll() {
+  int order[] = { (show<T>(), 0)... };
+  (void)order;
+}
+}
+
+void setUp() {
+  beginCube();
+  SD.setRoot(P_tmpdir);
+  SD.remove(recording);
+}
+
+void tearDown() {
+  Serial.open(-1);
+  SD.remove(recording);
+  SD.setRoot(".");
+  Clock::run();
+}
+
+void test_mirror_round_trip() {
+  if(!hasPython())
+    TEST_IGNORE_MESSAGE("python3 is needed to decode the mirror");
+  int master = -1, slave = -1;
+  TEST_ASSERT_TRUE(openTerminal(master, slave));
+  Serial.open(master);
+
+  int frames = framesPerAnimation;
+  for(const char* c = playlistNames; *c; c++)
+    frames += *c == ',' ? framesPerAnimation : 0;
+  char command[1024];
+  snprintf(command, sizeof(command),
+           "python3 %s --input %s --record %s/%s --fps %d --frames %d",
+           projectPath("tools/cubemirror.py").c_str(), ptsname(master), P_tmpdir, recording,
+           (int)(1000000/step), frames);
+  FILE* pc = popen(command, "r");
+  TEST_ASSERT_NOT_NULL(pc);
+
+  randomSeed(1);
+  Clock::freeze(1000000);
+  showAll<PLAYLIST>();
+  char line[128], report[128] = "";
+  while(fgets(line, sizeof(line), pc))
+    strcpy(report, line);
+  report[strcspn(report, "\n")] = 0;
+  pclose(pc);
+  close(slave);
+  close(master);
+  TEST_ASSERT_FALSE_MESSAGE(stalled, "cubemirror.py stopped reading");
+  TEST_ASSERT_EQUAL(frames, (int)shown.size());
+  TEST_MESSAGE(report);
+
+  SequenceFile sequence;
+  TEST_ASSERT_TRUE(sequence.open(recording));
+  TEST_ASSERT_EQUAL(frames, sequence.frames());
+  static Frame previous, frame;
+  memset(&previous, 0, sizeof(previous));
+  for(int n=0;n<frames;n++) {
+    TEST_ASSERT_TRUE(sequence.next(previous, frame));
+    TEST_ASSERT_EQUAL_MEMORY_MESSAGE(&shown[n].frame, &frame, sizeof(Frame),
+                                     "recorded frame differs from the one shown");
+    memcpy(&previous, &frame, sizeof(Frame));
+  }
+  sequence.close();
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_mirror_round_trip);
+  return UNITY_END();
+}
@@ -0,0 +1,148 @@
+#include <unity.h>
+#include <math.h>
+#include "../NativeCube.h"
+/* NoiseGenerator: known answers for a fixed seed and the moments of its distributions.
+ * The expected values come from a separate implementation of splitmix32, xoshiro128** and
+ * the fast path of the Ziggurat, not from this code. */
+namespace {
+const uint32_t seed = 0x2545F491;
+const int samples = 400000;
+
+struct Moments {
+  double mean = 0, variance = 0, skewness = 0, kurtosis = 0;
+};
+
+template<typename Sample>
+Moments moments(Sample sample) {
+  double sum = 0, sum2 = 0, sum3 = 0, sum4 = 0;
+  for(int i=0;i<samples;i++) {
+    const double v = sample();
+    sum += v;
+    sum2 += v*v;
+    sum3 += v*v*v;
+    sum4 += v*v*v*v;
+  }
+  Moments m;
+  m.mean = sum/samples;
+  m.variance = sum2/samples - m.mean*m.mean;
+  const double sd = sqrt(m.variance);
+  m.skewness = (sum3/samples - 3*m.mean*m.variance - m.mean*m.mean*m.mean)/(sd*sd*sd);
+  m.kurtosis = (sum4/samples - 4*m.mean*sum3/samples + 6*m.mean*m.mean*sum2/samples
+                - 3*m.mean*m.mean*m.mean*m.mean)/(m.variance*m.variance);
+  return m;
+}
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_known_bits() {
+  const uint32_t expected[8] = { 0xDF5F75C5, 0x77572AD4, 0xA75C5606, 0x5421912E,
+                                 0xEED062A8, 0x42EF0AE7, 0xA85A4C60, 0xC2DA84E7 };
+  NoiseGenerator noise(seed);
+  for(int i=0;i<8;i++)
+    TEST_ASSERT_EQUAL_HEX32(expected[i], noise.next());
+  const uint32_t zero[4] = { 0xE308DC58, 0x4392D0E4, 0x03318F97, 0xAC593A63 };
+  noise.seed(0);
+  for(int i=0;i<4;i++)
+    TEST_ASSERT_EQUAL_HEX32(zero[i], noise.next());
+}
+
+void test_known_values() {
+  NoiseGenerator noise(seed);
+  const int ints[8] = { 872, 466, 653, 328, 932, 261, 657, 761 };
+  for(int i=0;i<8;i++)
+    TEST_ASSERT_EQUAL(ints[i], noise.nextInt(1000));
+  noise.seed(seed);
+  const float uniform[4] = { 0.87255043f, 0.46617383f, 0.65375274f, 0.32863721f };
+  for(int i=0;i<4;i++)
+    TEST_ASSERT_FLOAT_WITHIN(1e-7f, uniform[i], noise.nextRandom(0, 1));
+  noise.seed(seed);
+  const float normal[8] = { -0.40827695f, 1.69776118f, -0.38689131f, 0.84824520f,
+                            -0.16216490f, 1.13260627f, -1.38636565f, -1.03467703f };
+  for(int i=0;i<8;i++)
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, normal[i], noise.nextGaussian(0, 1));
+}
+
+void test_seed_repeats() {
+  NoiseGenerator a(1234), b(1234);
+  for(int i=0;i<1000;i++)
+    TEST_ASSERT_EQUAL_HEX32(a.next(), b.next());
+  a.seed(99);
+  b.seed(99);
+  float fa[64], fb[64];
+  a.fillGaussian(fa, 64, 2, 3);
+  for(int i=0;i<64;i++)
+    fb[i] = b.nextGaussian(2, 3);
+  TEST_ASSERT_EQUAL_MEMORY(fa, fb, sizeof(fa));
+}
+
+// the standard errors of the mean and variance are about 0.0016 and 0.0022 here
+void test_gaussian_moments() {
+  NoiseGenerator noise(seed);
+  Moments m = moments([&]() { return noise.nextGaussian(0, 1); });
+  TEST_ASSERT_FLOAT_WITHIN(0.008, 0, m.mean);
+  TEST_ASSERT_FLOAT_WITHIN(0.012, 1, m.variance);
+  TEST_ASSERT_FLOAT_WITHIN(0.02, 0, m.skewness);
+  TEST_ASSERT_FLOAT_WITHIN(0.05, 3, m.kurtosis);
+  m = moments([&]() { return noise.nextGaussian(5, 2); });
+  TEST_ASSERT_FLOAT_WITHIN(0.016, 5, m.mean);
+  TEST_ASSERT_FLOAT_WITHIN(0.05, 4, m.variance);
+}
+
+// the tail beyond 3.44 comes from the slow path, it has to be as heavy as a normal tail
+void test_gaussian_tail() {
+  NoiseGenerator noise(seed);
+  int beyond3 = 0, beyondR = 0;
+  for(int i=0;i<samples;i++) {
+    const float v = fabsf(noise.nextGaussian(0, 1));
+    beyond3 += v > 3;
+    beyondR += v > 3.442620f;
+  }
+  // 0.270% and 0.0576% of a normal distribution
+  TEST_ASSERT_INT_WITHIN(160, 1080, beyond3);
+  TEST_ASSERT_INT_WITHIN(75, 230, beyondR);
+  for(int i=0;i<samples/10;i++)
+    TEST_ASSERT_TRUE(fabsf(noise.nextGaussian(0, 1, 2)) <= 2);
+}
+
+// variance of a uniform distribution is (max-min)^2/12
+void test_uniform_moments() {
+  NoiseGenerator noise(seed);
+  Moments m = moments([&]() { return noise.nextRandom(-1, 3); });
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 1, m.mean);
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 16.0/12, m.variance);
+  TEST_ASSERT_FLOAT_WITHIN(0.02, 0, m.skewness);
+  TEST_ASSERT_FLOAT_WITHIN(0.02, 1.8, m.kurtosis);
+  float values[1000];
+  noise.fillRandom(values, 1000, 2, 4);
+  for(int i=0;i<1000;i++)
+    TEST_ASSERT_TRUE(values[i] >= 2 && values[i] <= 4);
+}
+
+// chi-square of 10 bins with 9 degrees of freedom, 27.9 is p = 0.001
+void test_uniform_integers() {
+  NoiseGenerator noise(seed);
+  int bins[10] = {};
+  for(int i=0;i<samples;i++) {
+    const int v = noise.nextInt(-3, 7);
+    TEST_ASSERT_TRUE(v >= -3 && v < 7);
+    bins[v+3]++;
+  }
+  double chi2 = 0;
+  for(int i=0;i<10;i++)
+    chi2 += (bins[i] - samples/10.0)*(bins[i] - samples/10.0)/(samples/10.0);
+  TEST_ASSERT_TRUE(chi2 < 27.9);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_known_bits);
+  RUN_TEST(test_known_values);
+  RUN_TEST(test_seed_repeats);
+  RUN_TEST(test_gaussian_moments);
+  RUN_TEST(test_gaussian_tail);
+  RUN_TEST(test_uniform_moments);
+  RUN_TEST(test_uniform_integers);
+  return UNITY_END();
+}
@@ -0,0 +1,207 @@
+#include <unity.h>
+#include "../NativeCube.h"
+/* The packer turns a layer of the displayed cube into the bit streams of the TLC chains.
+ * The TLC's of a chain act as one long shift register. Every bit sent on SIN enters at the
+ * first TLC and pushes all bits one place further, so after a whole layer the first bit
+ * sent ends up as the MSB of OUT15 of the last TLC. The tests shift the bytes of each chain
+ * through such a register bit by bit, then read every channel back as the TLC would latch
+ * it on XLAT. */
+void setUp() {
+  beginCube();
+  cube.setLayerBudget(0);
+}
+
+void tearDown() {
+  cube.setLayerBudget(0);
+  cube.resetStats();
+}
+
+namespace {
+// the lowest bits the TLC's don't count, and the most a dither threshold adds before that
+const int shift = 12 - __builtin_ctz(GSCNT);
+const int threshold = (1 << shift) - 1;
+
+void show(Color c) {
+  for(int x=0;x<X_LAYERS;x++)
+  for(int y=0;y<Y_LAYERS;y++)
+  for(int z=0;z<Z_LAYERS;z++)
+    cube.setVoxel(x, y, z, c);
+  cube.update();
+}
+
+void showRandom() {
+  for(int x=0;x<X_LAYERS;x++)
+  for(int y=0;y<Y_LAYERS;y++)
+  for(int z=0;z<Z_LAYERS;z++) {
+    Color c;
+    c.random();
+    cube.setVoxel(x, y, z, c);
+  }
+  cube.update();
+}
+
+// the value every channel gets on XLAT after the channel buffers were sent
+void latchChains(uint16_t* latched) {
+  for(int bus = 0; bus < SPI_BUSES; bus++) {
+    const uint8_t* sent = cube.channelBuffer(bus);
+    // register bit n is bit n%12 of channel n/12 of this chain
+    uint8_t reg[BUSBYTES] = {};
+    for(int i = 0; i < BUSBITS; i++) {
+      uint8_t in = (sent[i/8] >> (7 - i%8)) & 1;
+      for(int j = BUSBYTES-1; j > 0; j--)
+        reg[j] = (reg[j] << 1) | (reg[j-1] >> 7);
+      reg[0] = (reg[0] << 1) | in;
+    }
+    for(int channel = 0; channel < BUSCHANNELS; channel++) {
+      int first = channel*12;
+      uint16_t value = 0;
+      for(int b = 11; b >= 0; b--)
+        value = (value << 1) | ((reg[(first+b)/8] >> ((first+b)%8)) & 1);
+      latched[bus*BUSCHANNELS + channel] = value;
+    }
+  }
+}
+
+// the channel values of a voxel, in the order of ledChannels
+void channels(Color c, uint16_t* values) {
+  values[0] = c.B;
+  values[1] = c.G;
+  values[2] = c.R;
+}
+}
+
+void test_every_led_has_its_own_channels() {
+  int used[CHANNELS] = {};
+  for(int x=0;x<X_LAYERS;x++)
+  for(int z=0;z<Z_LAYERS;z++)
+  for(int k=0;k<3;k++) {
+    const uint16_t channel = cube.ledChannels(x, z)[k];
+    TEST_ASSERT_LESS_THAN(CHANNELS, channel);
+    TEST_ASSERT_EQUAL(0, used[channel]++);
+  }
+}
+
+void test_layers_latch_their_voxels() {
+  showRandom();
+  uint16_t latched[CHANNELS];
+  for(int y=0;y<Y_LAYERS;y++) {
+    cube.setChannelBuffer(y);
+    latchChains(latched);
+    for(int x=0;x<X_LAYERS;x++)
+    for(int z=0;z<Z_LAYERS;z++) {
+      uint16_t values[3];
+      channels(cube.getDisplayedVoxel(x, y, z), values);
+      for(int k=0;k<3;k++) {
+        // a scan shows the value rounded down or, with a dither threshold, up
+        const uint16_t value = latched[cube.ledChannels(x, z)[k]];
+        TEST_ASSERT_TRUE(value == values[k] >> shift || value == (values[k] + threshold) >> shift);
+      }
+    }
+  }
+}
+
+void test_buses_form_one_chain() {
+  // the buffers of the chains, sent one after the other from the last chain to the first,
+  // are the stream a single chain of all TLC's would get: channel CHANNELS-1 first, 12
+  // bits each with the most significant bit first
+  showRandom();
+  cube.setChannelBuffer(3);
+  uint16_t values[CHANNELS] = {};
+  uint16_t latched[CHANNELS];
+  latchChains(latched);
+  for(int x=0;x<X_LAYERS;x++)
+  for(int z=0;z<Z_LAYERS;z++)
+  for(int k=0;k<3;k++) {
+    const uint16_t channel = cube.ledChannels(x, z)[k];
+    values[channel] = latched[channel];
+  }
+  uint8_t stream[CHANNELS*12/8] = {};
+  for(int i=0;i<CHANNELS*12;i++) {
+    const int channel = CHANNELS - 1 - i/12;
+    if(values[channel] >> (11 - i%12) & 1)
+      stream[i/8] |= 0x80 >> (i%8);
+  }
+  for(int bus=0;bus<SPI_BUSES;bus++)
+    TEST_ASSERT_EQUAL_MEMORY(stream + (SPI_BUSES-1-bus)*BUSBYTES, cube.channelBuffer(bus), BUSBYTES);
+}
+
+void test_dithered_scans_add_up() {
+#ifdef TEMPORAL_DITHER
+  // over all scans of the dither pattern the latched values add up to the 12 bit voxels
+  showRandom();
+  uint16_t latched[CHANNELS];
+  for(int y=0;y<Y_LAYERS;y++) {
+    uint32_t sum[CHANNELS] = {};
+    for(int scan=0;scan<=threshold;scan++) {
+      // packing the bottom layer starts the next scan
+      if(y != 0)
+        cube.setChannelBuffer(0);
+      cube.setChannelBuffer(y);
+      latchChains(latched);
+      for(int i=0;i<CHANNELS;i++)
+        sum[i] += latched[i];
+    }
+    for(int x=0;x<X_LAYERS;x++)
+    for(int z=0;z<Z_LAYERS;z++) {
+      uint16_t values[3];
+      channels(cube.getDisplayedVoxel(x, y, z), values);
+      for(int k=0;k<3;k++)
+        TEST_ASSERT_EQUAL(values[k], sum[cube.ledChannels(x, z)[k]]);
+    }
+  }
+#else
+  TEST_IGNORE_MESSAGE("build with TEMPORAL_DITHER");
+#endif
+}
+
+void test_budget_scales_the_scan_that_shows_it() {
+  cube.setLayerBudget(0.5);
+  show(Color::BLACK);
+  cube.packCycles();
+  // the first scan of a white frame is already scaled down
+  show(Color::WHITE);
+  cube.resetStats();
+  cube.packCycles();
+  TEST_ASSERT_EQUAL(Y_LAYERS, cube.limitedScans());
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 1, cube.layerPeak(0));
+  uint16_t latched[CHANNELS];
+  latchChains(latched);
+  // half of white, give or take a step of the scale
+  TEST_ASSERT_UINT32_WITHIN((16 >> shift) + 1, 2047 >> shift, latched[cube.ledChannels(4, 4)[0]]);
+  // and the first scan of a dark one is not
+  show(Color(100, 100, 100));
+  cube.resetStats();
+  cube.packCycles();
+  TEST_ASSERT_EQUAL(0, cube.limitedScans());
+}
+
+void test_latch_leaves_packing_to_the_software_interrupt() {
+  showRandom();
+  uint8_t sent[SPI_BUSES][BUSBYTES];
+  for(int bus=0;bus<SPI_BUSES;bus++)
+    memcpy(sent[bus], cube.channelBuffer(bus), BUSBYTES);
+  cube.resetStats();
+  // FTM1 only latches and switches the layer
+  ftm1_isr();
+  for(int bus=0;bus<SPI_BUSES;bus++)
+    TEST_ASSERT_EQUAL_MEMORY(sent[bus], cube.channelBuffer(bus), BUSBYTES);
+  TEST_ASSERT_EQUAL(0, cube.prepareCycles());
+  // the software interrupt it pends packs the next layer
+  software_isr();
+  TEST_ASSERT_GREATER_THAN(0, cube.prepareCycles());
+  bool packed = false;
+  for(int bus=0;bus<SPI_BUSES;bus++)
+    packed |= memcmp(sent[bus], cube.channelBuffer(bus), BUSBYTES) != 0;
+  TEST_ASSERT_TRUE(packed);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_every_led_has_its_own_channels);
+  RUN_TEST(test_layers_latch_their_voxels);
+  RUN_TEST(test_buses_form_one_chain);
+  RUN_TEST(test_dithered_scans_add_up);
+  RUN_TEST(test_budget_scales_the_scan_that_shows_it);
+  RUN_TEST(test_latch_leaves_packing_to_the_software_interrupt);
+  return UNITY_END();
+}
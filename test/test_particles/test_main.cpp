@@ -0,0 +1,62 @@
+#include <unity.h>
+#include <type_traits>
+#include "../NativeCube.h"
+#include "Particles.h"
+/* The particle system keeps its particles in the arrays of the pool it belongs to. */
+static_assert(!std::is_copy_constructible<ParticleSystem>::value &&
+              !std::is_copy_assignable<ParticleSystem>::value,
+              "a copied ParticleSystem would share the arrays of its pool");
+static_assert(!std::is_copy_constructible<ParticlePool<8>>::value &&
+              !std::is_copy_assignable<ParticlePool<8>>::value,
+              "a copied ParticlePool would point into the pool it came from");
+
+void setUp() {
+  beginCube();
+  memset(&cube.getRenderingCube(), 0, sizeof(Frame));
+}
+
+void tearDown() {}
+
+void test_emit_until_full() {
+  ParticlePool<4> pool;
+  for(int i=0;i<4;i++)
+    TEST_ASSERT_TRUE(pool.emit(Vector3(1,1,1), Vector3(0,0,0), Color::RED, 1));
+  TEST_ASSERT_FALSE(pool.emit(Vector3(1,1,1), Vector3(0,0,0), Color::RED, 1));
+  TEST_ASSERT_EQUAL(4, pool.size());
+  pool.clear();
+  TEST_ASSERT_TRUE(pool.empty());
+}
+
+void test_expired_particles_are_removed() {
+  ParticlePool<4> pool;
+  pool.emit(Vector3(1,1,1), Vector3(0,0,0), Color::RED, 0.5f);
+  pool.emit(Vector3(2,2,2), Vector3(1,0,0), Color::GREEN, 2);
+  pool.emit(Vector3(3,3,3), Vector3(0,0,0), Color::BLUE, 0.25f);
+  pool.update(1);
+  TEST_ASSERT_EQUAL(1, pool.size());
+  // the survivor moved one voxel along x and is halfway its ramp to black
+  pool.draw(X_LAYERS, Y_LAYERS, Z_LAYERS);
+  Color c = cube.getRenderingVoxel(3,2,2);
+  TEST_ASSERT_INT_WITHIN(32, Color::GREEN.G/2, c.G);
+  TEST_ASSERT_EQUAL(0, cube.getRenderingVoxel(1,1,1).R);
+  TEST_ASSERT_EQUAL(0, cube.getRenderingVoxel(3,3,3).B);
+}
+
+void test_floor_and_gravity() {
+  ParticlePool<2> pool;
+  pool.gravity = Vector3(0,-10,0);
+  pool.emit(Vector3(4,2,4), Vector3(0,0,0), Color::WHITE, 10);
+  // positions move with the velocity of the step before, so it takes two steps to fall
+  pool.update(0.5f);
+  pool.update(0.5f);
+  pool.draw(X_LAYERS, Y_LAYERS, Z_LAYERS);
+  TEST_ASSERT_TRUE(cube.getRenderingVoxel(4,0,4).R > 0);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_emit_until_full);
+  RUN_TEST(test_expired_particles_are_removed);
+  RUN_TEST(test_floor_and_gravity);
+  return UNITY_END();
+}
@@ -0,0 +1,107 @@
+#include <unity.h>
+#include "../NativeCube.h"
+#include "Quaternion.h"
+/* Vectors and quaternions in float and in Q16.16 fixed point. */
+namespace {
+void assertNear(const Vector3& expected, const Vector3& actual, float error) {
+  TEST_ASSERT_FLOAT_WITHIN(error, expected.x, actual.x);
+  TEST_ASSERT_FLOAT_WITHIN(error, expected.y, actual.y);
+  TEST_ASSERT_FLOAT_WITHIN(error, expected.z, actual.z);
+}
+
+Vector3 toFloat(const FixedVector3& v) {
+  return Vector3((float)v.x, (float)v.y, (float)v.z);
+}
+
+// a rotation of angle degrees around a random axis
+Quaternion randomRotation(NoiseGenerator& random, float& angle, Vector3& axis) {
+  angle = random.nextRandom(-180, 180);
+  axis = Vector3(random.nextRandom(-1, 1), random.nextRandom(-1, 1), random.nextRandom(-1, 1));
+  Quaternion q(angle, axis);
+  q.convertAxisAngle();
+  return q;
+}
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_vector_rotate_turns_by_radians() {
+  // a quarter turn around z takes x to y
+  Vector3 v(1, 0, 0);
+  Vector3(0, 0, 2).rotate(PI/2, v);
+  assertNear(Vector3(0, 1, 0), v, 1e-6f);
+  // and z to minus y around x
+  assertNear(Vector3(0, -1, 0), Vector3(1, 0, 0).rotated(PI/2, Vector3(0, 0, 1)), 1e-6f);
+}
+
+void test_quaternion_matches_vector_rotate() {
+  NoiseGenerator random(5);
+  for(int n=0;n<1000;n++) {
+    float angle;
+    Vector3 axis;
+    const Quaternion q = randomRotation(random, angle, axis);
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, 1, q.norm());
+    const Vector3 p(random.nextRandom(-5, 5), random.nextRandom(-5, 5), random.nextRandom(-5, 5));
+    assertNear(axis.rotated(angle*(float)PI/180, p), q.rotated(p), 1e-4f);
+  }
+}
+
+void test_batch_rotate_matches_single() {
+  NoiseGenerator random(6);
+  float angle;
+  Vector3 axis;
+  const Quaternion q = randomRotation(random, angle, axis);
+  Vector3 points[64];
+  for(int i=0;i<64;i++)
+    points[i] = Vector3(random.nextRandom(-5, 5), random.nextRandom(-5, 5), random.nextRandom(-5, 5));
+  Vector3 batch[64];
+  memcpy(batch, points, sizeof(points));
+  q.rotate(batch, 64);
+  for(int i=0;i<64;i++)
+    assertNear(q.rotated(points[i]), batch[i], 1e-5f);
+}
+
+void test_products_and_inverse() {
+  Quaternion a(30, Vector3(1, 0, 0));
+  a.convertAxisAngle();
+  Quaternion b(60, Vector3(1, 0, 0));
+  b.convertAxisAngle();
+  // rotations around one axis add up
+  Quaternion c(90, Vector3(1, 0, 0));
+  c.convertAxisAngle();
+  const Quaternion ab = a*b;
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, c.w, ab.w);
+  assertNear(c.v, ab.v, 1e-6f);
+  const Quaternion one = c*c.inversed();
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, 1, one.w);
+  assertNear(Vector3(0, 0, 0), one.v, 1e-6f);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, 1, (c*3).normalized().magnitude());
+}
+
+void test_fixed_follows_float() {
+  NoiseGenerator random(7);
+  for(int n=0;n<1000;n++) {
+    float angle;
+    Vector3 axis;
+    const Quaternion q = randomRotation(random, angle, axis);
+    const FixedQuaternion f(q.w, FixedVector3(q.v.x, q.v.y, q.v.z));
+    const Vector3 p(random.nextRandom(-5, 5), random.nextRandom(-5, 5), random.nextRandom(-5, 5));
+    FixedVector3 points[1] = { FixedVector3(p.x, p.y, p.z) };
+    f.rotate(points, 1);
+    assertNear(q.rotated(p), toFloat(points[0]), 0.001f);
+  }
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, 1.5f, (float)squareRoot(Fixed(2.25f)));
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, 5, (float)FixedVector3(3, 4, 0).magnitude());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_vector_rotate_turns_by_radians);
+  RUN_TEST(test_quaternion_matches_vector_rotate);
+  RUN_TEST(test_batch_rotate_matches_single);
+  RUN_TEST(test_products_and_inverse);
+  RUN_TEST(test_fixed_follows_float);
+  return UNITY_END();
+}
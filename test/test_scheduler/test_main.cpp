@@ -0,0 +1,122 @@
+#include <unity.h>
+#include <algorithm>
+#include <string>
+#include "../NativeCube.h"
+/* The scheduler on a clock the tests move themselves: the order of due tasks, tasks that
+ * missed periods, the wrap of micros() after 71 minutes and the lateness it reports. */
+namespace {
+uint32_t fakeMicros = 0;
+std::string ran;
+
+unsigned long now() {
+  return fakeMicros;
+}
+
+void a() { ran += 'a'; }
+void b() { ran += 'b'; }
+void c() { ran += 'c'; }
+
+// runs every task that is due
+void runDue(Scheduler& tasks) {
+  for(int n=0;n<Scheduler::maxTasks && tasks.run();n++);
+}
+}
+
+void setUp() {
+  fakeMicros = 1000000;
+  ran.clear();
+}
+
+void tearDown() {}
+
+void test_runs_the_task_due_longest_first() {
+  Scheduler tasks(now);
+  TEST_ASSERT_TRUE(tasks.add(a, 1000));
+  TEST_ASSERT_TRUE(tasks.add(b, 300));
+  TEST_ASSERT_TRUE(tasks.add(c, 700));
+  fakeMicros += 299;
+  TEST_ASSERT_FALSE(tasks.run());
+  // b is due 700 us, c 300 us and a just now
+  fakeMicros += 701;
+  runDue(tasks);
+  TEST_ASSERT_EQUAL_STRING("bca", ran.c_str());
+  TEST_ASSERT_FALSE(tasks.run());
+}
+
+void test_keeps_room_for_max_tasks() {
+  Scheduler tasks(now);
+  for(int n=0;n<Scheduler::maxTasks;n++)
+    TEST_ASSERT_TRUE(tasks.add(a, 100));
+  TEST_ASSERT_FALSE(tasks.add(b, 100));
+}
+
+void test_missed_periods_run_once() {
+  Scheduler tasks(now);
+  tasks.add(a, 100);
+  // 10 periods pass without run, a runs once and is due a period later
+  fakeMicros += 1050;
+  runDue(tasks);
+  TEST_ASSERT_EQUAL_STRING("a", ran.c_str());
+  fakeMicros += 99;
+  TEST_ASSERT_FALSE(tasks.run());
+  fakeMicros += 1;
+  TEST_ASSERT_TRUE(tasks.run());
+  // a task that is a little late keeps its period
+  fakeMicros += 130;
+  TEST_ASSERT_TRUE(tasks.run());
+  fakeMicros += 69;
+  TEST_ASSERT_FALSE(tasks.run());
+  fakeMicros += 1;
+  TEST_ASSERT_TRUE(tasks.run());
+  TEST_ASSERT_EQUAL_STRING("aaaa", ran.c_str());
+}
+
+void test_keeps_its_period_across_the_wrap() {
+  fakeMicros = 0xFFFFF000;
+  Scheduler tasks(now);
+  tasks.add(a, 1000);
+  tasks.add(b, 5000);
+  // 10 ms in steps of 10 us, 2^32 us pass after 4096 us
+  for(int n=0;n<1000;n++) {
+    fakeMicros += 10;
+    runDue(tasks);
+  }
+  TEST_ASSERT_EQUAL_UINT32(0x1710, fakeMicros);
+  TEST_ASSERT_EQUAL(10, (int)std::count(ran.begin(), ran.end(), 'a'));
+  TEST_ASSERT_EQUAL(2, (int)std::count(ran.begin(), ran.end(), 'b'));
+  TEST_ASSERT_EQUAL_UINT32(0, tasks.maxLateness());
+}
+
+void test_reports_the_largest_lateness() {
+  Scheduler tasks(now);
+  tasks.add(a, 1000);
+  tasks.add(b, 1000);
+  fakeMicros += 1250;
+  runDue(tasks);
+  TEST_ASSERT_EQUAL_UINT32(250, tasks.maxLateness());
+  tasks.resetStats();
+  TEST_ASSERT_EQUAL_UINT32(0, tasks.maxLateness());
+  // due again at 2000, one runs 40 us late and the other 90 us
+  fakeMicros += 790;
+  TEST_ASSERT_TRUE(tasks.run());
+  fakeMicros += 50;
+  TEST_ASSERT_TRUE(tasks.run());
+  TEST_ASSERT_EQUAL_UINT32(90, tasks.maxLateness());
+  // across the wrap too
+  fakeMicros = 0xFFFFFF00;
+  Scheduler wrapping(now);
+  wrapping.add(a, 0x200);
+  fakeMicros += 0x230;
+  TEST_ASSERT_TRUE(wrapping.run());
+  TEST_ASSERT_EQUAL_UINT32(0x30, wrapping.maxLateness());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_runs_the_task_due_longest_first);
+  RUN_TEST(test_keeps_room_for_max_tasks);
+  RUN_TEST(test_missed_periods_run_once);
+  RUN_TEST(test_keeps_its_period_across_the_wrap);
+  RUN_TEST(test_reports_the_largest_lateness);
+  return UNITY_END();
+}
@@ -0,0 +1,134 @@
+#include <unity.h>
+#include "../NativeCube.h"
+#include "Font.h"
+/* The scrollers draw from a TextStrip, rasterized once from the font. The reference
+ * scrollers below are the ones from before the strip, they test the font bits of every
+ * pixel in every frame. Both have to draw the same frames for a whole message. */
+namespace {
+class ReferenceOutside : public Animation {
+public:
+  ReferenceOutside(const char* text_) : text(text_), numChars(strlen(text_)) { init(); }
+private:
+  void init() {
+    bitPos = 0;
+    startPos = 32;
+    timer = 0.08f;
+  }
+  void draw(float dt) {
+    colorwheel.turn(dt/20);
+    for(int b=startPos;b<32;b++) {
+      unsigned int chrOffset = (b+bitPos-startPos)/8;
+      unsigned int bitOffset = (b+bitPos-startPos)%8;
+      if(chrOffset >= numChars) continue;
+      uint8_t chr = text[chrOffset];
+      for(int y=7;y>=0;y--) {
+        uint8_t bitset = charset[chr][7-y];
+        if(bitset & (1<<bitOffset)) {
+          int x = rotation[(b)%32];
+          int z = rotation[(24+b)%32];
+          if(chr==0x1F)
+            cube.setVoxel(x,y,z,Color::RED);
+          else
+            cube.setVoxel(x,y,z,colorwheel.color(z*0.01f));
+        }
+      }
+    }
+    if(timer.ticks())
+      startPos > 0 ? startPos-- : bitPos++;
+    if(bitPos/8 >= numChars)
+      restart();
+  }
+  const char* text;
+  unsigned int numChars;
+  uint16_t bitPos;
+  uint16_t startPos;
+  Timer timer;
+  const uint8_t rotation[32] =
+    {0,0,0,0,0,0,0,0, 0,1,2,3,4,5,6,7, 8,8,8,8,8,8,8,8, 8,7,6,5,4,3,2,1};
+};
+
+class ReferenceInside : public Animation {
+public:
+  ReferenceInside(const char* text_) : text(text_), numChars(strlen(text_)) { init(); }
+private:
+  void init() {
+    charPos = 0;
+    zPos = 8;
+    timer = 0.06f;
+  }
+  void draw(float dt) {
+    colorwheel.turn(dt/20);
+    for(int x=1;x<=8;x++) {
+      uint8_t chr = text[charPos%numChars];
+      for(int y=7;y>=0;y--) {
+        uint8_t bitset = charset[chr][7-y];
+        if(bitset & (1<<(x-1)))
+          cube.setVoxel(x,y,zPos,colorwheel.color(zPos*0.02f));
+      }
+    }
+    if(timer.ticks())
+      zPos > 0 ? zPos-- : (zPos = 8, charPos++);
+    if(charPos >= (int)numChars)
+      restart();
+  }
+  const char* text;
+  unsigned int numChars;
+  int16_t charPos;
+  uint16_t zPos;
+  Timer timer;
+};
+}
+
+void setUp() {
+  beginCube();
+}
+
+void tearDown() {}
+
+void test_strip_columns_are_font_columns() {
+  TextStrip strip;
+  strip.setText("Az 09&\x1F");
+  TEST_ASSERT_EQUAL(7, strip.characters());
+  TEST_ASSERT_EQUAL(56, strip.columns());
+  for(int c=0;c<strip.columns();c++)
+  for(int y=0;y<8;y++) {
+    const uint8_t chr = strip.character(c);
+    const bool font = charset[chr][7-y] & (1 << (c%8));
+    TEST_ASSERT_EQUAL(font, (strip.column(c) >> y) & 1);
+  }
+}
+
+void test_long_text_is_cut_off() {
+  char text[TextStrip::maxChars + 10];
+  memset(text, 'x', sizeof(text) - 1);
+  text[sizeof(text) - 1] = 0;
+  TextStrip strip;
+  strip.setText(text);
+  TEST_ASSERT_EQUAL(TextStrip::maxChars, strip.characters());
+  strip.setText("");
+  TEST_ASSERT_EQUAL(0, strip.columns());
+}
+
+void test_outside_scroller_draws_as_before() {
+  const char* text = "\x1F" "Dalton Lyceum Barendrecht\x1F";
+  ReferenceOutside reference(text);
+  OutsideScroller scroller(text);
+  // (27*8 + 32) columns at 0.08s, a whole message and the start of the next
+  TEST_ASSERT_EQUAL(0, cube.compare(&reference, &scroller, 1300));
+}
+
+void test_inside_scroller_draws_as_before() {
+  const char* text = "Technasium\x1F";
+  ReferenceInside reference(text);
+  InsideScroller scroller(text);
+  TEST_ASSERT_EQUAL(0, cube.compare(&reference, &scroller, 400));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_strip_columns_are_font_columns);
+  RUN_TEST(test_long_text_is_cut_off);
+  RUN_TEST(test_outside_scroller_draws_as_before);
+  RUN_TEST(test_inside_scroller_draws_as_before);
+  return UNITY_END();
+}
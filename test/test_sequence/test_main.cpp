@@ -0,0 +1,149 @@
+#include <unity.h>
+#include "../NativeCube.h"
+#include "Sequence.h"
+/* SequenceFile against the files of tools/cubeseq.py, read from the card of the PC. demo.vxs
+ * holds one second of the demo pattern at 30 fps with a keyframe every 10 frames, written with
+ *   python3 tools/cubeseq.py test/test_sequence/demo.vxs --fps 30 --seconds 1 --keyframes 10
+ * Reports how fast frames are read and decoded. */
+namespace {
+const int demoFrames = 30;
+const int demoFps = 30;
+const int keyframes = 10;
+const char* broken = "sequence_test.vxs";
+
+SequenceFile sequence;
+Frame previous, frame, expected;
+
+bool isDemo(int n, const Frame& f) {
+  demoFrame(n/(double)demoFps*2, expected);
+  return memcmp(&expected, &f, sizeof(Frame)) == 0;
+}
+}
+
+void setUp() {
+  beginCube();
+  SD.setRoot(projectPath("test/test_sequence").c_str());
+}
+
+void tearDown() {
+  sequence.close();
+  SD.setRoot(P_tmpdir);
+  SD.remove(broken);
+  SD.setRoot(".");
+}
+
+void test_reads_the_header() {
+  TEST_ASSERT_TRUE(sequence.open("demo.vxs"));
+  TEST_ASSERT_EQUAL(demoFrames, sequence.frames());
+  TEST_ASSERT_EQUAL(demoFps, sequence.fps());
+  TEST_ASSERT_EQUAL(0, sequence.position());
+  TEST_ASSERT_FALSE(sequence.open("missing.vxs"));
+  TEST_ASSERT_FALSE(sequence.isOpen());
+}
+
+void test_next_plays_every_frame() {
+  TEST_ASSERT_TRUE(sequence.open("demo.vxs"));
+  memset(&previous, 0, sizeof(previous));
+  for(int n=0;n<demoFrames;n++) {
+    TEST_ASSERT_TRUE(sequence.next(previous, frame));
+    TEST_ASSERT_TRUE_MESSAGE(isDemo(n, frame), "frame differs from cubeseq.py");
+    TEST_ASSERT_EQUAL(n+1, sequence.position());
+    memcpy(&previous, &frame, sizeof(Frame));
+    sequence.prefetch();
+  }
+  TEST_ASSERT_FALSE(sequence.next(previous, frame));
+}
+
+void test_seek_lands_on_every_frame() {
+  TEST_ASSERT_TRUE(sequence.open("demo.vxs"));
+  // backwards, forwards and across keyframes, with frames read ahead in between
+  const int order[] = { 29, 0, 10, 9, 11, 19, 20, 5, 25, 1, 29, 15 };
+  for(int n : order) {
+    TEST_ASSERT_TRUE(sequence.seek(n, frame));
+    TEST_ASSERT_TRUE_MESSAGE(isDemo(n, frame), "seek decoded another frame");
+    TEST_ASSERT_EQUAL(n+1, sequence.position());
+    sequence.prefetch();
+  }
+  TEST_ASSERT_FALSE(sequence.seek(-1, frame));
+  TEST_ASSERT_FALSE(sequence.seek(demoFrames, frame));
+}
+
+void test_next_continues_after_seek() {
+  TEST_ASSERT_TRUE(sequence.open("demo.vxs"));
+  sequence.prefetch();
+  TEST_ASSERT_TRUE(sequence.seek(keyframes + 3, previous));
+  for(int n=keyframes+4;n<demoFrames;n++) {
+    TEST_ASSERT_TRUE(sequence.next(previous, frame));
+    TEST_ASSERT_TRUE(isDemo(n, frame));
+    memcpy(&previous, &frame, sizeof(Frame));
+  }
+}
+
+void test_rejects_other_files() {
+  File demo = SD.open("demo.vxs");
+  std::string bytes;
+  for(int c = demo.read(); c >= 0; c = demo.read())
+    bytes += (char)c;
+  demo.close();
+  SD.setRoot(P_tmpdir);
+
+  // a sequence for a cube of another size
+  std::string other = bytes;
+  other[4] = 8;
+  File file = SD.open(broken, FILE_WRITE);
+  file.write((const uint8_t*)other.data(), other.size());
+  file.close();
+  TEST_ASSERT_FALSE(sequence.open(broken));
+
+  // a file that was cut off while it was copied, frames past the end fail
+  SD.remove(broken);
+  file = SD.open(broken, FILE_WRITE);
+  file.write((const uint8_t*)bytes.data(), bytes.size()/2);
+  file.close();
+  TEST_ASSERT_TRUE(sequence.open(broken));
+  TEST_ASSERT_FALSE(sequence.seek(demoFrames - 1, frame));
+}
+
+void test_throughput() {
+  const int rounds = 100;
+  uint32_t bytes = 0;
+  unsigned long start = micros();
+  for(int r=0;r<rounds;r++) {
+    TEST_ASSERT_TRUE(sequence.open("demo.vxs"));
+    for(int n=0;n<demoFrames;n++) {
+      sequence.next(previous, frame);
+      memcpy(&previous, &frame, sizeof(Frame));
+      sequence.prefetch();
+    }
+    File file = SD.open("demo.vxs");
+    bytes += file.size();
+  }
+  const unsigned long playing = micros() - start;
+  TEST_ASSERT_TRUE(isDemo(demoFrames - 1, frame));
+
+  start = micros();
+  for(int r=0;r<rounds;r++)
+    for(int n=0;n<demoFrames;n++)
+      sequence.seek((n*7)%demoFrames, frame);
+  const unsigned long seeking = micros() - start;
+
+  char message[200];
+  snprintf(message, sizeof(message),
+           "next %.0f frames/s (%.1f MB/s read), seek %.0f us a frame",
+           rounds*demoFrames*1e6/playing, bytes/(double)playing,
+           seeking/(double)(rounds*demoFrames));
+  TEST_MESSAGE(message);
+  // the player needs its frame rate with room to spare for drawing
+  TEST_ASSERT_TRUE(rounds*demoFrames*1e6/playing > 10*demoFps);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_reads_the_header);
+  RUN_TEST(test_next_plays_every_frame);
+  RUN_TEST(test_seek_lands_on_every_frame);
+  RUN_TEST(test_next_continues_after_seek);
+  RUN_TEST(test_rejects_other_files);
+  RUN_TEST(test_throughput);
+  return UNITY_END();
+}
@@ -0,0 +1,139 @@
+#include <unity.h>
+#include "../NativeCube.h"
+/* Sinus, Spin and Rainbow draw through VoxelShader. The reference animations below are the
+ * ones from before the shader, they compute every term for every voxel. Each pair is
+ * replayed for a whole run of the animation. */
+namespace {
+class ReferenceSinus : public Animation {
+private:
+  void init() { }
+  void draw(float dt) {
+    phase += PI*dt;
+    colorwheel.turn(-dt/10.0f);
+
+    for(int x=0;x < width;x++) {
+      X = cube.map(x, 0, width-1, -2, 2);
+      for(int z=0;z < depth;z++) {
+        Z = cube.map(z, 0, depth-1,-2,2);
+        Y = sinf(phase + sqrtf(X*X + Z*Z));
+        Y = round(cube.map(Y, -1, 1, 0, height-1));
+        cube.setVoxel(x,(int)Y,z, colorwheel.color(Y*0.01f));
+      }
+    }
+
+    if(phase/(4*PI) >= 1) {
+      phase-=4*PI;
+      restart();
+    }
+  }
+};
+
+class ReferenceRainbow : public Animation {
+private:
+  void init() {}
+  void draw(float dt) {
+    phase += PI/5*dt;
+    colorwheel.turn(sinf(phase)/3*dt);
+
+    for(int x=0;x<width;x++)
+    for(int y=0;y<height;y++)
+    for(int z=0;z<depth;z++)
+      cube.setVoxel(x,y,z, colorwheel.color(0.02f*x+0.01f*y+0.005f*z));
+
+    if(phase/(2*PI) >= 1) {
+      phase-=2*PI;
+      restart();
+    }
+  }
+};
+
+class ReferenceSpin : public Animation {
+private:
+  void init() { }
+  void draw(float dt) {
+    phase += 1.25*PI*dt;
+    colorwheel.turn(dt/2);
+
+    for(int x=0;x<width;x++)
+    for(int y=0;y<height;y++)
+    for(int z=0;z<depth;z++) {
+      X = (x-((width-1)/2))*sinf(phase+cube.map((float)y,0,height,0,distort));
+      Z = (z-((height-1)/2))*cosf(phase+cube.map((float)y,0,height,0,distort));
+      if(abs(X-Z) < .8) cube.setVoxel(x,y,z, colorwheel.color(0.02f*y));
+    }
+
+    distort+=0.01*PI*direction;
+    if(distort > 0.75*PI || distort < 0.25*PI)
+      direction*=-1;
+    if((phase/(10*PI)) >= 1) {
+      phase -= 10*PI;
+      restart();
+    }
+  }
+  int direction = 1;
+  float distort = 0.6*PI;
+};
+
+// the largest channel difference between two neighbouring colors of the wheel, as frames
+// store them
+int wheelStep() {
+  const float position = colorwheel.position();
+  colorwheel.setPosition(0);
+  const int size = 7*150;
+  int step = 0;
+  for(int i=0;i<size;i++) {
+    const Color a = Voxel(colorwheel.color((i + 0.5f)/size));
+    const Color b = Voxel(colorwheel.color((i + 1.5f)/size));
+    const int d[3] = { abs(a.R - b.R), abs(a.G - b.G), abs(a.B - b.B) };
+    for(int k=0;k<3;k++)
+      if(d[k] > step) step = d[k];
+  }
+  colorwheel.setPosition(position);
+  return step;
+}
+
+void report(const char* name, int error) {
+  char message[96];
+  snprintf(message, sizeof(message), "%s: largest channel error %d, a wheel step is %d",
+           name, error, wheelStep());
+  TEST_MESSAGE(message);
+}
+}
+
+void setUp() {
+  beginCube();
+}
+
+void tearDown() {}
+
+void test_sinus_draws_the_same_frames() {
+  // 4 seconds, until it restarts
+  ReferenceSinus reference;
+  Sinus sinus;
+  TEST_ASSERT_EQUAL(0, cube.compare(&reference, &sinus, 239));
+}
+
+void test_spin_draws_the_same_frames() {
+  // 8 seconds, until it restarts
+  ReferenceSpin reference;
+  Spin spin;
+  TEST_ASSERT_EQUAL(0, cube.compare(&reference, &spin, 479));
+}
+
+void test_rainbow_is_a_wheel_step_off_at_most() {
+  // 10 seconds, until it restarts. The color position is stepped along the rows, its
+  // float rounding puts a voxel now and then on the next step of the color wheel.
+  ReferenceRainbow reference;
+  Rainbow rainbow;
+  const int error = cube.compare(&reference, &rainbow, 599);
+  report("Rainbow", error);
+  TEST_ASSERT_LESS_OR_EQUAL(wheelStep(), error);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_sinus_draws_the_same_frames);
+  RUN_TEST(test_spin_draws_the_same_frames);
+  RUN_TEST(test_rainbow_is_a_wheel_step_off_at_most);
+  return UNITY_END();
+}
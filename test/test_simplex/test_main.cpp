@@ -0,0 +1,130 @@
+#include <unity.h>
+#include <math.h>
+#include "../NativeCube.h"
+#include "Noise.h"
+/* The fixed point simplex noise against the floating point algorithm of Gustavson, on the
+ * same permutation table. */
+namespace {
+const uint32_t seed = 1234;
+uint8_t perm[512];
+
+// the table SimplexNoise::seed builds
+void shuffle() {
+  NoiseGenerator random(seed);
+  for(int i=0;i<256;i++)
+    perm[i] = i;
+  for(int i=255;i>0;i--) {
+    int j = random.nextInt(i+1);
+    uint8_t t = perm[i];
+    perm[i] = perm[j];
+    perm[j] = t;
+  }
+  for(int i=256;i<512;i++)
+    perm[i] = perm[i & 255];
+}
+
+const int grad3[12][3] = {
+  { 1, 1, 0},{-1, 1, 0},{ 1,-1, 0},{-1,-1, 0},
+  { 1, 0, 1},{-1, 0, 1},{ 1, 0,-1},{-1, 0,-1},
+  { 0, 1, 1},{ 0,-1, 1},{ 0, 1,-1},{ 0,-1,-1}};
+
+double corner(int g, double x, double y, double z) {
+  double t = 0.6 - x*x - y*y - z*z;
+  if(t < 0)
+    return 0;
+  t *= t;
+  return t*t*(grad3[g][0]*x + grad3[g][1]*y + grad3[g][2]*z);
+}
+
+double reference(double x, double y, double z) {
+  const double F = 1.0/3, G = 1.0/6;
+  const double s = (x+y+z)*F;
+  const int i = floor(x+s), j = floor(y+s), k = floor(z+s);
+  const double t = (i+j+k)*G;
+  const double x0 = x-i+t, y0 = y-j+t, z0 = z-k+t;
+  int i1, j1, k1, i2, j2, k2;
+  if(x0 >= y0) {
+    if(y0 >= z0)      { i1=1; j1=0; k1=0; i2=1; j2=1; k2=0; }
+    else if(x0 >= z0) { i1=1; j1=0; k1=0; i2=1; j2=0; k2=1; }
+    else              { i1=0; j1=0; k1=1; i2=1; j2=0; k2=1; }
+  } else {
+    if(y0 < z0)       { i1=0; j1=0; k1=1; i2=0; j2=1; k2=1; }
+    else if(x0 < z0)  { i1=0; j1=1; k1=0; i2=0; j2=1; k2=1; }
+    else              { i1=0; j1=1; k1=0; i2=1; j2=1; k2=0; }
+  }
+  const int ii = i & 255, jj = j & 255, kk = k & 255;
+  const double n =
+    corner(perm[ii+perm[jj+perm[kk]]] % 12, x0, y0, z0) +
+    corner(perm[ii+i1+perm[jj+j1+perm[kk+k1]]] % 12, x0-i1+G, y0-j1+G, z0-k1+G) +
+    corner(perm[ii+i2+perm[jj+j2+perm[kk+k2]]] % 12, x0-i2+2*G, y0-j2+2*G, z0-k2+2*G) +
+    corner(perm[ii+1+perm[jj+1+perm[kk+1]]] % 12, x0-1+3*G, y0-1+3*G, z0-1+3*G);
+  return fmin(1, fmax(-1, 32*n));
+}
+
+int32_t fixed(double v) {
+  return lround(v*65536);
+}
+}
+
+void setUp() {
+  beginCube();
+}
+
+void tearDown() {}
+
+void test_noise3_follows_the_reference() {
+  shuffle();
+  SimplexNoise noise(seed);
+  NoiseGenerator random(99);
+  double worst = 0, low = 1, high = -1;
+  for(int n=0;n<100000;n++) {
+    const double x = random.nextRandom(-50, 50);
+    const double y = random.nextRandom(-50, 50);
+    const double z = random.nextRandom(-50, 50);
+    const double value = noise.noise(fixed(x), fixed(y), fixed(z))/65536.0;
+    worst = fmax(worst, fabs(value - reference(x, y, z)));
+    low = fmin(low, value);
+    high = fmax(high, value);
+  }
+  TEST_ASSERT_TRUE(worst < 0.007);
+  // the field uses most of its range
+  TEST_ASSERT_TRUE(low < -0.7 && high > 0.7);
+}
+
+void test_fill_matches_point_evaluation() {
+  SimplexNoise noise(seed);
+  const int size = 16;
+  static int16_t values[size][size][size];
+  const int32_t scale = 13107, offset[3] = { -70000, 123456, 5 }, w = 987654;
+  noise.fill(&values[0][0][0], size, size, size, scale, offset, w);
+  for(int x=0;x<size;x++)
+  for(int y=0;y<size;y++)
+  for(int z=0;z<size;z++) {
+    const int32_t n = noise.noise(offset[0] + x*scale, offset[1] + y*scale,
+                                  offset[2] + z*scale, w);
+    TEST_ASSERT_EQUAL(n >= 65536 ? 32767 : n >> 1, values[x][y][z]);
+  }
+}
+
+void test_noise4_stays_in_range() {
+  SimplexNoise noise(seed);
+  NoiseGenerator random(7);
+  double sum = 0;
+  const int count = 100000;
+  for(int n=0;n<count;n++) {
+    const int32_t value = noise.noise(random.nextInt(-3000000, 3000000),
+      random.nextInt(-3000000, 3000000), random.nextInt(-3000000, 3000000),
+      random.nextInt(-3000000, 3000000));
+    TEST_ASSERT_TRUE(value >= -65536 && value <= 65536);
+    sum += value/65536.0;
+  }
+  TEST_ASSERT_FLOAT_WITHIN(0.02, 0, sum/count);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_noise3_follows_the_reference);
+  RUN_TEST(test_fill_matches_point_evaluation);
+  RUN_TEST(test_noise4_stays_in_range);
+  return UNITY_END();
+}
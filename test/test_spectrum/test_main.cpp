@@ -0,0 +1,125 @@
+#include <unity.h>
+#include <vector>
+#include "../NativeCube.h"
+/* The audio pipeline fed from WAV files instead of the ADC. tones.wav has 0.2 seconds each
+ * of silence, 150Hz, 1kHz and 8kHz at half scale, 8 bit mono at AUDIO_RATE, written with
+ * the wave module of python. Other files have to be resampled to AUDIO_RATE first, for
+ * example with: sox music.wav -r 25600 -c 1 music_25600.wav */
+namespace {
+Spectrum audio;
+PrintLog report;
+
+uint32_t readLittle(File& file, int bytes) {
+  uint32_t v = 0;
+  for(int i=0;i<bytes;i++)
+    v |= (uint32_t)file.read() << (8*i);
+  return v;
+}
+
+/* PCM samples of a WAV file as 12 bit ADC values around the middle of the range, the
+ * channels mixed to one. Returns nothing for files it can't read or other sample rates. */
+std::vector<uint16_t> readWav(const char* name) {
+  std::vector<uint16_t> samples;
+  File file = SD.open(name);
+  if(!file)
+    return samples;
+  const uint32_t riff = readLittle(file, 4);
+  readLittle(file, 4);
+  if(riff != 0x46464952 || readLittle(file, 4) != 0x45564157)   // "RIFF" size "WAVE"
+    return samples;
+  int channels = 0, bits = 0;
+  while(file.available() >= 8) {
+    const uint32_t id = readLittle(file, 4);
+    const uint32_t size = readLittle(file, 4);
+    const uint32_t next = file.position() + size + (size & 1);
+    if(id == 0x20746D66) {                      // "fmt "
+      const int format = readLittle(file, 2);
+      channels = readLittle(file, 2);
+      const uint32_t rate = readLittle(file, 4);
+      readLittle(file, 6);
+      bits = readLittle(file, 2);
+      if(format != 1 || rate != AUDIO_RATE || (bits != 8 && bits != 16) || channels < 1)
+        return samples;
+    } else if(id == 0x61746164 && channels) {   // "data"
+      const int frame = channels*bits/8;
+      for(uint32_t n=0;n<size/frame;n++) {
+        int32_t sum = 0;
+        for(int c=0;c<channels;c++)
+          sum += bits == 8 ? ((int)readLittle(file, 1) - 128) << 8
+                           : (int16_t)readLittle(file, 2);
+        samples.push_back(2048 + (sum/channels >> 4));
+      }
+    }
+    file.seek(next);
+  }
+  return samples;
+}
+
+int loudestBand() {
+  int loudest = 0;
+  for(int b=1;b<Spectrum::numBands;b++)
+    if(audio.level(b) > audio.level(loudest)) loudest = b;
+  return loudest;
+}
+}
+
+void setUp() {
+  SD.setRoot(projectPath("test/test_spectrum").c_str());
+}
+
+void tearDown() {
+  SD.setRoot(".");
+}
+
+void test_fft_matches_a_dft() {
+  TEST_ASSERT_EQUAL(0, audio.check(report));
+  TEST_MESSAGE(report.text.substr(0, report.text.size() - 1).c_str());
+}
+
+void test_tones_light_their_bands() {
+  const std::vector<uint16_t> samples = readWav("tones.wav");
+  const int blocks = samples.size()/FixedFFT::size;
+  TEST_ASSERT_EQUAL(80, blocks);
+  // the band of every tone and the bands its window leaks into, -1 for silence
+  const int band[] = { -1, 0, 4, 8 };
+  const int first[] = { 0, 0, 4, 8 };
+  const int last[] = { 0, 2, 4, 8 };
+  for(int segment=0;segment<4;segment++) {
+    for(int n=0;n<blocks/4;n++)
+      audio.analyze(&samples[(segment*blocks/4 + n)*FixedFFT::size]);
+    // the level of the segment before has fallen back by now
+    for(int b=0;b<Spectrum::numBands;b++) {
+      if(b >= first[segment] && b <= last[segment] && band[segment] >= 0)
+        continue;
+      TEST_ASSERT_TRUE_MESSAGE(audio.level(b) < 0.5f, "a band without the tone is lit");
+    }
+    if(band[segment] < 0)
+      continue;
+    TEST_ASSERT_TRUE(loudestBand() >= first[segment] && loudestBand() <= last[segment]);
+    TEST_ASSERT_TRUE(audio.level(band[segment]) > 0.9f);
+  }
+}
+
+void test_block_time() {
+  const std::vector<uint16_t> samples = readWav("tones.wav");
+  const int blocks = samples.size()/FixedFFT::size;
+  const int rounds = 50;
+  const uint32_t start = ARM_DWT_CYCCNT;
+  for(int r=0;r<rounds;r++)
+    for(int n=0;n<blocks;n++)
+      audio.analyze(&samples[n*FixedFFT::size]);
+  const uint32_t cycles = (ARM_DWT_CYCCNT - start)/(rounds*blocks);
+  char message[128];
+  snprintf(message, sizeof(message), "tones.wav: %lu cycles a block, %lu us of every %d us",
+           (unsigned long)cycles, (unsigned long)(cycles/(F_CPU/1000000)),
+           1000000*FixedFFT::size/AUDIO_RATE);
+  TEST_MESSAGE(message);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_fft_matches_a_dft);
+  RUN_TEST(test_tones_light_their_bands);
+  RUN_TEST(test_block_time);
+  return UNITY_END();
+}
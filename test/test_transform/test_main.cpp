@@ -0,0 +1,101 @@
+#include <unity.h>
+#include "../NativeCube.h"
+/* Cube::transform resamples the rendering cube through a rotation, scale and offset around
+ * its center. */
+namespace {
+Color before[X_LAYERS][Y_LAYERS][Z_LAYERS];
+const Vector3 center((X_LAYERS-1)/2.0f, (Y_LAYERS-1)/2.0f, (Z_LAYERS-1)/2.0f);
+
+void drawRandom() {
+  for(int x=0;x<X_LAYERS;x++)
+  for(int y=0;y<Y_LAYERS;y++)
+  for(int z=0;z<Z_LAYERS;z++) {
+    Color c;
+    c.random();
+    cube.setVoxel(x, y, z, c);
+    // what the frame stores, 8 bit frames round the colors
+    before[x][y][z] = cube.getRenderingVoxel(x, y, z);
+  }
+}
+
+#ifdef FRAMEBUFFER_8BIT
+// 8 bit frames store a blend up to a step of 28 lower
+const int blendError = 28;
+#else
+const int blendError = 1;
+#endif
+
+bool same(Color a, Color b) {
+  return a.R == b.R && a.G == b.G && a.B == b.B;
+}
+}
+
+void setUp() {
+  beginCube();
+}
+
+void tearDown() {}
+
+void test_quarter_turn_moves_every_voxel() {
+  drawRandom();
+  Quaternion q(90, Vector3(0, 1, 0));
+  q.convertAxisAngle();
+  cube.transform(q, 1, Vector3(0, 0, 0), Cube::NEAREST);
+  for(int x=0;x<X_LAYERS;x++)
+  for(int y=0;y<Y_LAYERS;y++)
+  for(int z=0;z<Z_LAYERS;z++) {
+    // where the voxel went
+    Vector3 p = q.rotated(Vector3(x, y, z) - center) + center;
+    const int tx = lroundf(p.x), ty = lroundf(p.y), tz = lroundf(p.z);
+    TEST_ASSERT_TRUE(same(before[x][y][z], cube.getRenderingVoxel(tx, ty, tz)));
+  }
+}
+
+void test_identity_keeps_the_frame() {
+  drawRandom();
+  cube.transform(Quaternion(1, Vector3(0, 0, 0)), 1, Vector3(0, 0, 0), Cube::TRILINEAR);
+  for(int x=0;x<X_LAYERS;x++)
+  for(int y=0;y<Y_LAYERS;y++)
+  for(int z=0;z<Z_LAYERS;z++)
+    TEST_ASSERT_TRUE(same(before[x][y][z], cube.getRenderingVoxel(x, y, z)));
+}
+
+void test_offset_moves_and_blacks_out() {
+  drawRandom();
+  cube.transform(Quaternion(1, Vector3(0, 0, 0)), 1, Vector3(1, 0, 0), Cube::NEAREST);
+  for(int y=0;y<Y_LAYERS;y++)
+  for(int z=0;z<Z_LAYERS;z++) {
+    TEST_ASSERT_TRUE(cube.getRenderingVoxel(0, y, z).isBlack());
+    for(int x=1;x<X_LAYERS;x++)
+      TEST_ASSERT_TRUE(same(before[x-1][y][z], cube.getRenderingVoxel(x, y, z)));
+  }
+}
+
+void test_half_way_blends_neighbours() {
+  drawRandom();
+  cube.transform(Quaternion(1, Vector3(0, 0, 0)), 1, Vector3(0, 0, 0.5f), Cube::TRILINEAR);
+  for(int x=0;x<X_LAYERS;x++)
+  for(int y=0;y<Y_LAYERS;y++)
+  for(int z=1;z<Z_LAYERS;z++) {
+    const Color a = before[x][y][z-1], b = before[x][y][z];
+    TEST_ASSERT_INT_WITHIN(blendError, (a.R + b.R)/2, cube.getRenderingVoxel(x, y, z).R);
+  }
+}
+
+void test_scale_keeps_the_center() {
+  drawRandom();
+  cube.transform(Quaternion(1, Vector3(0, 0, 0)), 2, Vector3(0, 0, 0), Cube::NEAREST);
+  const int cx = X_LAYERS/2, cy = Y_LAYERS/2, cz = Z_LAYERS/2;
+  TEST_ASSERT_TRUE(same(before[cx][cy][cz], cube.getRenderingVoxel(cx, cy, cz)));
+  TEST_ASSERT_TRUE(same(before[cx+1][cy][cz], cube.getRenderingVoxel(cx+2, cy, cz)));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_quarter_turn_moves_every_voxel);
+  RUN_TEST(test_identity_keeps_the_frame);
+  RUN_TEST(test_offset_moves_and_blacks_out);
+  RUN_TEST(test_half_way_blends_neighbours);
+  RUN_TEST(test_scale_keeps_the_center);
+  return UNITY_END();
+}
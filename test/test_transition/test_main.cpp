@@ -0,0 +1,130 @@
+#include <unity.h>
+#include "../NativeCube.h"
+/* Transitions between animations: Cube::blend gives every voxel a weight of the outgoing
+ * frame and the packer blends that frame over the displayed cube. Every transition starts
+ * with the outgoing frame only and ends with the incoming one only, which the tests check
+ * on the weights and on the bits the TLC's latch. */
+namespace {
+const Cube::Transition transitions[] = { Cube::CUT, Cube::CROSSFADE, Cube::WIPE_X,
+  Cube::WIPE_Y, Cube::WIPE_Z, Cube::DISSOLVE };
+const char* names[] = { "CUT", "CROSSFADE", "WIPE_X", "WIPE_Y", "WIPE_Z", "DISSOLVE" };
+const int voxels = X_LAYERS*Y_LAYERS*Z_LAYERS;
+// the lowest bits the TLC's don't count, and the most a dither threshold adds before that
+const int shift = 12 - __builtin_ctz(GSCNT);
+const int threshold = (1 << shift) - 1;
+
+Frame outgoing;
+
+void randomFrames() {
+  for(int x=0;x<X_LAYERS;x++)
+  for(int y=0;y<Y_LAYERS;y++)
+  for(int z=0;z<Z_LAYERS;z++) {
+    Color c;
+    c.random();
+    cube.setVoxel(x, y, z, c);
+    c.random();
+    outgoing[x][y][z] = c;
+  }
+  cube.update();
+}
+
+// the value every channel gets on XLAT after the channel buffers were sent, see test_packer
+void latchChains(uint16_t* latched) {
+  for(int bus = 0; bus < SPI_BUSES; bus++) {
+    const uint8_t* sent = cube.channelBuffer(bus);
+    uint8_t reg[BUSBYTES] = {};
+    for(int i = 0; i < BUSBITS; i++) {
+      uint8_t in = (sent[i/8] >> (7 - i%8)) & 1;
+      for(int j = BUSBYTES-1; j > 0; j--)
+        reg[j] = (reg[j] << 1) | (reg[j-1] >> 7);
+      reg[0] = (reg[0] << 1) | in;
+    }
+    for(int channel = 0; channel < BUSCHANNELS; channel++) {
+      int first = channel*12;
+      uint16_t value = 0;
+      for(int b = 11; b >= 0; b--)
+        value = (value << 1) | ((reg[(first+b)/8] >> ((first+b)%8)) & 1);
+      latched[bus*BUSCHANNELS + channel] = value;
+    }
+  }
+}
+
+// packs every layer with the weights of progress and checks that it latches the frame
+// the transition shows then
+void checkPacked(int progress, const char* name) {
+  cube.setOverlay(&outgoing, cube.blend(progress));
+  uint16_t latched[CHANNELS];
+  for(int y=0;y<Y_LAYERS;y++) {
+    cube.setChannelBuffer(y);
+    latchChains(latched);
+    for(int x=0;x<X_LAYERS;x++)
+    for(int z=0;z<Z_LAYERS;z++) {
+      const Color c = progress ? (Color)cube.getDisplayedVoxel(x, y, z)
+                               : (Color)outgoing[x][y][z];
+      const uint16_t values[3] = { c.B, c.G, c.R };
+      for(int k=0;k<3;k++) {
+        const uint16_t value = latched[cube.ledChannels(x, z)[k]];
+        TEST_ASSERT_TRUE_MESSAGE(value == values[k] >> shift ||
+                                 value == (values[k] + threshold) >> shift, name);
+      }
+    }
+  }
+  cube.setOverlay(nullptr, nullptr);
+}
+}
+
+void setUp() {
+  beginCube();
+  cube.setLayerBudget(0);
+}
+
+void tearDown() {
+  cube.setOverlay(nullptr, nullptr);
+  cube.setTransition(Cube::CROSSFADE, 1);
+  cube.resetStats();
+}
+
+void test_weights_go_from_outgoing_to_incoming() {
+  for(int t=0;t<6;t++) {
+    cube.setTransition(transitions[t], 1);
+    const uint8_t* weights = cube.blend(0);
+    for(int v=0;v<voxels;v++)
+      TEST_ASSERT_EQUAL_MESSAGE(255, weights[v], names[t]);
+    weights = cube.blend(256);
+    for(int v=0;v<voxels;v++)
+      TEST_ASSERT_EQUAL_MESSAGE(0, weights[v], names[t]);
+  }
+}
+
+void test_weights_never_come_back() {
+  // once a voxel shows more of the incoming frame it doesn't go back to the outgoing one
+  static uint8_t before[voxels];
+  for(int t=0;t<6;t++) {
+    cube.setTransition(transitions[t], 1);
+    memcpy(before, cube.blend(0), voxels);
+    for(int progress=1;progress<=256;progress++) {
+      const uint8_t* weights = cube.blend(progress);
+      for(int v=0;v<voxels;v++)
+        TEST_ASSERT_TRUE_MESSAGE(weights[v] <= before[v], names[t]);
+      memcpy(before, weights, voxels);
+    }
+  }
+}
+
+void test_packer_shows_outgoing_then_incoming() {
+  generator.seed(7);
+  randomFrames();
+  for(int t=0;t<6;t++) {
+    cube.setTransition(transitions[t], 1);
+    checkPacked(0, names[t]);
+    checkPacked(256, names[t]);
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_weights_go_from_outgoing_to_incoming);
+  RUN_TEST(test_weights_never_come_back);
+  RUN_TEST(test_packer_shows_outgoing_then_incoming);
+  return UNITY_END();
+}
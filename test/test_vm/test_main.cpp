@@ -0,0 +1,115 @@
+#include <unity.h>
+#include <vector>
+#include "../NativeCube.h"
+#include "VoxelVM.h"
+/* The voxel VM against the assembler and the animations its programs copy. The programs
+ * of tools/programs are assembled by tools/cubeasm.py, those tests are ignored without
+ * python3. */
+namespace {
+const char* bytecode = "vm_test.vxb";
+
+// assembles a program of tools/programs, returns nothing when the assembler fails
+std::vector<uint8_t> assemble(const char* name) {
+  std::vector<uint8_t> code;
+  char command[1024];
+  snprintf(command, sizeof(command), "python3 %s %s --output %s/%s > /dev/null",
+           projectPath("tools/cubeasm.py").c_str(),
+           projectPath((std::string("tools/programs/") + name).c_str()).c_str(),
+           P_tmpdir, bytecode);
+  if(system(command) != 0)
+    return code;
+  File file = SD.open(bytecode);
+  for(int c = file.read(); c >= 0; c = file.read())
+    code.push_back(c);
+  return code;
+}
+
+void checkProgram(const char* name, const uint8_t* builtIn, int length) {
+  if(!hasPython())
+    TEST_IGNORE_MESSAGE("python3 is needed to assemble the programs");
+  const std::vector<uint8_t> code = assemble(name);
+  TEST_ASSERT_TRUE_MESSAGE(code.size() > 0, name);
+  TEST_ASSERT_TRUE(VoxelVM::validate(code.data(), code.size()));
+  // the copy in VoxelVM.cpp is the assembled source
+  TEST_ASSERT_EQUAL(length, (int)code.size());
+  TEST_ASSERT_EQUAL_MEMORY(builtIn, code.data(), length);
+}
+}
+
+void setUp() {
+  beginCube();
+  SD.setRoot(P_tmpdir);
+}
+
+void tearDown() {
+  SD.remove(bytecode);
+  SD.setRoot(".");
+}
+
+void test_assembles_rainbow() {
+  checkProgram("rainbow.vxa", VoxelVM::rainbow, VoxelVM::rainbowLength);
+}
+
+void test_assembles_sinus() {
+  checkProgram("sinus.vxa", VoxelVM::sinus, VoxelVM::sinusLength);
+}
+
+void test_validate_rejects_broken_programs() {
+  const uint8_t x = VoxelVM::OP_X, one[] = { 0x00, 0x00, 0x01, 0x00 };
+  // X 1 PALETTE is fine, the ones below are not
+  const uint8_t good[] = { x, VoxelVM::OP_PUSH, one[0], one[1], one[2], one[3],
+                           VoxelVM::OP_PALETTE };
+  TEST_ASSERT_TRUE(VoxelVM::validate(good, sizeof(good)));
+  const uint8_t underflow[] = { x, VoxelVM::OP_PALETTE };
+  TEST_ASSERT_FALSE(VoxelVM::validate(underflow, sizeof(underflow)));
+  const uint8_t leftover[] = { x, x, x, VoxelVM::OP_PALETTE };
+  TEST_ASSERT_FALSE(VoxelVM::validate(leftover, sizeof(leftover)));
+  const uint8_t noOutput[] = { x, VoxelVM::OP_DROP };
+  TEST_ASSERT_FALSE(VoxelVM::validate(noOutput, sizeof(noOutput)));
+  const uint8_t cutPush[] = { x, VoxelVM::OP_PUSH, one[0], one[1] };
+  TEST_ASSERT_FALSE(VoxelVM::validate(cutPush, sizeof(cutPush)));
+  const uint8_t unknown[] = { x, x, VoxelVM::numOpcodes, VoxelVM::OP_PALETTE };
+  TEST_ASSERT_FALSE(VoxelVM::validate(unknown, sizeof(unknown)));
+  uint8_t overflow[VoxelVM::maxStack + 3];
+  memset(overflow, x, sizeof(overflow));
+  overflow[sizeof(overflow) - 1] = VoxelVM::OP_PALETTE;
+  TEST_ASSERT_FALSE(VoxelVM::validate(overflow, sizeof(overflow)));
+  const uint8_t afterOutput[] = { x, x, VoxelVM::OP_PALETTE, x };
+  TEST_ASSERT_FALSE(VoxelVM::validate(afterOutput, sizeof(afterOutput)));
+}
+
+void test_programs_draw_their_animations() {
+  // all of Rainbow, until it restarts after 10 seconds
+  Rainbow rainbow;
+  Bytecode rainbowProgram(VoxelVM::rainbow, VoxelVM::rainbowLength);
+  const int rainbowError = cube.compare(&rainbow, &rainbowProgram, 599);
+  // Sinus rounds its wave to whole voxels, after about 3 seconds the fixed point puts a
+  // column on the other side of a tie. The 2 seconds of Bytecode::check don't have one.
+  Sinus sinus;
+  Bytecode sinusProgram(VoxelVM::sinus, VoxelVM::sinusLength);
+  const int sinusError = cube.compare(&sinus, &sinusProgram);
+  char message[128];
+  snprintf(message, sizeof(message), "largest channel error rainbow %d, sinus %d",
+           rainbowError, sinusError);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_LESS_OR_EQUAL(Bytecode::maxCheckError, rainbowError);
+  TEST_ASSERT_LESS_OR_EQUAL(Bytecode::maxCheckError, sinusError);
+}
+
+void test_check_compares_both_programs() {
+  PrintLog log;
+  TEST_ASSERT_EQUAL(0, Bytecode::check(log));
+  TEST_ASSERT_EQUAL(1, log.count("rainbow: "));
+  TEST_ASSERT_EQUAL(1, log.count("sinus: "));
+  TEST_ASSERT_EQUAL(2, log.count("largest channel error"));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_assembles_rainbow);
+  RUN_TEST(test_assembles_sinus);
+  RUN_TEST(test_validate_rejects_broken_programs);
+  RUN_TEST(test_programs_draw_their_animations);
+  RUN_TEST(test_check_compares_both_programs);
+  return UNITY_END();
+}
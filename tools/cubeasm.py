@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+"""Assembles programs for the voxel VM of the cube and uploads them.
+
+A program is a list of words separated by spaces or new lines, ';' starts a comment.
+Numbers are pushed on the stack, every other word is an instruction. See src/VoxelVM.h
+for the instructions.
+
+    python3 tools/cubeasm.py tools/programs/sinus.vxa --port /dev/ttyACM0
+
+assembles a program and sends it to the cube, which keeps it in EEPROM and shows it as
+one of its animations.
+
+    python3 tools/cubeasm.py tools/programs/sinus.vxa --list
+
+prints the assembled program with the stack depth after every instruction. --output
+writes the bytecode to a file, test/test_vm checks the programs that way.
+"""
+import argparse
+import struct
+import sys
+
+OPCODES = ['PUSH', 'X', 'Y', 'Z', 'T', 'DUP', 'DROP', 'SWAP', 'OVER',
+           'ADD', 'SUB', 'MUL', 'DIV', 'MIN', 'MAX', 'LESS',
+           'NEG', 'ABS', 'FLOOR', 'FRACT', 'SQRT', 'SIN', 'COS', 'NOISE',
+           'PALETTE', 'RGB']
+# values taken from and put on the stack
+EFFECTS = {'PUSH': (0, 1), 'X': (0, 1), 'Y': (0, 1), 'Z': (0, 1), 'T': (0, 1),
+           'DUP': (1, 2), 'DROP': (1, 0), 'SWAP': (2, 2), 'OVER': (2, 3),
+           'NOISE': (4, 1), 'PALETTE': (2, 0), 'RGB': (3, 0)}
+for name in ('ADD', 'SUB', 'MUL', 'DIV', 'MIN', 'MAX', 'LESS'):
+    EFFECTS[name] = (2, 1)
+for name in ('NEG', 'ABS', 'FLOOR', 'FRACT', 'SQRT', 'SIN', 'COS'):
+    EFFECTS[name] = (1, 1)
+OUTPUTS = ('PALETTE', 'RGB')
+MAX_CODE = 256
+MAX_STACK = 8
+PROGRAM = ord('P')
+
+
+class AsmError(Exception):
+    pass
+
+
+def parse(text):
+    """Returns the instructions of a program as (name, constant) pairs."""
+    program = []
+    for number, line in enumerate(text.splitlines(), 1):
+        for word in line.split(';')[0].split():
+            try:
+                value = float(word)
+            except ValueError:
+                name = word.upper()
+                if name not in OPCODES or name == 'PUSH':
+                    raise AsmError('line %d: unknown instruction %s' % (number, word))
+                program.append((name, None))
+            else:
+                raw = int(round(value * 65536))
+                if not -2**31 <= raw < 2**31:
+                    raise AsmError('line %d: %s doesn\'t fit in Q16.16' % (number, word))
+                program.append(('PUSH', raw))
+    return program
+
+
+def check(program):
+    """Raises AsmError unless the device would load the program, returns the stack depth
+    after every instruction."""
+    depth = 0
+    depths = []
+    for i, (name, _) in enumerate(program):
+        pops, pushes = EFFECTS[name]
+        if depth < pops:
+            raise AsmError('instruction %d (%s) needs %d values, the stack has %d' %
+                           (i, name, pops, depth))
+        depth += pushes - pops
+        if depth > MAX_STACK:
+            raise AsmError('instruction %d (%s) grows the stack past %d' % (i, name, MAX_STACK))
+        depths.append(depth)
+        if name in OUTPUTS:
+            if i != len(program) - 1:
+                raise AsmError('%s has to be the last instruction' % name)
+            if depth:
+                raise AsmError('%d values are left on the stack' % depth)
+    if not program or program[-1][0] not in OUTPUTS:
+        raise AsmError('a program ends with PALETTE or RGB')
+    return depths
+
+
+def assemble(text):
+    """Returns the bytecode of a program."""
+    program = parse(text)
+    check(program)
+    code = bytearray()
+    for name, value in program:
+        code.append(OPCODES.index(name))
+        if name == 'PUSH':
+            code += struct.pack('<i', value)
+    if len(code) > MAX_CODE:
+        raise AsmError('the program takes %d bytes, the cube has room for %d' %
+                       (len(code), MAX_CODE))
+    return bytes(code)
+
+
+def disassemble(code):
+    """Returns the instructions of bytecode as (name, constant) pairs."""
+    program = []
+    i = 0
+    while i < len(code):
+        if code[i] >= len(OPCODES):
+            raise AsmError('byte %d: unknown opcode %d' % (i, code[i]))
+        name = OPCODES[code[i]]
+        i += 1
+        if name == 'PUSH':
+            program.append((name, struct.unpack_from('<i', code, i)[0]))
+            i += 4
+        else:
+            program.append((name, None))
+    return program
+
+
+def message(code):
+    """Wraps bytecode in a message of the frame protocol, see src/FrameCodec.h."""
+    checksum = 0
+    for b in code:
+        checksum ^= b
+    return b'VX' + struct.pack('<BH', PROGRAM, len(code)) + code + bytes((checksum,))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('source')
+    parser.add_argument('--port', help='serial port of the cube to upload to')
+    parser.add_argument('--list', action='store_true', help='print the assembled program')
+    parser.add_argument('--c', action='store_true', help='print the bytecode as a C array')
+    parser.add_argument('--output', help='write the bytecode to a file')
+    args = parser.parse_args()
+
+    with open(args.source) as f:
+        text = f.read()
+    try:
+        code = assemble(text)
+    except AsmError as e:
+        print('%s: %s' % (args.source, e), file=sys.stderr)
+        return 1
+    if args.list:
+        program = disassemble(code)
+        for (name, value), depth in zip(program, check(program)):
+            operand = '%g' % (value / 65536) if value is not None else ''
+            print('%-8s %-10s depth %d' % (name, operand, depth))
+    if args.c:
+        for i in range(0, len(code), 12):
+            print('  ' + ' '.join('0x%02X,' % b for b in code[i:i + 12]))
+    if args.output:
+        with open(args.output, 'wb') as f:
+            f.write(code)
+    if args.port:
+        import serial
+        with serial.Serial(args.port, 12000000) as port:
+            port.write(message(code))
+    print('%d instructions, %d bytes' % (len(disassemble(code)), len(code)))
+
+
+if __name__ == '__main__':
+    sys.exit(main())
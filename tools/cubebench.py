@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+"""Collects the benchmark of the cube and compares it with an earlier run.
+
+Build the firmware with -D BENCHMARK, it replays every animation and times some kernels at
+startup and prints a line of JSON per result. This script reads those lines from the
+serial port, or from a file when the output was saved some other way.
+
+    python3 tools/cubebench.py --port /dev/ttyACM0 --save before.json
+
+keeps the results of a run.
+
+    python3 tools/cubebench.py --port /dev/ttyACM0 --baseline before.json --threshold 5
+
+compares a new run with it and exits with status 1 when something got more than 5%
+slower. --json prints the comparison as JSON instead of a table.
+
+The same benchmark runs on a PC in the native_benchmark environment of platformio.ini:
+
+    pio test -e native_benchmark -v | python3 tools/cubebench.py --input - --save pc.json
+
+Those cycles are the time of the PC counted at the clock of the Teensy, compare them only
+with other runs on the same PC.
+"""
+import argparse
+import json
+import sys
+
+# the last result the cube prints
+LAST = 'setChannelBuffer'
+
+
+def read_results(lines):
+    """Returns the results of the benchmark lines as a dict from name to result."""
+    results = {}
+    for line in lines:
+        line = line.strip()
+        if not line.startswith('{'):
+            continue
+        result = json.loads(line)
+        results[result['name']] = {'cycles': result['cycles'], 'max': result['max']}
+        if result['name'] == LAST:
+            break
+    return results
+
+
+def serial_lines(port, timeout):
+    import serial
+    with serial.Serial(port, 115200, timeout=timeout) as s:
+        while True:
+            line = s.readline()
+            if not line:
+                return
+            yield line.decode('ascii', 'replace')
+
+
+def compare(results, baseline, threshold):
+    """Returns a list of comparisons, a result regressed when its cycles grew by more
+    than threshold percent."""
+    rows = []
+    for name, result in results.items():
+        row = {'name': name, 'cycles': result['cycles'], 'max': result['max']}
+        before = baseline.get(name)
+        if before and before['cycles']:
+            change = 100.0 * (result['cycles'] - before['cycles']) / before['cycles']
+            row.update(baseline=before['cycles'], change=round(change, 1),
+                       regressed=change > threshold)
+        rows.append(row)
+    return rows
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument('--port', help='serial port of the cube')
+    source.add_argument('--input', help='file with the output of the cube, - for stdin')
+    parser.add_argument('--timeout', type=float, default=30,
+                        help='seconds to wait for the next line from the cube')
+    parser.add_argument('--save', help='write the results to this file')
+    parser.add_argument('--baseline', help='results of an earlier run to compare with')
+    parser.add_argument('--threshold', type=float, default=5,
+                        help='percent of extra cycles that counts as a regression')
+    parser.add_argument('--json', action='store_true', help='print the comparison as JSON')
+    args = parser.parse_args()
+
+    if args.port:
+        results = read_results(serial_lines(args.port, args.timeout))
+    elif args.input == '-':
+        results = read_results(sys.stdin)
+    else:
+        with open(args.input) as f:
+            results = read_results(f)
+    if not results:
+        print('no benchmark results, is the firmware built with -D BENCHMARK?',
+              file=sys.stderr)
+        return 2
+    if args.save:
+        with open(args.save, 'w') as f:
+            json.dump(results, f, indent=1)
+
+    baseline = {}
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+    rows = compare(results, baseline, args.threshold)
+    if args.json:
+        json.dump(rows, sys.stdout, indent=1)
+        print()
+    else:
+        for row in rows:
+            line = '%-22s %10d cycles %10d max' % (row['name'], row['cycles'], row['max'])
+            if 'change' in row:
+                line += ' %+7.1f%%%s' % (row['change'], ' REGRESSED' if row['regressed'] else '')
+            print(line)
+    return 1 if any(row.get('regressed') for row in rows) else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+"""Shows what the cube displays, from the frames it sends back over USB serial.
+
+Build the firmware with -D MIRROR=30 and the cube sends up to 30 of its displayed frames a
+second, in the format of src/FrameCodec.h. This script decodes them exactly as they were
+shown and reports the frames per second and bytes per frame.
+
+    python3 tools/cubemirror.py --port /dev/ttyACM0 --record show.vxs --fps 30
+
+also keeps the frames as a sequence for the SD card, see tools/cubeseq.py. --input reads a
+file or terminal instead of the port, test/test_mirror feeds it through a pseudo terminal.
+"""
+import argparse
+import struct
+import sys
+import time
+
+from cubestream import VOXELS, KEYFRAME, DELTA
+from cubeseq import decode_payload, encode_sequence
+
+
+class MirrorDecoder:
+    """Turns the bytes from the cube into frames. Bytes that aren't part of a frame, like
+    text the cube prints, are skipped. Deltas are ignored until the first keyframe."""
+
+    def __init__(self):
+        self.buffer = bytearray()
+        self.frame = None
+        self.frames = 0
+        self.bytes = 0
+        self.errors = 0
+
+    def feed(self, data):
+        """Returns the frames that are complete after data."""
+        self.buffer += data
+        frames = []
+        while True:
+            start = self.buffer.find(b'VX')
+            if start < 0:
+                del self.buffer[:max(0, len(self.buffer) - 1)]
+                return frames
+            del self.buffer[:start]
+            if len(self.buffer) < 5:
+                return frames
+            kind, length = struct.unpack_from('<BH', self.buffer, 2)
+            if kind not in (KEYFRAME, DELTA) or length > VOXELS * 6:
+                del self.buffer[:2]
+                continue
+            if len(self.buffer) < 5 + length + 1:
+                return frames
+            payload = bytes(self.buffer[5:5 + length])
+            checksum = 0
+            for b in payload:
+                checksum ^= b
+            if checksum != self.buffer[5 + length]:
+                self.errors += 1
+                del self.buffer[:2]
+                continue
+            del self.buffer[:5 + length + 1]
+            if kind == DELTA and self.frame is None:
+                continue
+            self.frame = decode_payload(kind, payload, self.frame)
+            self.frames += 1
+            self.bytes += 5 + length + 1
+            frames.append(self.frame)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument('--port', help='serial port of the cube')
+    source.add_argument('--input', help='file with bytes from the cube, - for stdin')
+    parser.add_argument('--record', help='write the frames to a sequence file')
+    parser.add_argument('--fps', type=int, default=30, help='frame rate of the recording')
+    parser.add_argument('--seconds', type=float, help='stop after this many seconds')
+    parser.add_argument('--frames', type=int, help='stop after this many frames')
+    args = parser.parse_args()
+
+    if args.port:
+        import serial
+        stream = serial.Serial(args.port, 12000000, timeout=0.1)
+        read = lambda: stream.read(4096)
+    else:
+        stream = sys.stdin.buffer if args.input == '-' else open(args.input, 'rb')
+        read = lambda: stream.read1(4096) if hasattr(stream, 'read1') else stream.read(4096)
+
+    decoder = MirrorDecoder()
+    recorded = []
+    start = report = time.time()
+    reported = (0, 0)
+    try:
+        while args.seconds is None or time.time() - start < args.seconds:
+            if args.frames is not None and decoder.frames >= args.frames:
+                break
+            try:
+                data = read()
+            except OSError:
+                # a terminal that was closed on the other side
+                break
+            if not data and not args.port:
+                break
+            frames = decoder.feed(data)
+            if args.record:
+                recorded += frames
+            if time.time() - report >= 1:
+                frames, sent = decoder.frames - reported[0], decoder.bytes - reported[1]
+                print('%d frames/s, %d bytes/frame' % (frames, sent // max(frames, 1)))
+                report, reported = time.time(), (decoder.frames, decoder.bytes)
+    except KeyboardInterrupt:
+        pass
+    print('%d frames, %d bytes/frame, %d bad messages' %
+          (decoder.frames, decoder.bytes // max(decoder.frames, 1), decoder.errors))
+    if args.record and recorded:
+        with open(args.record, 'wb') as f:
+            f.write(encode_sequence(recorded, args.fps))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""Records frame sequences for playback from the cube's SD card.
+
+Frames are encoded with the codec from cubestream.py, see src/Sequence.h for the file
+layout. A keyframe is written every --keyframes frames so the player can seek.
+
+    python3 tools/cubeseq.py cube.vxs --fps 30 --seconds 20
+
+writes the demo pattern, copy the file to the root of the SD card as cube.vxs.
+
+    python3 tools/cubeseq.py cube.vxs --check
+
+decodes a file again and reports its frames and size.
+"""
+import argparse
+import struct
+import sys
+
+from cubestream import (WIDTH, HEIGHT, DEPTH, VOXELS, KEYFRAME, DELTA, SKIP, LITERAL, FILL,
+                        encode_keyframe, encode_delta, demo_frame)
+
+MAGIC = b'VXS1'
+HEADER = struct.Struct('<4sBBBBII')
+
+
+def encode_sequence(frames, fps, keyframes=30):
+    """Returns the file contents for a list of frames."""
+    body = bytearray()
+    index = []
+    previous = None
+    for n, frame in enumerate(frames):
+        payload, kind = encode_keyframe(frame), KEYFRAME
+        if previous is not None and n % keyframes:
+            delta = encode_delta(frame, previous)
+            if len(delta) < len(payload):
+                payload, kind = delta, DELTA
+        index.append(HEADER.size + len(body))
+        body += struct.pack('<BH', kind, len(payload)) + payload
+        previous = frame
+    header = HEADER.pack(MAGIC, WIDTH, HEIGHT, DEPTH, fps, len(frames), HEADER.size + len(body))
+    return header + body + struct.pack('<%dI' % len(index), *index)
+
+
+def unpack_channels(data, n):
+    channels = []
+    for i in range(n):
+        p = i * 3 // 2
+        if i % 2:
+            channels.append(((data[p] & 0x0F) << 8) | data[p + 1])
+        else:
+            channels.append((data[p] << 4) | (data[p + 1] >> 4))
+    return channels
+
+
+def unpack_colors(data, n):
+    channels = unpack_channels(data, n * 3)
+    return [tuple(channels[i:i + 3]) for i in range(0, len(channels), 3)]
+
+
+def decode_payload(kind, payload, previous):
+    """Decodes one payload the same way src/FrameCodec.cpp does."""
+    if kind == KEYFRAME:
+        return unpack_colors(payload, VOXELS)
+    if kind != DELTA:
+        raise ValueError('unknown frame type %r' % kind)
+    frame = list(previous)
+    i = p = 0
+    while p < len(payload):
+        run = payload[p]
+        p += 1
+        n = (run & 0x3F) + 1
+        if run & 0xC0 == LITERAL:
+            frame[i:i + n] = unpack_colors(payload[p:], n)
+            p += (n * 9 + 1) // 2
+        elif run & 0xC0 == FILL:
+            frame[i:i + n] = unpack_colors(payload[p:], 1) * n
+            p += 5
+        elif run & 0xC0 != SKIP:
+            raise ValueError('bad run %#x' % run)
+        i += n
+    return frame
+
+
+def decode_sequence(data):
+    """Returns (fps, frames) for the contents of a file."""
+    magic, width, height, depth, fps, count, index_offset = HEADER.unpack_from(data)
+    if magic != MAGIC or (width, height, depth) != (WIDTH, HEIGHT, DEPTH):
+        raise ValueError('not a sequence for this cube')
+    index = struct.unpack_from('<%dI' % count, data, index_offset)
+    frames = []
+    previous = [(0, 0, 0)] * VOXELS
+    for offset in index:
+        kind, length = struct.unpack_from('<BH', data, offset)
+        payload = data[offset + 3:offset + 3 + length]
+        previous = decode_payload(kind, payload, previous)
+        frames.append(previous)
+    return fps, frames
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('file')
+    parser.add_argument('--fps', type=int, default=30)
+    parser.add_argument('--seconds', type=float, default=20)
+    parser.add_argument('--keyframes', type=int, default=30,
+                        help='frames between keyframes')
+    parser.add_argument('--check', action='store_true', help='decode an existing file')
+    args = parser.parse_args()
+
+    if args.check:
+        with open(args.file, 'rb') as f:
+            data = f.read()
+        fps, frames = decode_sequence(data)
+        print('%d frames at %d fps, %.0f bytes/frame' % (len(frames), fps, len(data) / len(frames)))
+        return
+    frames = [demo_frame(n / args.fps * 2) for n in range(int(args.seconds * args.fps))]
+    data = encode_sequence(frames, args.fps, args.keyframes)
+    with open(args.file, 'wb') as f:
+        f.write(data)
+    print('%d frames, %d bytes' % (len(frames), len(data)))
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,167 @@
+#!/usr/bin/env python3
+"""Streams frames from a PC to the led cube over USB serial.
+
+A frame is a list of (R, G, B) tuples with 12 bit channels, one per voxel in the memory
+order of the cube (x, then y, then z). See src/FrameCodec.h for the wire format.
+
+    python3 tools/cubestream.py /dev/ttyACM0 --fps 60
+
+streams a demo pattern and prints the achieved frames per second. Without pyserial the
+port is opened as a file, which works for the pseudo terminal of test/test_loopback.
+
+    python3 tools/cubestream.py --output test/test_codec/demo.vxstream --frames 40
+
+writes the stream into a file as fast as it is encoded, test/test_codec decodes that file.
+"""
+import argparse
+import math
+import struct
+import sys
+import time
+
+WIDTH = HEIGHT = DEPTH = 9
+VOXELS = WIDTH * HEIGHT * DEPTH
+
+KEYFRAME = ord('K')
+DELTA = ord('D')
+SKIP, LITERAL, FILL = 0x00, 0x40, 0x80
+MAX_RUN = 64
+
+
+def pack_channels(channels):
+    """Packs 12 bit values MSB first, 2 channels in 3 bytes, padded to a whole byte."""
+    out = bytearray()
+    for i in range(0, len(channels) - 1, 2):
+        a, b = channels[i], channels[i + 1]
+        out += bytes((a >> 4, ((a & 0x0F) << 4) | (b >> 8), b & 0xFF))
+    if len(channels) % 2:
+        a = channels[-1]
+        out += bytes((a >> 4, (a & 0x0F) << 4))
+    return out
+
+
+def pack_colors(colors):
+    return pack_channels([c for rgb in colors for c in rgb])
+
+
+def encode_keyframe(frame):
+    return pack_colors(frame)
+
+
+def encode_delta(frame, previous):
+    """Encodes the runs that turn previous into frame, unchanged voxels at the end are left
+    out because the cube keeps them."""
+    out = bytearray()
+    i = 0
+    last = VOXELS
+    while last > 0 and frame[last - 1] == previous[last - 1]:
+        last -= 1
+    while i < last:
+        if frame[i] == previous[i]:
+            n = 1
+            while i + n < last and n < MAX_RUN and frame[i + n] == previous[i + n]:
+                n += 1
+            out.append(SKIP | (n - 1))
+        elif i + 1 < last and frame[i + 1] == frame[i]:
+            n = 2
+            while i + n < last and n < MAX_RUN and frame[i + n] == frame[i]:
+                n += 1
+            out.append(FILL | (n - 1))
+            out += pack_colors(frame[i:i + 1])
+        else:
+            n = 1
+            while (i + n < last and n < MAX_RUN and frame[i + n] != previous[i + n]
+                   and not (i + n + 1 < last and frame[i + n + 1] == frame[i + n])):
+                n += 1
+            out.append(LITERAL | (n - 1))
+            out += pack_colors(frame[i:i + n])
+        i += n
+    return out
+
+
+def encode_frame(frame, previous=None):
+    """Returns the smallest complete message (header, payload, checksum) for frame."""
+    payload, kind = encode_keyframe(frame), KEYFRAME
+    if previous is not None:
+        delta = encode_delta(frame, previous)
+        if len(delta) < len(payload):
+            payload, kind = delta, DELTA
+    checksum = 0
+    for b in payload:
+        checksum ^= b
+    return b'VX' + struct.pack('<BH', kind, len(payload)) + payload + bytes((checksum,))
+
+
+def open_port(port, baudrate=12000000):
+    """Opens the serial port of the cube, or any terminal as a file without pyserial."""
+    try:
+        import serial
+    except ImportError:
+        return open(port, 'wb', buffering=0)
+    return serial.Serial(port, baudrate)
+
+
+class FrameStreamer:
+    """Keeps the previous frame so every frame after the first is sent as a delta."""
+
+    def __init__(self, port, baudrate=12000000, stream=None):
+        self.serial = stream if stream is not None else open_port(port, baudrate)
+        self.previous = None
+        self.bytes_sent = 0
+
+    def send(self, frame):
+        message = encode_frame(frame, self.previous)
+        self.serial.write(message)
+        self.bytes_sent += len(message)
+        self.previous = list(frame)
+
+    def close(self):
+        self.serial.close()
+
+
+def demo_frame(t):
+    """A tilted plane sweeping through the cube."""
+    frame = []
+    for x in range(WIDTH):
+        for y in range(HEIGHT):
+            for z in range(DEPTH):
+                h = 4 + 4 * math.sin(t + (x + z) * 0.3)
+                if abs(y - h) < 0.6:
+                    frame.append((0xFFF * x // 8, 0x400, 0xFFF * z // 8))
+                else:
+                    frame.append((0, 0, 0))
+    return frame
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('port', nargs='?')
+    parser.add_argument('--fps', type=float, default=60)
+    parser.add_argument('--seconds', type=float, default=10)
+    parser.add_argument('--frames', type=int, help='stop after this many frames')
+    parser.add_argument('--output', help='write the stream to a file instead of a port')
+    args = parser.parse_args()
+    if not args.port and not args.output:
+        parser.error('a port or --output is required')
+
+    if args.output:
+        streamer = FrameStreamer(None, stream=open(args.output, 'wb'))
+    else:
+        streamer = FrameStreamer(args.port)
+    start = time.time()
+    frames = 0
+    while (frames < args.frames if args.frames is not None
+           else time.time() - start < args.seconds):
+        streamer.send(demo_frame(frames / args.fps * 2))
+        frames += 1
+        delay = start + frames / args.fps - time.time()
+        if delay > 0 and not args.output:
+            time.sleep(delay)
+    elapsed = time.time() - start
+    print('%d frames, %.1f fps, %.0f bytes/frame' %
+          (frames, frames / max(elapsed, 1e-6), streamer.bytes_sent / max(frames, 1)))
+    streamer.close()
+
+
+if __name__ == '__main__':
+    sys.exit(main())